@@ -0,0 +1,330 @@
+// batch.c
+
+#include <errno.h>
+#include <locale.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/select.h>
+#include <wchar.h>
+
+#include "batch.h"
+#include "cache.h"
+#include "commands.h"
+#include "cpu/elliott803.h"
+#include "io5/io5.h"
+
+#if !defined(SizeOfArray)
+#define SizeOfArray(a) (sizeof(a) / sizeof((a)[0]))
+#endif
+
+// instructions before a wait ends although the machine has not settled
+static const int64_t wait_budget = INT64_C(10000000000);
+
+typedef struct {
+  commands_t cmd;
+  FILE **output;
+  FILE *messages; // console messages
+  io5_conv_t *conv_punch[3];
+  bool failed; // an error was reported
+} batch_t;
+
+// send more tape to a busy reader, false if there is no more
+static bool supply_reader(batch_t *b, elliott803_t *proc, int unit) {
+  io5_file_t *f = NULL;
+  switch (unit) {
+  case 1:
+    f = b->cmd.file[commands_reader_1];
+    break;
+  case 2:
+    f = b->cmd.file[commands_reader_2];
+    break;
+  default:
+    return false;
+  }
+
+  uint8_t read_buffer[32]; // max bytes is 32
+  ssize_t count = io5_file_read(f, read_buffer, sizeof(read_buffer));
+  if (count < 1) {
+    return false;
+  }
+  char packet[256];
+  int i = snprintf(packet, sizeof(packet), "reader %d ", unit);
+  for (ssize_t j = 0; j < count; ++j) {
+    i += snprintf(&packet[i], sizeof(packet) - i, "%02x", read_buffer[j]);
+  }
+  elliott803_send(proc, packet, i);
+  return true;
+}
+
+// write punched characters to any attached file and convert them to
+// text as shown on screens F1..F3
+static void punch(batch_t *b, int unit, const uint8_t *data, size_t size) {
+  switch (unit) {
+  case 0:
+    io5_file_write(b->cmd.file[commands_punch_1], data, size);
+    break;
+  case 1:
+    io5_file_write(b->cmd.file[commands_punch_2], data, size);
+    break;
+  default:
+    break;
+  }
+  while (size > 0) {
+    size_t k = io5_conv_put(b->conv_punch[unit], data, size);
+    data += k;
+    size -= k;
+    uint8_t text[256];
+    size_t n = io5_conv_get(b->conv_punch[unit], text, sizeof(text));
+
+    // carriage returns are not shown
+    size_t j = 0;
+    for (size_t i = 0; i < n; ++i) {
+      if ('\r' != text[i]) {
+        text[j++] = text[i];
+      }
+    }
+    if (NULL != b->output[unit] && j > 0) {
+      fwrite(text, 1, j, b->output[unit]);
+    }
+  }
+}
+
+// write a console message, naming the machine unless it is selected
+static void message(batch_t *b, elliott803_t *proc, int number, const char *s) {
+  if (proc != b->cmd.proc) {
+    fprintf(b->messages, "machine %d: ", number);
+  }
+  fprintf(b->messages, "%s\n", s);
+}
+
+// handle one message from a machine, selected or not
+static void handle_message(batch_t *b, int number) {
+
+  elliott803_t *proc = commands_get_machine(&b->cmd, number);
+  char buffer[4096];
+  ssize_t n = elliott803_receive(proc, buffer, sizeof(buffer) - 1);
+  if (n <= 0) {
+    return;
+  }
+  buffer[n] = '\0';
+
+  if ('p' == buffer[0] && buffer[1] >= '1' && buffer[1] <= '3' &&
+      ' ' == buffer[2]) {
+    punch(b, buffer[1] - '1', (const uint8_t *)(&buffer[3]), n - 3);
+
+  } else if ('r' == buffer[0] && 0 == strcmp(" busy", &buffer[2])) {
+    bool supplied = supply_reader(b, proc, buffer[1] - '0');
+    if (proc == b->cmd.proc) {
+      b->cmd.wait_supplied |= supplied;
+    }
+
+  } else if (0 == strncmp("wait ", buffer, 5)) {
+    if (0 == strcmp("wait limit", buffer)) {
+      // still running, so sending more tape cannot have ended it
+      message(b, proc, number, buffer);
+      b->cmd.wait_supplied = false;
+    }
+    commands_wait_reply(&b->cmd);
+
+  } else if (0 == strncmp("error", buffer, 5)) {
+    message(b, proc, number, buffer);
+    b->failed = true;
+
+  } else if (0 == strcmp("event limit", buffer)) {
+    // the rest of the script would run without a limit
+    message(b, proc, number, buffer);
+    b->failed = true;
+    b->cmd.exit_program = true;
+
+  } else if (0 != strcmp("ok", buffer) && 0 != strncmp("check ", buffer, 6)) {
+    message(b, proc, number, buffer);
+  }
+}
+
+// process messages from every machine until a wait is over and then until
+// none are left, so a clone that is not selected still runs to completion
+static void receive(batch_t *b) {
+  for (;;) {
+    int count = commands_machine_count(&b->cmd);
+    fd_set fds;
+    FD_ZERO(&fds);
+    for (int i = 1; i <= count; ++i) {
+      FD_SET(elliott803_get_fd(commands_get_machine(&b->cmd, i)), &fds);
+    }
+    struct timeval tzero = {
+      .tv_sec = 0,
+      .tv_usec = 0,
+    };
+    int rc = select(FD_SETSIZE, &fds, NULL, NULL, b->cmd.wait ? NULL : &tzero);
+    if (-1 == rc && EINTR == errno) {
+      continue;
+    }
+    if (rc <= 0) {
+      return;
+    }
+    for (int i = 1; i <= count; ++i) {
+      elliott803_t *proc = commands_get_machine(&b->cmd, i);
+      if (FD_ISSET(elliott803_get_fd(proc), &fds)) {
+        handle_message(b, i);
+      }
+    }
+  }
+}
+
+int batch_machine(elliott803_t *proc,
+                  FILE *script,
+                  FILE *output[3],
+                  FILE *messages) {
+
+  batch_t b;
+  memset(&b, 0, sizeof(b));
+  b.cmd.proc = proc;
+  b.cmd.wait_budget = wait_budget;
+  b.output = output;
+  b.messages = messages;
+  int rc = EXIT_FAILURE;
+
+  for (size_t i = 0; i < commands_io_count; ++i) {
+    b.cmd.file[i] = io5_file_allocate();
+    if (NULL == b.cmd.file[i]) {
+      fprintf(messages, "failed to create io5_file: %zu\n", i);
+      goto done;
+    }
+  }
+  for (size_t i = 0; i < SizeOfArray(b.conv_punch); ++i) {
+    b.conv_punch[i] = io5_conv_allocate(io5_mode_binary, io5_mode_elliott);
+    if (NULL == b.conv_punch[i]) {
+      fprintf(messages, "failed to create punch; %zu converter\n", i);
+      goto done;
+    }
+  }
+
+  wchar_t buffer[100];
+  while (!b.cmd.exit_program && NULL != fgetws(buffer, 100, script)) {
+    buffer[wcscspn(buffer, L"\r\n")] = L'\0';
+    commands_run(&b.cmd, buffer, sizeof(buffer));
+    if (NULL != b.cmd.error) {
+      fprintf(messages, "%ls\n", b.cmd.error);
+      b.failed |= 0 == wcsncmp(L"error", b.cmd.error, 5);
+      free((void *)b.cmd.error);
+      b.cmd.error = NULL;
+    }
+    receive(&b);
+  }
+
+  // let the last command complete so all output is written
+  if (!b.cmd.exit_program) {
+    wchar_t wait[] = L"wait";
+    commands_run(&b.cmd, wait, sizeof(wait));
+    receive(&b);
+  }
+  rc = b.failed ? EXIT_FAILURE : EXIT_SUCCESS;
+
+done:
+  commands_destroy_clones(&b.cmd);
+  for (size_t i = 0; i < commands_io_count; ++i) {
+    if (NULL != b.cmd.file[i]) {
+      io5_file_deallocate(b.cmd.file[i]);
+    }
+  }
+  for (size_t i = 0; i < SizeOfArray(b.conv_punch); ++i) {
+    if (NULL != b.conv_punch[i]) {
+      io5_conv_deallocate(b.conv_punch[i]);
+    }
+  }
+  for (size_t i = 0; i < 3; ++i) {
+    if (NULL != output[i]) {
+      fflush(output[i]);
+    }
+  }
+  return rc;
+}
+
+// run a script with its output captured to store it in the cache
+static int batch_cached(elliott803_t *proc,
+                        FILE *script,
+                        FILE *output[3],
+                        cache_t *cache) {
+
+  // screens sharing an output share a capture to keep their order
+  FILE *capture[3] = {NULL};
+  char *text[3] = {NULL};
+  size_t size[3] = {0};
+  bool owner[3] = {false};
+  char *messages = NULL;
+  size_t messages_size = 0;
+  FILE *m = open_memstream(&messages, &messages_size);
+  bool ok = NULL != m;
+  for (int i = 0; i < 3; ++i) {
+    for (int j = 0; j < i; ++j) {
+      if (output[j] == output[i]) {
+        capture[i] = capture[j];
+        break;
+      }
+    }
+    if (NULL != output[i] && NULL == capture[i]) {
+      capture[i] = open_memstream(&text[i], &size[i]);
+      owner[i] = NULL != capture[i];
+      ok = ok && owner[i];
+    }
+  }
+
+  int rc = ok ? batch_machine(proc, script, capture, m)
+              : batch_machine(proc, script, output, stderr);
+
+  for (int i = 0; i < 3; ++i) {
+    if (owner[i]) {
+      fclose(capture[i]);
+      fwrite(text[i], 1, size[i], output[i]);
+      fflush(output[i]);
+    }
+  }
+  if (NULL != m) {
+    fclose(m);
+    fwrite(messages, 1, messages_size, stderr);
+  }
+
+  // only successful runs, a failure may be worth retrying
+  if (ok && EXIT_SUCCESS == rc) {
+    cache_store(cache, text, size, messages, messages_size, rc);
+  }
+  for (int i = 0; i < 3; ++i) {
+    free(text[i]);
+  }
+  free(messages);
+  return rc;
+}
+
+int batch(FILE *script, FILE *output[3], bool cached) {
+
+  setlocale(LC_ALL, "");
+
+  cache_t *cache = cached ? cache_open() : NULL;
+  if (NULL != cache && !cache_key(cache, script, output)) {
+    cache_close(cache);
+    cache = NULL;
+  }
+  int rc = EXIT_FAILURE;
+  if (NULL != cache && cache_fetch(cache, output, stderr, &rc)) {
+    cache_close(cache);
+    return rc;
+  }
+
+  elliott803_t *proc = elliott803_create("Elliott 803B");
+  if (NULL == proc) {
+    fprintf(stderr, "failed to create processor\n");
+    cache_close(cache);
+    return EXIT_FAILURE;
+  }
+  if (NULL == cache) {
+    rc = batch_machine(proc, script, output, stderr);
+  } else {
+    rc = batch_cached(proc, script, output, cache);
+  }
+  elliott803_destroy(proc);
+  cache_close(cache);
+  return rc;
+}
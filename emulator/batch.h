@@ -0,0 +1,38 @@
+// batch.h
+
+#if !defined(BATCH_H)
+#define BATCH_H
+
+#include <stdbool.h>
+#include <stdio.h>
+
+#include "cpu/elliott803.h"
+
+// execute a script without a user interface
+//
+// the text of punch 1, punch 2 and the teleprinter (screens F1..F3) is
+// written to output[0..2], NULL to discard; console messages go to
+// stderr; "wait" returns as soon as the machine has stopped, is idle or
+// needs more tape, or with the message "wait limit" after ten thousand
+// million instructions, as a wait loop that changes the store is never
+// found idle; the end of the script is an implicit "wait"; if
+// the script subscribed to "event limit" reaching the instruction limit
+// ends it as failed
+//
+// if cached the result of a successful run is stored in the cache (see
+// cache.h) and a later run of the same script with the same inputs
+// writes it without creating a machine; output is then written when the
+// script is complete
+//
+// returns EXIT_SUCCESS or EXIT_FAILURE if any command reported an error
+int batch(FILE *script, FILE *output[3], bool cached);
+
+// execute a script as batch does on an existing machine, which is left
+// in whatever state the script leaves it; any clones it makes are
+// destroyed and console messages are written to messages
+int batch_machine(elliott803_t *proc,
+                  FILE *script,
+                  FILE *output[3],
+                  FILE *messages);
+
+#endif
@@ -0,0 +1,75 @@
+// batch_test.c
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <wchar.h>
+
+#include "batch.h"
+#include "cpu/elliott803.h"
+
+enum {
+  punched = 100000, // more than a reply ring holds
+};
+
+// a clone punches while the first machine, which is selected again,
+// counts for much longer and the script waits for it alone
+static const wchar_t script[] = L"mw 4110 -100000\n"
+                               L"mw 4100 74 1 : 22 4110\n"
+                               L"mw 4101 30 4110 : 41 4100\n"
+                               L"mw 4102 40 4102 : 00 0\n"
+                               L"mw 4120 -20000000\n"
+                               L"mw 4121 22 4120 : 30 4120\n"
+                               L"mw 4122 41 4121 : 40 4123\n"
+                               L"mw 4123 40 4123 : 00 0\n"
+                               L"fork\n"
+                               L"machine 2\n"
+                               L"events stop\n"
+                               L"run 4100\n"
+                               L"machine 1\n"
+                               L"run 4121\n"
+                               L"wait\n";
+
+static void check(const char *title, bool ok) {
+  if (!ok) {
+    printf("failed: %s\n", title);
+    exit(1);
+  }
+}
+
+int main(int argc, char *argv[]) {
+
+  FILE *f = tmpfile();
+  check("tmpfile", NULL != f);
+  check("write script", -1 != fputws(script, f));
+  rewind(f);
+
+  char *text = NULL;
+  size_t text_size = 0;
+  FILE *output[3] = {open_memstream(&text, &text_size), NULL, NULL};
+  check("output", NULL != output[0]);
+  char *messages = NULL;
+  size_t messages_size = 0;
+  FILE *m = open_memstream(&messages, &messages_size);
+  check("messages", NULL != m);
+
+  elliott803_t *proc = elliott803_create("batch test");
+  check("create", NULL != proc);
+  check("batch", EXIT_SUCCESS == batch_machine(proc, f, output, m));
+  elliott803_destroy(proc);
+  fclose(f);
+  fclose(output[0]);
+  fclose(m);
+
+  // the clone is not selected, yet all it punched arrives before it stops
+  check("clone stop", NULL != strstr(messages, "machine 2: event stop"));
+  check("clone output", punched == text_size);
+  for (size_t i = 0; i < text_size; ++i) {
+    check("clone text", 'a' == text[i]);
+  }
+
+  free(text);
+  free(messages);
+  return 0;
+}
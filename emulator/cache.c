@@ -0,0 +1,691 @@
+// cache.c
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <limits.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <wchar.h>
+
+#if defined(__FreeBSD__)
+#include <sys/sysctl.h>
+#include <sys/types.h>
+#endif
+
+#include "cache.h"
+#include "parser/parser.h"
+#include "pathsearch.h"
+#include "sha256.h"
+
+#if !defined(SizeOfArray)
+#define SizeOfArray(a) (sizeof(a) / sizeof((a)[0]))
+#endif
+
+static const int64_t default_limit = 64 * 1024 * 1024;
+
+// first line of every stored result
+static const char magic[] = "emu803 cache 1\n";
+
+typedef enum {
+  stat_hits,
+  stat_misses,
+  stat_bypassed, // runs that could not be cached
+  stat_stores,
+  stat_evictions,
+
+  stat_count, // number of items
+} statistic_t;
+
+static const char *statistic_names[] = {
+  [stat_hits] = "hits",
+  [stat_misses] = "misses",
+  [stat_bypassed] = "bypassed",
+  [stat_stores] = "stores",
+  [stat_evictions] = "evictions",
+};
+
+struct cache_struct {
+  char *directory;
+  int64_t limit;                 // bytes of results kept
+  char key[2 * sha256_size + 1]; // hex digest, empty until computed
+  char entry[1024];              // file of the result for key
+};
+
+// create a directory and any missing parents
+static bool make_directory(const char *name) {
+  char path[1024];
+  size_t n = snprintf(path, sizeof(path), "%s", name);
+  if (n >= sizeof(path)) {
+    return false;
+  }
+  for (char *p = &path[1]; '\0' != *p; ++p) {
+    if ('/' == *p) {
+      *p = '\0';
+      if (0 != mkdir(path, 0755) && EEXIST != errno) {
+        return false;
+      }
+      *p = '/';
+    }
+  }
+  return 0 == mkdir(path, 0755) || EEXIST == errno;
+}
+
+// bytes with an optional K, M or G suffix, -1 if invalid
+static int64_t parse_size(const char *s) {
+  char *end = NULL;
+  int64_t size = strtoll(s, &end, 10);
+  switch (*end) {
+  case 'G':
+  case 'g':
+    size *= 1024;
+    // fall through
+  case 'M':
+  case 'm':
+    size *= 1024;
+    // fall through
+  case 'K':
+  case 'k':
+    size *= 1024;
+    ++end;
+    break;
+  default:
+    break;
+  }
+  return end == s || '\0' != *end || size < 0 ? -1 : size;
+}
+
+cache_t *cache_open(void) {
+
+  char directory[1024];
+  const char *e = getenv("E803_CACHE_DIR");
+  const char *xdg = getenv("XDG_CACHE_HOME");
+  const char *home = getenv("HOME");
+  size_t n = sizeof(directory);
+  if (NULL != e && '\0' != *e) {
+    n = snprintf(directory, sizeof(directory), "%s", e);
+  } else if (NULL != xdg && '/' == *xdg) {
+    n = snprintf(directory, sizeof(directory), "%s/emu803", xdg);
+  } else if (NULL != home && '/' == *home) {
+    n = snprintf(directory, sizeof(directory), "%s/.cache/emu803", home);
+  }
+  if (n >= sizeof(directory) - 2 * sha256_size - 8 ||
+      !make_directory(directory)) {
+    return NULL;
+  }
+
+  int64_t limit = default_limit;
+  e = getenv("E803_CACHE_SIZE");
+  if (NULL != e && (limit = parse_size(e)) < 0) {
+    fprintf(stderr, "error: invalid E803_CACHE_SIZE: %s\n", e);
+    return NULL;
+  }
+
+  cache_t *cache = calloc(1, sizeof(cache_t));
+  if (NULL == cache) {
+    return NULL;
+  }
+  cache->directory = strdup(directory);
+  if (NULL == cache->directory) {
+    free(cache);
+    return NULL;
+  }
+  cache->limit = limit;
+  return cache;
+}
+
+void cache_close(cache_t *cache) {
+  if (NULL != cache) {
+    free(cache->directory);
+    free(cache);
+  }
+}
+
+// add one to a statistic, or just read them all if which is stat_count
+static bool update_statistics(const char *directory,
+                              statistic_t which,
+                              int64_t count[stat_count]) {
+  char name[1024];
+  snprintf(name, sizeof(name), "%s/statistics", directory);
+  int fd = open(name, O_RDWR | O_CREAT, 0644);
+  if (-1 == fd) {
+    return false;
+  }
+  flock(fd, LOCK_EX);
+
+  memset(count, 0, stat_count * sizeof(count[0]));
+  char text[1024];
+  ssize_t n = pread(fd, text, sizeof(text) - 1, 0);
+  text[n > 0 ? n : 0] = '\0';
+  for (char *line = text; NULL != line && '\0' != *line;) {
+    char *next = strchr(line, '\n');
+    for (int i = 0; i < stat_count; ++i) {
+      size_t k = strlen(statistic_names[i]);
+      if (0 == strncmp(statistic_names[i], line, k) && ' ' == line[k]) {
+        count[i] = strtoll(&line[k + 1], NULL, 10);
+      }
+    }
+    line = NULL == next ? NULL : &next[1];
+  }
+
+  if (which < stat_count) {
+    ++count[which];
+    int k = 0;
+    for (int i = 0; i < stat_count; ++i) {
+      k += snprintf(&text[k],
+                    sizeof(text) - k,
+                    "%s %" PRId64 "\n",
+                    statistic_names[i],
+                    count[i]);
+    }
+    if (k != pwrite(fd, text, k, 0) || 0 != ftruncate(fd, k)) {
+      close(fd);
+      return false;
+    }
+  }
+  close(fd); // releases the lock
+  return true;
+}
+
+static void count(cache_t *cache, statistic_t which) {
+  int64_t counts[stat_count];
+  update_statistics(cache->directory, which, counts);
+}
+
+// add a length and the bytes so that items cannot run together
+static void add_item(sha256_t *h, const void *data, size_t size) {
+  uint64_t length = size;
+  sha256_add(h, &length, sizeof(length));
+  sha256_add(h, data, size);
+}
+
+// add the contents of a file, false if it cannot be read
+static bool add_file(sha256_t *h, const char *name) {
+  int fd = open(name, O_RDONLY);
+  if (-1 == fd) {
+    return false;
+  }
+  struct stat st;
+  bool ok = 0 == fstat(fd, &st) && S_ISREG(st.st_mode);
+  if (ok) {
+    uint64_t length = st.st_size;
+    sha256_add(h, &length, sizeof(length));
+  }
+  uint8_t buffer[65536];
+  for (off_t total = 0; ok && total < st.st_size;) {
+    ssize_t n = read(fd, buffer, sizeof(buffer));
+    if (n <= 0) {
+      ok = false;
+      break;
+    }
+    sha256_add(h, buffer, n);
+    total += n;
+  }
+  close(fd);
+  return ok;
+}
+
+// add a tape found as "reader" would find it
+static bool add_tape(sha256_t *h, const wchar_t *w) {
+  char filename[1024];
+  size_t n = snprintf(filename, sizeof(filename), "%ls", w);
+  if (n >= sizeof(filename) - 1) {
+    return false;
+  }
+  if ('/' != filename[0] && 0 != strncmp("./", filename, 2) &&
+      0 != strncmp("../", filename, 3) &&
+      PS_ok != path_search(filename, sizeof(filename), "", w)) {
+    return false;
+  }
+  return add_file(h, filename);
+}
+
+// add the size and modification time of the running emulator, false if
+// it cannot be found as a rebuilt emulator may give different results
+static bool add_executable(sha256_t *h) {
+#if defined(__linux__)
+  const char *path = "/proc/self/exe";
+#elif defined(__FreeBSD__)
+  char buffer[PATH_MAX];
+  size_t size = sizeof(buffer);
+  int mib[4] = {CTL_KERN, KERN_PROC, KERN_PROC_PATHNAME, -1};
+  const char *path = NULL;
+  if (0 == sysctl(mib, SizeOfArray(mib), buffer, &size, NULL, 0)) {
+    path = buffer;
+  }
+#else
+  const char *path = NULL; // unknown, so nothing is cached
+#endif
+  struct stat exe;
+  if (NULL == path || 0 != stat(path, &exe)) {
+    return false;
+  }
+  int64_t identity[3] = {
+    exe.st_size,
+    exe.st_mtim.tv_sec,
+    exe.st_mtim.tv_nsec,
+  };
+  sha256_add(h, identity, sizeof(identity));
+  return true;
+}
+
+// add the inputs named by one line of a script, false if the line has
+// effects other than the output of the machine
+static bool add_command(sha256_t *h, wchar_t *line) {
+
+  const wchar_t *command = parser_get_token(&line);
+  if (NULL == command) {
+    return true;
+  }
+  const wchar_t *w[3] = {NULL};
+  for (size_t i = 0; i < SizeOfArray(w); ++i) {
+    w[i] = parser_get_token(&line);
+  }
+
+  // reader|punch unit [mode] file|close
+  bool reader = 0 == wcscasecmp(L"reader", command);
+  if (reader || 0 == wcscasecmp(L"punch", command)) {
+    const wchar_t *file = NULL == w[2] ? w[1] : w[2];
+    if (NULL == file || 0 == wcscasecmp(L"close", file)) {
+      return true;
+    }
+    return reader && add_tape(h, file);
+  }
+
+  // snapshot save|load file
+  if (0 == wcscasecmp(L"snapshot", command) && NULL != w[0] &&
+      NULL != w[1]) {
+    char filename[1024];
+    size_t n = snprintf(filename, sizeof(filename), "%ls", w[1]);
+    return 0 == wcscasecmp(L"load", w[0]) && n < sizeof(filename) - 1 &&
+           add_file(h, filename);
+  }
+
+  // profile report|callgrind file
+  if (0 == wcscasecmp(L"profile", command) && NULL != w[1]) {
+    return false;
+  }
+
+  // trace on file
+  if (0 == wcscasecmp(L"trace", command) && NULL != w[1]) {
+    return false;
+  }
+
+  // sample report depends on the host timer
+  if (0 == wcscasecmp(L"sample", command) && NULL != w[0] &&
+      0 == wcscasecmp(L"report", w[0])) {
+    return false;
+  }
+
+  // stats shows host times and memory, and which events are pushed
+  // depends on where a quantum ends, which a message can make early
+  if (0 == wcscasecmp(L"stats", command) ||
+      0 == wcscasecmp(L"events", command)) {
+    return false;
+  }
+  return true;
+}
+
+bool cache_key(cache_t *cache, FILE *script, FILE *output[3]) {
+
+  cache->key[0] = '\0';
+
+  sha256_t h;
+  sha256_init(&h);
+  sha256_add(&h, VERSION_STRING, sizeof(VERSION_STRING));
+  if (!add_executable(&h)) {
+    count(cache, stat_bypassed);
+    return false;
+  }
+
+  // which screens share an output
+  for (int i = 0; i < 3; ++i) {
+    uint8_t shared = NULL == output[i] ? 0xff : i;
+    for (int j = 0; j < i; ++j) {
+      if (output[j] == output[i] && NULL != output[i]) {
+        shared = j;
+        break;
+      }
+    }
+    sha256_add(&h, &shared, sizeof(shared));
+  }
+
+  // the script is read again by the run, so leave its position alone
+  struct stat st;
+  int fd = fileno(script);
+  if (0 != fstat(fd, &st) || !S_ISREG(st.st_mode)) {
+    count(cache, stat_bypassed);
+    return false;
+  }
+  char *text = malloc(st.st_size + 1);
+  ssize_t size = NULL == text ? -1 : pread(fd, text, st.st_size, 0);
+  if (size != st.st_size) {
+    free(text);
+    count(cache, stat_bypassed);
+    return false;
+  }
+  text[size] = '\0';
+  add_item(&h, text, size);
+
+  bool ok = true;
+  wchar_t *line = malloc((size + 1) * sizeof(wchar_t));
+  ok = NULL != line;
+  for (char *s = text; ok && NULL != s;) {
+    char *next = strchr(s, '\n');
+    if (NULL != next) {
+      *next = '\0';
+    }
+    ok = (size_t)(-1) != mbstowcs(line, s, size + 1) && add_command(&h, line);
+    s = NULL == next ? NULL : &next[1];
+  }
+  free(line);
+  free(text);
+  if (!ok) {
+    count(cache, stat_bypassed);
+    return false;
+  }
+
+  uint8_t digest[sha256_size];
+  sha256_final(&h, digest);
+  for (int i = 0; i < sha256_size; ++i) {
+    snprintf(&cache->key[2 * i], 3, "%02x", digest[i]);
+  }
+  snprintf(cache->entry,
+           sizeof(cache->entry),
+           "%s/%.2s/%s",
+           cache->directory,
+           cache->key,
+           cache->key);
+  return true;
+}
+
+// a whole file, NULL on error
+static char *read_entry(const char *name, size_t *size) {
+  int fd = open(name, O_RDONLY);
+  if (-1 == fd) {
+    return NULL;
+  }
+  struct stat st;
+  char *data = NULL;
+  if (0 == fstat(fd, &st) && NULL != (data = malloc(st.st_size + 1))) {
+    if (st.st_size != pread(fd, data, st.st_size, 0)) {
+      free(data);
+      data = NULL;
+    } else {
+      data[st.st_size] = '\0';
+      *size = st.st_size;
+    }
+  }
+  close(fd);
+  return data;
+}
+
+bool cache_fetch(cache_t *cache, FILE *output[3], FILE *messages, int *rc) {
+
+  if ('\0' == cache->key[0]) {
+    return false;
+  }
+  size_t size = 0;
+  char *data = read_entry(cache->entry, &size);
+  if (NULL == data) {
+    count(cache, stat_misses);
+    return false;
+  }
+
+  // check the whole entry before writing any of it
+  typedef struct {
+    int screen; // 0..2 or -1 for messages
+    const char *text;
+    size_t size;
+  } section_t;
+  section_t section[4];
+  int sections = 0;
+  bool ok = 0 == strncmp(magic, data, sizeof(magic) - 1);
+  size_t i = sizeof(magic) - 1;
+  int status = -1;
+  while (ok && i < size && -1 == status) {
+    const char *eol = memchr(&data[i], '\n', size - i);
+    char line[64];
+    size_t n = NULL == eol ? sizeof(line) : (size_t)(eol - &data[i]) + 1;
+    ok = n < sizeof(line);
+    if (!ok) {
+      break;
+    }
+    memcpy(line, &data[i], n);
+    line[n] = '\0';
+    i += n;
+
+    int screen = 0;
+    size_t length = 0;
+    int end = 0;
+    if (1 == sscanf(line, "status %d%n", &status, &end)) {
+      ok = '\n' == line[end];
+    } else if (1 == sscanf(line, "messages %zu%n", &length, &end) ||
+               (2 == sscanf(line, "screen %d %zu%n", &screen, &length, &end) &&
+                screen >= 1 && screen <= 3)) {
+      ok = '\n' == line[end] && length <= size - i &&
+           sections < (int)(SizeOfArray(section));
+      if (ok) {
+        section[sections++] = (section_t){
+          .screen = screen - 1,
+          .text = &data[i],
+          .size = length,
+        };
+        i += length;
+      }
+    } else {
+      ok = false;
+    }
+  }
+  ok = ok && status >= 0 && i == size;
+  for (int k = 0; ok && k < sections; ++k) {
+    ok = section[k].screen < 0 || NULL != output[section[k].screen];
+  }
+
+  if (!ok) {
+    free(data);
+    unlink(cache->entry);
+    count(cache, stat_misses);
+    return false;
+  }
+
+  for (int k = 0; k < sections; ++k) {
+    FILE *f = section[k].screen < 0 ? messages : output[section[k].screen];
+    fwrite(section[k].text, 1, section[k].size, f);
+    fflush(f);
+  }
+  *rc = status;
+  free(data);
+
+  // the time of last use orders the eviction
+  utimensat(AT_FDCWD, cache->entry, NULL, 0);
+  count(cache, stat_hits);
+  return true;
+}
+
+typedef struct {
+  char *name;
+  off_t size;
+  struct timespec used;
+} entry_t;
+
+static int compare_used(const void *a, const void *b) {
+  const entry_t *x = a;
+  const entry_t *y = b;
+  if (x->used.tv_sec != y->used.tv_sec) {
+    return x->used.tv_sec < y->used.tv_sec ? -1 : 1;
+  }
+  if (x->used.tv_nsec != y->used.tv_nsec) {
+    return x->used.tv_nsec < y->used.tv_nsec ? -1 : 1;
+  }
+  return 0;
+}
+
+// list the results in the cache, false on error
+static bool list_entries(const char *directory,
+                         entry_t **entries,
+                         size_t *count,
+                         int64_t *total) {
+  *entries = NULL;
+  *count = 0;
+  *total = 0;
+  size_t capacity = 0;
+  DIR *top = opendir(directory);
+  if (NULL == top) {
+    return false;
+  }
+  bool ok = true;
+  for (struct dirent *d = NULL; ok && NULL != (d = readdir(top));) {
+    if (2 != strlen(d->d_name) || '.' == d->d_name[0]) {
+      continue;
+    }
+    char path[PATH_MAX];
+    size_t n = snprintf(path, sizeof(path), "%s/%s", directory, d->d_name);
+    DIR *sub = n < sizeof(path) ? opendir(path) : NULL;
+    for (struct dirent *e = NULL; NULL != sub && NULL != (e = readdir(sub));) {
+      struct stat st;
+      char name[PATH_MAX + 2 * sha256_size + 2];
+      n = snprintf(name, sizeof(name), "%s/%s", path, e->d_name);
+      if (n >= sizeof(name) || 2 * sha256_size != strlen(e->d_name) ||
+          0 != stat(name, &st) || !S_ISREG(st.st_mode)) {
+        continue;
+      }
+      char *copy = strdup(name);
+      if (NULL == copy) {
+        ok = false;
+        break;
+      }
+      if (*count == capacity) {
+        capacity = 2 * capacity + 64;
+        entry_t *p = realloc(*entries, capacity * sizeof(entry_t));
+        if (NULL == p) {
+          free(copy);
+          ok = false;
+          break;
+        }
+        *entries = p;
+      }
+      (*entries)[*count] = (entry_t){
+        .name = copy,
+        .size = st.st_size,
+        .used = st.st_mtim,
+      };
+      *total += st.st_size;
+      ++*count;
+    }
+    if (NULL != sub) {
+      closedir(sub);
+    }
+  }
+  closedir(top);
+  return ok;
+}
+
+static void free_entries(entry_t *entries, size_t count) {
+  for (size_t i = 0; i < count; ++i) {
+    free(entries[i].name);
+  }
+  free(entries);
+}
+
+// remove the least recently used results until within the limit
+static void evict(cache_t *cache) {
+  entry_t *entries = NULL;
+  size_t n = 0;
+  int64_t total = 0;
+  if (list_entries(cache->directory, &entries, &n, &total) &&
+      total > cache->limit) {
+    qsort(entries, n, sizeof(entry_t), compare_used);
+    for (size_t i = 0; i < n && total > cache->limit; ++i) {
+      if (0 == unlink(entries[i].name)) {
+        total -= entries[i].size;
+        count(cache, stat_evictions);
+      }
+    }
+  }
+  free_entries(entries, n);
+}
+
+void cache_store(cache_t *cache,
+                 char *text[3],
+                 size_t size[3],
+                 const char *messages,
+                 size_t messages_size,
+                 int rc) {
+
+  if ('\0' == cache->key[0]) {
+    return;
+  }
+
+  char name[sizeof(cache->entry) + 32];
+  size_t n =
+    snprintf(name, sizeof(name), "%s/%.2s", cache->directory, cache->key);
+  if (n >= sizeof(name) || !make_directory(name)) {
+    return;
+  }
+
+  // written in full before it replaces any other copy
+  n = snprintf(name, sizeof(name), "%s.%ld", cache->entry, (long)(getpid()));
+  if (n >= sizeof(name)) {
+    return;
+  }
+  FILE *f = fopen(name, "wb");
+  if (NULL == f) {
+    return;
+  }
+  fputs(magic, f);
+  for (int i = 0; i < 3; ++i) {
+    if (NULL != text[i]) {
+      fprintf(f, "screen %d %zu\n", i + 1, size[i]);
+      fwrite(text[i], 1, size[i], f);
+    }
+  }
+  fprintf(f, "messages %zu\n", messages_size);
+  fwrite(messages, 1, messages_size, f);
+  fprintf(f, "status %d\n", rc);
+  bool ok = !ferror(f);
+  ok = 0 == fclose(f) && ok;
+  if (!ok || 0 != rename(name, cache->entry)) {
+    unlink(name);
+    return;
+  }
+  count(cache, stat_stores);
+  evict(cache);
+}
+
+int cache_statistics(FILE *f) {
+
+  cache_t *cache = cache_open();
+  if (NULL == cache) {
+    fprintf(stderr, "error: no cache directory\n");
+    return EXIT_FAILURE;
+  }
+
+  int64_t counts[stat_count];
+  entry_t *entries = NULL;
+  size_t n = 0;
+  int64_t total = 0;
+  bool ok = update_statistics(cache->directory, stat_count, counts) &&
+            list_entries(cache->directory, &entries, &n, &total);
+  if (ok) {
+    fprintf(f, "cache %s\n", cache->directory);
+    for (int i = 0; i < stat_count; ++i) {
+      fprintf(f, "%s %" PRId64 "\n", statistic_names[i], counts[i]);
+    }
+    fprintf(f, "entries %zu\n", n);
+    fprintf(f, "bytes %" PRId64 "\n", total);
+    fprintf(f, "limit %" PRId64 "\n", cache->limit);
+  } else {
+    fprintf(stderr, "error: cannot read cache %s\n", cache->directory);
+  }
+  free_entries(entries, n);
+  cache_close(cache);
+  return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,51 @@
+// cache.h
+
+#if !defined(CACHE_H)
+#define CACHE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+
+// results of batch runs stored by the SHA-256 of everything that
+// determines them: the emulator build, the script, the contents of the
+// tapes and snapshots it loads and which screens share an output
+//
+// the cache is the directory E803_CACHE_DIR, or emu803 in
+// XDG_CACHE_HOME or ~/.cache; E803_CACHE_SIZE limits its size in bytes,
+// with an optional K, M or G suffix, and the least recently used results
+// are removed to keep within it
+typedef struct cache_struct cache_t;
+
+// NULL if there is no cache directory
+cache_t *cache_open(void);
+void cache_close(cache_t *cache);
+
+// compute the key of a script without changing its position
+//
+// returns false if the run cannot be cached, e.g. it punches to a file,
+// saves a snapshot, the script is not a regular file or the emulator's
+// executable cannot be found to tell one build from another
+bool cache_key(cache_t *cache, FILE *script, FILE *output[3]);
+
+// write a stored result as the run would have done
+//
+// returns false if there is none
+bool cache_fetch(cache_t *cache, FILE *output[3], FILE *messages, int *rc);
+
+// store a result: text[i] is the output of screen F1..F3, NULL if the
+// screen has no output of its own
+void cache_store(cache_t *cache,
+                 char *text[3],
+                 size_t size[3],
+                 const char *messages,
+                 size_t messages_size,
+                 int rc);
+
+// display the counts of hits, misses, stores and evictions and the size
+// of the cache
+//
+// returns EXIT_SUCCESS or EXIT_FAILURE if there is no cache
+int cache_statistics(FILE *f);
+
+#endif
@@ -1,5 +1,7 @@
 // commands.c
 
+#include <ctype.h>
+#include <inttypes.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -48,18 +50,23 @@ static void command_exit(commands_t *cmd, const wchar_t *name, wchar_t **ptr) {
   cmd->exit_program = true;
 }
 
-static void command_wait(commands_t *cmd, const wchar_t *name, wchar_t **ptr) {
+// ask the processor to reply when it settles or the budget is spent
+static void send_wait(commands_t *cmd) {
+  char buffer[64];
+  int n = snprintf(buffer, sizeof(buffer), "wait");
+  if (0 != cmd->wait_budget) {
+    n += snprintf(
+      &buffer[n], sizeof(buffer) - n, " %" PRId64, cmd->wait_budget);
+  }
+  elliott803_send(cmd->proc, buffer, n + 1); // include '\0'
+}
 
+// the processor replies as soon as it stops, is idle or needs tape so
+// any time limit is ignored
+static void command_wait(commands_t *cmd, const wchar_t *name, wchar_t **ptr) {
   cmd->wait = true;
-  cmd->wait_delay = 0;
-
-  const wchar_t *w = parser_get_token(ptr);
-  if (NULL != w) {
-    long seconds = wcstol(w, NULL, 10);
-    if (seconds > 0 && seconds < 3600) {
-      cmd->wait_delay = (int)(seconds);
-    }
-  }
+  cmd->wait_supplied = false;
+  send_wait(cmd);
 }
 
 static void
@@ -259,6 +266,34 @@ static void command_hello(commands_t *cmd, const wchar_t *name, wchar_t **ptr) {
   }
 }
 
+// read all of an opened tape and hand it to the processor
+static void load_tape(commands_t *cmd, int unit, io5_file_t *file) {
+
+  size_t size = 0;
+  size_t capacity = 65536;
+  uint8_t *data = malloc(capacity);
+  for (;;) {
+    if (NULL == data) {
+      cmd->error = wcsdup(L"error: malloc failed");
+      return;
+    }
+    ssize_t n = io5_file_read(file, &data[size], capacity - size);
+    if (n <= 0) {
+      break;
+    }
+    size += n;
+    if (size == capacity) {
+      capacity *= 2;
+      uint8_t *p = realloc(data, capacity);
+      if (NULL == p) {
+        free(data);
+      }
+      data = p;
+    }
+  }
+  elliott803_load_tape(cmd->proc, unit, data, size);
+}
+
 // reader unit [mode] file
 // if mode is absent then assume "hex5"
 static void
@@ -287,6 +322,7 @@ command_reader(commands_t *cmd, const wchar_t *name, wchar_t **ptr) {
     mode = string_to_mode(w);
     if (0 == wcscasecmp(w1, L"close")) {
       io5_file_close(cmd->file[io]);
+      elliott803_load_tape(cmd->proc, unit, NULL, 0);
       return;
     } else if (io5_mode_invalid == mode) {
       cmd->error = wcsdup(L"error: mode is invalid");
@@ -307,6 +343,7 @@ command_reader(commands_t *cmd, const wchar_t *name, wchar_t **ptr) {
 
     // absolute/relative path
     if (io5_ok == io5_file_open(cmd->file[io], filename, mode)) {
+      load_tape(cmd, unit, cmd->file[io]);
       return;
     }
 
@@ -316,6 +353,8 @@ command_reader(commands_t *cmd, const wchar_t *name, wchar_t **ptr) {
     case PS_ok:
       if (io5_ok != io5_file_open(cmd->file[io], filename, mode)) {
         cmd->error = wcsdup(L"error: file cannot be opened");
+      } else {
+        load_tape(cmd, unit, cmd->file[io]);
       }
       break;
     case PS_malloc_failed:
@@ -412,6 +451,360 @@ command_word_generator(commands_t *cmd, const wchar_t *name, wchar_t **ptr) {
   elliott803_send(cmd->proc, packet, n);
 }
 
+static void
+command_quantum(commands_t *cmd, const wchar_t *name, wchar_t **ptr) {
+
+  const wchar_t *w = parser_get_token(ptr);
+  if (NULL == w) {
+    elliott803_send(cmd->proc, "quantum", 8);
+    return;
+  }
+
+  wchar_t *end = NULL;
+  long quantum = wcstol(w, &end, 10);
+  if (L'\0' != *end || quantum < 1) {
+    cmd->error = wcsdup(L"error: invalid quantum");
+    return;
+  }
+
+  char packet[256];
+  memset(packet, 0, sizeof(packet));
+  int n = snprintf(packet, sizeof(packet), "quantum %ld", quantum);
+  elliott803_send(cmd->proc, packet, n);
+}
+
+static void
+command_statistics(commands_t *cmd, const wchar_t *name, wchar_t **ptr) {
+  elliott803_send(cmd->proc, "stats", 6);
+}
+
+static void
+command_engine(commands_t *cmd, const wchar_t *name, wchar_t **ptr) {
+
+  const wchar_t *w = parser_get_token(ptr);
+  if (NULL == w) {
+    elliott803_send(cmd->proc, "engine", 7);
+    return;
+  }
+
+  if (0 == wcscasecmp(L"interpreter", w)) {
+    elliott803_send(cmd->proc, "engine interpreter", 19);
+  } else if (0 == wcscasecmp(L"jit", w)) {
+    elliott803_send(cmd->proc, "engine jit", 11);
+  } else {
+    cmd->error = wcsdup(L"error: invalid engine");
+  }
+}
+
+static void
+command_clock(commands_t *cmd, const wchar_t *name, wchar_t **ptr) {
+
+  const wchar_t *w = parser_get_token(ptr);
+  if (NULL == w) {
+    elliott803_send(cmd->proc, "clock", 6);
+    return;
+  }
+
+  if (0 == wcscasecmp(L"authentic", w)) {
+    elliott803_send(cmd->proc, "clock authentic", 16);
+  } else if (0 == wcscasecmp(L"turbo", w)) {
+    elliott803_send(cmd->proc, "clock turbo", 12);
+  } else {
+    cmd->error = wcsdup(L"error: invalid clock");
+  }
+}
+
+static void
+command_events(commands_t *cmd, const wchar_t *name, wchar_t **ptr) {
+
+  char packet[256];
+  memset(packet, 0, sizeof(packet));
+  int n = snprintf(packet, sizeof(packet), "events");
+  for (const wchar_t *w = parser_get_token(ptr); NULL != w;
+       w = parser_get_token(ptr)) {
+    n += snprintf(&packet[n], sizeof(packet) - n, " %ls", w);
+    if (n >= (int)(sizeof(packet))) {
+      cmd->error = wcsdup(L"error: too many events");
+      return;
+    }
+  }
+  for (int i = 0; i < n; ++i) {
+    packet[i] = tolower((unsigned char)(packet[i]));
+  }
+  elliott803_send(cmd->proc, packet, n);
+}
+
+static void
+command_limit(commands_t *cmd, const wchar_t *name, wchar_t **ptr) {
+
+  const wchar_t *w = parser_get_token(ptr);
+  if (NULL == w) {
+    elliott803_send(cmd->proc, "limit", 6);
+    return;
+  }
+
+  if (0 == wcscasecmp(L"off", w)) {
+    elliott803_send(cmd->proc, "limit off", 10);
+    return;
+  }
+
+  wchar_t *end = NULL;
+  long long limit = wcstoll(w, &end, 10);
+  if (L'\0' != *end || limit < 1) {
+    cmd->error = wcsdup(L"error: invalid limit");
+    return;
+  }
+
+  char packet[256];
+  memset(packet, 0, sizeof(packet));
+  int n = snprintf(packet, sizeof(packet), "limit %lld", limit);
+  elliott803_send(cmd->proc, packet, n);
+}
+
+static void
+command_output(commands_t *cmd, const wchar_t *name, wchar_t **ptr) {
+
+  const wchar_t *w = parser_get_token(ptr);
+  if (NULL == w) {
+    elliott803_send(cmd->proc, "output", 7);
+    return;
+  }
+
+  if (0 == wcscasecmp(L"batch", w)) {
+    elliott803_send(cmd->proc, "output batch", 13);
+  } else if (0 == wcscasecmp(L"char", w)) {
+    elliott803_send(cmd->proc, "output char", 12);
+  } else {
+    cmd->error = wcsdup(L"error: invalid output");
+  }
+}
+
+// snapshot save|load file
+static void
+command_snapshot(commands_t *cmd, const wchar_t *name, wchar_t **ptr) {
+
+  const wchar_t *w = parser_get_token(ptr);
+  if (NULL == w ||
+      (0 != wcscasecmp(L"save", w) && 0 != wcscasecmp(L"load", w))) {
+    cmd->error = wcsdup(L"error: missing save or load");
+    return;
+  }
+  bool save = 0 == wcscasecmp(L"save", w);
+
+  w = parser_get_token(ptr);
+  if (NULL == w) {
+    cmd->error = wcsdup(L"error: missing filename");
+    return;
+  }
+
+  char packet[1024];
+  size_t n = snprintf(
+    packet, sizeof(packet), "snapshot %s %ls", save ? "save" : "load", w);
+  if (n >= sizeof(packet) - 1) {
+    cmd->error = wcsdup(L"error: filename is too long");
+    return;
+  }
+  elliott803_send(cmd->proc, packet, n + 1);
+}
+
+// profile [on|off|clear]
+// profile report|callgrind file
+static void
+command_profile(commands_t *cmd, const wchar_t *name, wchar_t **ptr) {
+
+  const wchar_t *w = parser_get_token(ptr);
+  char packet[1024];
+  size_t n = 0;
+  if (NULL == w) {
+    n = snprintf(packet, sizeof(packet), "profile");
+  } else if (0 == wcscasecmp(L"on", w) || 0 == wcscasecmp(L"off", w) ||
+             0 == wcscasecmp(L"clear", w)) {
+    n = snprintf(packet, sizeof(packet), "profile %ls", w);
+    for (char *p = packet; '\0' != *p; ++p) {
+      *p = tolower((unsigned char)(*p));
+    }
+  } else if (0 == wcscasecmp(L"report", w) ||
+             0 == wcscasecmp(L"callgrind", w)) {
+    bool report = 0 == wcscasecmp(L"report", w);
+    w = parser_get_token(ptr);
+    if (NULL == w) {
+      cmd->error = wcsdup(L"error: missing filename");
+      return;
+    }
+    n = snprintf(packet,
+                 sizeof(packet),
+                 "profile %s %ls",
+                 report ? "report" : "callgrind",
+                 w);
+    if (n >= sizeof(packet) - 1) {
+      cmd->error = wcsdup(L"error: filename is too long");
+      return;
+    }
+  } else {
+    cmd->error = wcsdup(L"error: invalid profile command");
+    return;
+  }
+  elliott803_send(cmd->proc, packet, n + 1);
+}
+
+// sample [on [HZ]|off|clear|report [N]]
+static void
+command_sample(commands_t *cmd, const wchar_t *name, wchar_t **ptr) {
+
+  char packet[256];
+  int n = snprintf(packet, sizeof(packet), "sample");
+  const wchar_t *w = parser_get_token(ptr);
+  if (NULL != w) {
+    if (0 != wcscasecmp(L"on", w) && 0 != wcscasecmp(L"off", w) &&
+        0 != wcscasecmp(L"clear", w) && 0 != wcscasecmp(L"report", w)) {
+      cmd->error = wcsdup(L"error: invalid sample command");
+      return;
+    }
+    n += snprintf(&packet[n], sizeof(packet) - n, " %ls", w);
+    w = parser_get_token(ptr);
+    if (NULL != w) {
+      n += snprintf(&packet[n], sizeof(packet) - n, " %ls", w);
+    }
+    if (n >= (int)(sizeof(packet))) {
+      cmd->error = wcsdup(L"error: invalid sample command");
+      return;
+    }
+  }
+  for (int i = 0; i < n; ++i) {
+    packet[i] = tolower((unsigned char)(packet[i]));
+  }
+  elliott803_send(cmd->proc, packet, n + 1);
+}
+
+// flight [count]
+static void
+command_flight(commands_t *cmd, const wchar_t *name, wchar_t **ptr) {
+
+  const wchar_t *w = parser_get_token(ptr);
+  char packet[256];
+  size_t n = 0;
+  if (NULL == w) {
+    n = snprintf(packet, sizeof(packet), "flight");
+  } else {
+    n = snprintf(packet, sizeof(packet), "flight %ls", w);
+    if (n >= sizeof(packet) - 1) {
+      cmd->error = wcsdup(L"error: invalid flight count");
+      return;
+    }
+  }
+  elliott803_send(cmd->proc, packet, n + 1);
+}
+
+// trace [on file|off]
+static void
+command_trace(commands_t *cmd, const wchar_t *name, wchar_t **ptr) {
+
+  const wchar_t *w = parser_get_token(ptr);
+  char packet[1024];
+  size_t n = 0;
+  if (NULL == w) {
+    n = snprintf(packet, sizeof(packet), "trace");
+  } else if (0 == wcscasecmp(L"off", w)) {
+    n = snprintf(packet, sizeof(packet), "trace off");
+  } else if (0 == wcscasecmp(L"on", w)) {
+    w = parser_get_token(ptr);
+    if (NULL == w) {
+      cmd->error = wcsdup(L"error: missing filename");
+      return;
+    }
+    n = snprintf(packet, sizeof(packet), "trace on %ls", w);
+    if (n >= sizeof(packet) - 1) {
+      cmd->error = wcsdup(L"error: filename is too long");
+      return;
+    }
+  } else {
+    cmd->error = wcsdup(L"error: invalid trace command");
+    return;
+  }
+  elliott803_send(cmd->proc, packet, n + 1);
+}
+
+// keep a list of machines once there is more than one
+static void record_first_machine(commands_t *cmd) {
+  if (0 == cmd->machines) {
+    cmd->machine[0] = cmd->proc;
+    cmd->machines = 1;
+  }
+}
+
+// fork [count]
+// clone the selected machine, which stays selected
+static void command_fork(commands_t *cmd, const wchar_t *name, wchar_t **ptr) {
+
+  long count = 1;
+  const wchar_t *w = parser_get_token(ptr);
+  if (NULL != w) {
+    wchar_t *end = NULL;
+    count = wcstol(w, &end, 10);
+    if (L'\0' != *end || count < 1) {
+      cmd->error = wcsdup(L"error: invalid count");
+      return;
+    }
+  }
+  record_first_machine(cmd);
+  if (count > commands_machines - cmd->machines) {
+    cmd->error = wcsdup(L"error: too many machines");
+    return;
+  }
+
+  int n = elliott803_clone(cmd->proc, &cmd->machine[cmd->machines], count);
+  int first = cmd->machines + 1;
+  cmd->machines += n;
+
+  wchar_t message[256];
+  if (0 == n) {
+    swprintf(message, SizeOfArray(message), L"error: fork failed");
+  } else if (n < count) {
+    swprintf(message,
+             SizeOfArray(message),
+             L"error: only forked machines %d to %d",
+             first,
+             cmd->machines);
+  } else {
+    swprintf(message,
+             SizeOfArray(message),
+             L"forked machines %d to %d",
+             first,
+             cmd->machines);
+  }
+  cmd->error = wcsdup(message);
+}
+
+// machine [number]
+// select the machine that receives commands, or display the selection
+static void
+command_machine(commands_t *cmd, const wchar_t *name, wchar_t **ptr) {
+
+  record_first_machine(cmd);
+  const wchar_t *w = parser_get_token(ptr);
+  if (NULL != w) {
+    wchar_t *end = NULL;
+    long number = wcstol(w, &end, 10);
+    if (L'\0' != *end || number < 1 || number > cmd->machines) {
+      cmd->error = wcsdup(L"error: invalid machine");
+      return;
+    }
+    cmd->proc = cmd->machine[number - 1];
+  }
+
+  int selected = 0;
+  while (cmd->machine[selected] != cmd->proc) {
+    ++selected;
+  }
+  wchar_t message[256];
+  swprintf(message,
+           SizeOfArray(message),
+           L"machine %d of %d",
+           selected + 1,
+           cmd->machines);
+  cmd->error = wcsdup(message);
+}
+
 // help
 
 // clang-format off
@@ -436,6 +829,25 @@ static void command_help(commands_t *cmd, const wchar_t *name, wchar_t **ptr) {
     L"wg f1|f2 [F]              clear/or wg function 1/2 bits (octal)\n"    //
     L"wg n1 [N][/]              clear/or wg address 1 + B bits (decimal)\n" //
     L"wg n2 [N]                 clear/or wg address 2 bits (decimal)\n"     //
+    L"quantum [N]               instructions executed between polls\n"     //
+    L"stats                     display execution statistics\n"            //
+    L"engine [interpreter|jit]  select instruction execution engine\n"     //
+    L"clock [authentic|turbo]   pace as a real 803 or run at full speed\n" //
+    L"events [NAME...]          report: stop idle starved punch\n"        //
+    L"                          overflow limit, or all or none\n"         //
+    L"limit [N|off]             stop after N more instructions\n"         //
+    L"output [batch|char]       send punched characters in batches\n"     //
+    L"snapshot save|load FILE   save or restore the whole machine\n"      //
+    L"profile [on|off|clear]    count instructions at each address\n"     //
+    L"profile report FILE       write the counts as text\n"               //
+    L"profile callgrind FILE    write the counts for kcachegrind\n"       //
+    L"sample [on [HZ]|off]      sample the program counter [1000 Hz]\n"   //
+    L"sample clear              discard the samples\n"                    //
+    L"sample report [N]         display the N hottest addresses [10]\n"   //
+    L"flight [N]                display the last N instructions [128]\n"  //
+    L"trace [on FILE|off]       record each instruction, see emu803 -r\n" //
+    L"fork [N]                  clone the machine N times [1]\n"          //
+    L"machine [N]               select the machine to control\n"          //
     ;
 
   cmd->error = wcsdup(m);
@@ -460,6 +872,13 @@ static const command_t commands[] = {
   {L"regs", command_registers},  {L"r", command_registers},
   {L"hello", command_hello},     {L"reader", command_reader},
   {L"punch", command_punch},     {L"wg", command_word_generator},
+  {L"quantum", command_quantum}, {L"stats", command_statistics},
+  {L"engine", command_engine},   {L"clock", command_clock},
+  {L"events", command_events},   {L"limit", command_limit},
+  {L"output", command_output},   {L"snapshot", command_snapshot},
+  {L"fork", command_fork},       {L"machine", command_machine},
+  {L"profile", command_profile}, {L"sample", command_sample},
+  {L"flight", command_flight},   {L"trace", command_trace},
 
   {L"help", command_help},       {L"?", command_help},
 };
@@ -488,3 +907,37 @@ void commands_run(commands_t *cmd, wchar_t *buffer, size_t buffer_size) {
   cmd->error = wcsdup(L"error: invalid command");
   return;
 }
+
+void commands_wait_reply(commands_t *cmd) {
+  if (cmd->wait && cmd->wait_supplied) {
+    cmd->wait_supplied = false;
+    send_wait(cmd);
+    return;
+  }
+  cmd->wait = false;
+}
+
+int commands_machine_count(const commands_t *cmd) {
+  return 0 == cmd->machines ? 1 : cmd->machines;
+}
+
+elliott803_t *commands_get_machine(const commands_t *cmd, int number) {
+  return 0 == cmd->machines ? cmd->proc : cmd->machine[number - 1];
+}
+
+void commands_destroy_clones(commands_t *cmd) {
+  if (0 == cmd->machines) {
+    return;
+  }
+  for (int i = 1; i < cmd->machines; ++i) {
+    elliott803_destroy(cmd->machine[i]);
+  }
+  cmd->proc = cmd->machine[0];
+  cmd->machines = 0;
+}
+
+void commands_destroy_machines(commands_t *cmd) {
+  commands_destroy_clones(cmd);
+  elliott803_destroy(cmd->proc);
+  cmd->proc = NULL;
+}
@@ -19,17 +19,41 @@ typedef enum {
   commands_io_count,
 } commands_io_t;
 
+enum {
+  commands_machines = 16, // the first and any clones
+};
+
 // holds data passed to individual commands
 typedef struct {
   io5_file_t *file[commands_io_count];
-  elliott803_t *proc;
+  elliott803_t *proc;                       // selected machine
+  elliott803_t *machine[commands_machines]; // the first, then any clones
+  int machines;                             // 0 until the first fork
   bool exit_program;
-  bool wait;
-  int wait_delay;
+  bool wait;           // until the processor replies to "wait"
+  bool wait_supplied;  // tape was sent while waiting so wait again
+  int64_t wait_budget; // instructions before a wait ends, 0 for none
   int screen;
   wchar_t *error;
 } commands_t;
 
 void commands_run(commands_t *cmd, wchar_t *buffer, size_t buffer_size);
 
+// the processor replied to "wait"; the wait is over unless tape was sent
+// to a busy reader in the meantime, then it is repeated
+void commands_wait_reply(commands_t *cmd);
+
+// the number of machines, the first and any clones
+int commands_machine_count(const commands_t *cmd);
+
+// machine number 1 to commands_machine_count, all of which must be read as
+// an unselected machine stops when its messages are not
+elliott803_t *commands_get_machine(const commands_t *cmd, int number);
+
+// destroy any clones, selecting the first machine again
+void commands_destroy_clones(commands_t *cmd);
+
+// destroy the first machine and any clones
+void commands_destroy_machines(commands_t *cmd);
+
 #endif
@@ -9,78 +9,28 @@ int64_t alu_add(bool *overflow, int op, int64_t acc, int64_t a, int64_t n) {
   switch (op & 7) {
   default:
   case 0: // no-op
-    return a;
+    return alu_nop(overflow, acc, a, n);
 
-  case 1: { // negate: -a
-    if (0 == a) {
-      return 0;
-    }
-    int64_t ap = -a;
-    if (a == ap) {
-      *overflow = true;
-    }
-    return ap;
-  }
+  case 1: // negate: -a
+    return alu_negate(overflow, acc, a, n);
 
-  case 2: { // increment: n+1
-    int64_t np = n + one_bit;
-    // detect overflow + to -
-    if ((0 == (n & sign_bit)) && (0 != (np & sign_bit))) {
-      *overflow = true;
-    }
-    return np;
-  }
+  case 2: // increment: n+1
+    return alu_count(overflow, acc, a, n);
 
   case 3: // collate: a&n
-    return acc & n;
-
-  case 4: { // add: a+n
-    int64_t a1 = acc;
-    int overflow_flags = 0 == (a1 & sign_bit) ? 0 : 4;
-    int64_t a2 = n;
-    overflow_flags |= 0 == (a2 & sign_bit) ? 0 : 2;
-
-    int64_t sum = a1 + a2;
-    overflow_flags |= 0 == (sum & sign_bit) ? 0 : 1;
+    return alu_collate(overflow, acc, a, n);
 
-    if (overflow_flags == 1 || overflow_flags == 6) {
-      *overflow = true;
-    }
-    return sum;
-  }
+  case 4: // add: a+n
+    return alu_sum(overflow, acc, a, n);
 
-  case 5: { // subtract: a-n
-    int64_t a1 = acc;
-    int overflow_flags = 0 == (a1 & sign_bit) ? 0 : 4;
-    int64_t a2 = n;
-    overflow_flags |= 0 == (a2 & sign_bit) ? 0 : 2;
-
-    int64_t sum = a1 - a2;
-    overflow_flags |= 0 == (sum & sign_bit) ? 0 : 1;
-
-    if (overflow_flags == 3 || overflow_flags == 4) {
-      *overflow = true;
-    }
-    return sum;
-  }
+  case 5: // subtract: a-n
+    return alu_difference(overflow, acc, a, n);
 
   case 6: // clear: zero
-    return 0;
+    return alu_clear(overflow, acc, a, n);
 
-  case 7: { // negate and add: n-a
-    int64_t a1 = n;
-    int overflow_flags = 0 == (a1 & sign_bit) ? 0 : 4;
-    int64_t a2 = acc;
-    overflow_flags |= 0 == (a2 & sign_bit) ? 0 : 2;
-
-    int64_t sum = a1 - a2;
-    overflow_flags |= 0 == (sum & sign_bit) ? 0 : 1;
-
-    if (overflow_flags == 3 || overflow_flags == 4) {
-      *overflow = true;
-    }
-    return sum;
-  }
+  case 7: // negate and add: n-a
+    return alu_negate_add(overflow, acc, a, n);
   }
 }
 
@@ -234,3 +184,109 @@ int64_t alu_divide(bool *overflow, int64_t acc, int64_t ar, int64_t divisor) {
 
   return q;
 }
+
+// shifts
+// these work on the fields of the registers: a is the 39 bit signed
+// value of the accumulator and r the 38 bit value of the auxiliary
+// register which together form a 77 bit double length number; the
+// results are identical to shifting one place at a time for any count
+
+static const uint64_t ar_field_bits = 0x0000003fffffffffULL; // 38 bits
+
+static inline int minimum(int a, int b) { return a < b ? a : b; }
+
+// arithmetic right shift of a/ar, bits leaving a enter ar
+void alu_shift_right(int64_t *acc, int64_t *ar, int count) {
+  if (count <= 0) {
+    return;
+  }
+  int64_t a = *acc >> word_shift;
+  uint64_t r = (uint64_t)(*ar) >> word_shift;
+
+  if (count <= 38) {
+    r = (r >> count) | ((uint64_t)(a) << (38 - count));
+  } else {
+    r = (uint64_t)(a >> minimum(count - 38, 63));
+  }
+  a >>= minimum(count, 63);
+
+  *acc = (int64_t)((uint64_t)(a) << word_shift);
+  *ar = (int64_t)((r & ar_field_bits) << word_shift);
+}
+
+// logical right shift of a, the sign is shifted as a value bit
+int64_t alu_shift_right_logical(int64_t acc, int count) {
+  if (count <= 0) {
+    return acc;
+  } else if (count >= 39) {
+    return 0;
+  }
+  return (int64_t)(((uint64_t)(acc) >> count) & thirty_eight_bits);
+}
+
+// arithmetic left shift of a/ar, bits leaving ar enter a; overflow if
+// any bit shifted through the sign position differs from the original
+// sign
+void alu_shift_left(bool *overflow, int64_t *acc, int64_t *ar, int count) {
+  if (count <= 0) {
+    *ar &= thirty_eight_bits;
+    return;
+  }
+  int64_t a = *acc >> word_shift;
+  uint64_t r = ((uint64_t)(*ar) >> word_shift) & ar_field_bits;
+  int64_t sign = a >> 38; // 0 or -1
+
+  // bits of a then r that pass through the sign position
+  int count_a = minimum(count, 38);
+  int count_r = minimum(count, 76) - 38;
+  if ((a >> (38 - count_a)) != sign) {
+    *overflow = true;
+  } else if (count_r > 0 &&
+             (r >> (38 - count_r)) !=
+               ((uint64_t)(sign) & ((1ULL << count_r) - 1))) {
+    *overflow = true;
+  } else if (count > 76 && 0 != sign) {
+    *overflow = true; // zeros reached the sign
+  }
+
+  uint64_t ap = 0;
+  uint64_t rp = 0;
+  if (count <= 38) {
+    ap = ((uint64_t)(a) << count) | (r >> (38 - count));
+    rp = r << count;
+  } else if (count <= 76) {
+    ap = r << (count - 38);
+  }
+
+  *acc = (int64_t)(ap << word_shift);
+  *ar = (int64_t)((rp & ar_field_bits) << word_shift);
+}
+
+// logical left shift of a; overflow as for the arithmetic shift
+int64_t alu_shift_left_logical(bool *overflow, int64_t acc, int count) {
+  if (count <= 0) {
+    return acc;
+  }
+  int64_t a = acc >> word_shift;
+  int64_t sign = a >> 38; // 0 or -1
+
+  if ((a >> (38 - minimum(count, 38))) != sign ||
+      (count > 38 && 0 != sign)) {
+    *overflow = true;
+  }
+  if (count >= 39) {
+    return 0;
+  }
+  return (int64_t)((uint64_t)(acc) << count);
+}
+
+// rotate a left, the sign enters the least significant bit
+int64_t alu_rotate_left(int64_t acc, int count) {
+  int n = count % 39;
+  if (n <= 0) {
+    return acc;
+  }
+  uint64_t a = (uint64_t)(acc) >> word_shift;
+  a = (a << n) | (a >> (39 - n));
+  return (int64_t)(a << word_shift);
+}
@@ -6,6 +6,82 @@
 #include <stdbool.h>
 #include <stdint.h>
 
+#include "constants.h"
+
+// base operations of groups 0..3
+// these take the same arguments as alu_add so that a function can be
+// selected at compile time for each function code
+
+// no-op: a
+static inline int64_t
+alu_nop(bool *overflow, int64_t acc, int64_t a, int64_t n) {
+  return a;
+}
+
+// negate: -a
+static inline int64_t
+alu_negate(bool *overflow, int64_t acc, int64_t a, int64_t n) {
+  if (0 == a) {
+    return 0;
+  }
+  int64_t ap = (int64_t)(0 - (uint64_t)(a));
+  if (a == ap) {
+    *overflow = true;
+  }
+  return ap;
+}
+
+// increment: n+1
+static inline int64_t
+alu_count(bool *overflow, int64_t acc, int64_t a, int64_t n) {
+  int64_t np = (int64_t)((uint64_t)(n) + one_bit);
+  // detect overflow + to -
+  if ((0 == (n & sign_bit)) && (0 != (np & sign_bit))) {
+    *overflow = true;
+  }
+  return np;
+}
+
+// collate: a&n
+static inline int64_t
+alu_collate(bool *overflow, int64_t acc, int64_t a, int64_t n) {
+  return acc & n;
+}
+
+// add: a+n
+static inline int64_t
+alu_sum(bool *overflow, int64_t acc, int64_t a, int64_t n) {
+  int64_t sum = (int64_t)((uint64_t)(acc) + (uint64_t)(n));
+  // operands of same sign giving a result of the opposite sign
+  if (0 != ((acc ^ sum) & (n ^ sum) & sign_bit)) {
+    *overflow = true;
+  }
+  return sum;
+}
+
+// subtract: a-n
+static inline int64_t
+alu_difference(bool *overflow, int64_t acc, int64_t a, int64_t n) {
+  int64_t difference = (int64_t)((uint64_t)(acc) - (uint64_t)(n));
+  // operands of different sign giving a result with the sign of n
+  if (0 != ((acc ^ n) & (acc ^ difference) & sign_bit)) {
+    *overflow = true;
+  }
+  return difference;
+}
+
+// clear: zero
+static inline int64_t
+alu_clear(bool *overflow, int64_t acc, int64_t a, int64_t n) {
+  return 0;
+}
+
+// negate and add: n-a
+static inline int64_t
+alu_negate_add(bool *overflow, int64_t acc, int64_t a, int64_t n) {
+  return alu_difference(overflow, n, a, acc);
+}
+
 int64_t alu_add(bool *overflow, int op, int64_t acc, int64_t a, int64_t n);
 void alu_multiply(int64_t *acc, int64_t *ar, int64_t md1, int64_t mr1);
 int64_t alu_divide(bool *overflow,
@@ -13,4 +89,11 @@ int64_t alu_divide(bool *overflow,
                    int64_t dividend_low,
                    int64_t divisor);
 
+// shifts by any number of places in constant time
+void alu_shift_right(int64_t *acc, int64_t *ar, int count);
+int64_t alu_shift_right_logical(int64_t acc, int count);
+void alu_shift_left(bool *overflow, int64_t *acc, int64_t *ar, int count);
+int64_t alu_shift_left_logical(bool *overflow, int64_t acc, int count);
+int64_t alu_rotate_left(int64_t acc, int count);
+
 #endif
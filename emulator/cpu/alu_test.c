@@ -73,6 +73,134 @@ static void test_div(const char *title,
   }
 }
 
+// the shift functions must match shifting one place at a time exactly
+// as the instructions were originally implemented, for every count
+
+static void shift_failed(const char *title,
+                         int count,
+                         int64_t acc,
+                         int64_t ar,
+                         int64_t actual_acc,
+                         int64_t actual_ar,
+                         bool actual_overflow,
+                         int64_t expected_acc,
+                         int64_t expected_ar,
+                         bool expected_overflow) {
+  printf("%-16s: a: %013" PRIo64 " ar: %013" PRIo64 " count: %d\n"
+         "%-16s  actual:   %013" PRIo64 " %013" PRIo64 " (%s)\n"
+         "%-16s  expected: %013" PRIo64 " %013" PRIo64 " (%s)\n",
+         title,
+         (acc >> word_shift) & lsb_thirty_nine_bits,
+         (ar >> word_shift) & lsb_thirty_nine_bits,
+         count,
+         "",
+         (actual_acc >> word_shift) & lsb_thirty_nine_bits,
+         (actual_ar >> word_shift) & lsb_thirty_nine_bits,
+         actual_overflow ? "v" : "_",
+         "",
+         (expected_acc >> word_shift) & lsb_thirty_nine_bits,
+         (expected_ar >> word_shift) & lsb_thirty_nine_bits,
+         expected_overflow ? "V" : "_");
+  exit(1);
+}
+
+static void test_shifts(int64_t acc, int64_t ar) {
+
+  // 50  Arithmetic right shift a/ar N times
+  int64_t ea = acc;
+  int64_t er = ar;
+  for (int count = 1; count <= address_bits; ++count) {
+    ea >>= 1;
+    er >>= 1;
+    if (0 != (ea & half_bit)) {
+      er |= ar_msb;
+    }
+    ea &= thirty_nine_bits;
+    er &= thirty_eight_bits;
+
+    int64_t aa = acc;
+    int64_t ar1 = ar;
+    alu_shift_right(&aa, &ar1, count);
+    if (aa != ea || ar1 != er) {
+      shift_failed("50", count, acc, ar, aa, ar1, 0, ea, er, 0);
+    }
+  }
+
+  // 51  Logical right shift a N times
+  ea = acc;
+  for (int count = 1; count <= address_bits; ++count) {
+    ea >>= 1;
+    ea &= thirty_eight_bits;
+
+    int64_t aa = alu_shift_right_logical(acc, count);
+    if (aa != ea) {
+      shift_failed("51", count, acc, 0, aa, 0, 0, ea, 0, 0);
+    }
+  }
+
+  // 54  Arithmetic left shift a/ar N times
+  bool negative = acc < 0;
+  bool ev = false;
+  ea = acc;
+  er = ar;
+  for (int count = 1; count <= address_bits; ++count) {
+    er <<= 1;
+    if (0 != (er & sign_bit)) {
+      ea |= half_bit;
+    }
+    ea = (int64_t)((uint64_t)(ea) << 1);
+    if ((ea < 0) != negative) {
+      ev = true;
+    }
+
+    bool av = false;
+    int64_t aa = acc;
+    int64_t ar1 = ar;
+    alu_shift_left(&av, &aa, &ar1, count);
+    if (aa != ea || ar1 != (er & thirty_eight_bits) || av != ev) {
+      shift_failed(
+        "54", count, acc, ar, aa, ar1, av, ea, er & thirty_eight_bits, ev);
+    }
+  }
+
+  // 55  Logical left shift a N times
+  ev = false;
+  ea = acc;
+  for (int count = 1; count <= address_bits; ++count) {
+    ea = (int64_t)((uint64_t)(ea) << 1);
+    if ((ea < 0) != negative) {
+      ev = true;
+    }
+
+    bool av = false;
+    int64_t aa = alu_shift_left_logical(&av, acc, count);
+    if (aa != ea || av != ev) {
+      shift_failed("55", count, acc, 0, aa, 0, av, ea, 0, ev);
+    }
+  }
+
+  // 65  Fast left (end round) shift N places
+  ea = acc;
+  for (int count = 1; count < 4096; ++count) {
+    if (0 != (ea & sign_bit)) {
+      ea |= half_bit;
+    }
+    ea = (int64_t)((uint64_t)(ea) << 1);
+
+    int64_t aa = alu_rotate_left(acc, count);
+    if (aa != ea) {
+      shift_failed("65", count, acc, 0, aa, 0, 0, ea, 0, 0);
+    }
+  }
+}
+
+// deterministic pseudo random numbers
+static uint64_t random_bits(void) {
+  static uint64_t seed = 803;
+  seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+  return seed;
+}
+
 int main(int argc, char *argv[]) {
 
 #define INT803(x) ((x) << word_shift)
@@ -150,5 +278,24 @@ int main(int argc, char *argv[]) {
   // not exactly sure about this
   // test_div("S / S", sign_bit, zero, sign_bit, sign_bit);
 
+  const int64_t edges[] = {
+    zero, pos_1, pos_2, neg_1, neg_2, pos_max, neg_max, pos_highest,
+  };
+  for (size_t i = 0; i < sizeof(edges) / sizeof(edges[0]); ++i) {
+    for (size_t j = 0; j < sizeof(edges) / sizeof(edges[0]); ++j) {
+      test_shifts(edges[i], edges[j] & thirty_eight_bits);
+    }
+  }
+  for (int i = 0; i < 2000; ++i) {
+    int64_t acc = (int64_t)(random_bits()) & thirty_nine_bits;
+    int64_t ar = (int64_t)(random_bits()) & thirty_eight_bits;
+    // also values with long runs of sign bits
+    int run = random_bits() % 39;
+    if (0 != (i & 1)) {
+      acc = (int64_t)((uint64_t)(acc >> run) & (uint64_t)(thirty_nine_bits));
+    }
+    test_shifts(acc, ar);
+  }
+
   return 0;
 }
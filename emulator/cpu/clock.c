@@ -0,0 +1,83 @@
+// clock.c
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "clock.h"
+#include "constants.h"
+#include "processor.h"
+
+// time of each function in word times, shifts are extra
+// clang-format off
+static const uint8_t function_time[64] = {
+   2,  2,  2,  2,  2,  2,  2,  2, // group 0
+   2,  2,  2,  2,  2,  2,  2,  2, // group 1
+   2,  2,  2,  2,  2,  2,  2,  2, // group 2
+   2,  2,  2,  2,  2,  2,  2,  2, // group 3
+   2,  2,  2,  2,  2,  2,  2,  2, // group 4
+   2,  2, 25, 25,  2,  2, 26,  2, // group 5
+   4,  4,  4, 25, 42,  2,  2,  2, // group 6
+   2,  2,  2,  2,  2,  2,  2,  2, // group 7
+};
+// clang-format on
+
+static const int64_t shift_place_time = 72; // us
+
+int64_t clock_instruction_time(int op, int address) {
+  int64_t t = function_time[op & op_bits] * (int64_t)(word_time);
+  switch (op & op_bits) {
+  case 050:
+  case 051:
+  case 054:
+  case 055:
+    return t + shift_place_time * (address & address_bits);
+  case 065:
+    if (address < 4096) {
+      return t + shift_place_time * (address & 63) / 4;
+    }
+    return t + 2 * word_time; // standardise
+  default:
+    return t;
+  }
+}
+
+static int64_t now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000000LL + ts.tv_nsec / 1000;
+}
+
+void clock_start(processor_t *proc) {
+  if (proc->clock_running) {
+    return;
+  }
+  proc->clock_running = true;
+  proc->clock_start_wall = now();
+  proc->clock_start_emulated = proc->emulated_time;
+}
+
+void clock_stop(processor_t *proc) {
+  if (!proc->clock_running) {
+    return;
+  }
+  proc->clock_running = false;
+  proc->clock_wall += now() - proc->clock_start_wall;
+}
+
+int64_t clock_limit(processor_t *proc) {
+  return proc->clock_start_emulated + (now() - proc->clock_start_wall) +
+         clock_lead;
+}
+
+int64_t clock_ahead(processor_t *proc) {
+  return (proc->emulated_time - proc->clock_start_emulated) -
+         (now() - proc->clock_start_wall);
+}
+
+int64_t clock_wall_time(processor_t *proc) {
+  if (!proc->clock_running) {
+    return proc->clock_wall;
+  }
+  return proc->clock_wall + now() - proc->clock_start_wall;
+}
@@ -0,0 +1,44 @@
+// clock.h
+
+#if !defined(CLOCK_H)
+#define CLOCK_H 1
+
+#include <stdint.h>
+
+#include "processor.h"
+
+// emulated time of a real 803 in microseconds
+//
+// most functions take two word times, the shifts a further 72 us per
+// place and multiply, divide and floating point are charged their
+// approximate longer times; a character read or punched is charged
+// the time the device takes to transfer it
+//
+// in authentic mode the processor is paced so the emulated time keeps
+// step with real time, in turbo mode it runs as fast as possible
+
+enum {
+  word_time = 288,                // us
+  reader_char_time = 2000,        // 500 characters per second
+  punch_char_time = 10000,        // 100 characters per second
+  teleprinter_char_time = 100000, // 10 characters per second
+  clock_lead = 2000,              // us emulated time may run ahead
+};
+
+// time of one instruction, excluding any character transfer
+int64_t clock_instruction_time(int op, int address);
+
+// a period of execution begins or ends
+void clock_start(processor_t *proc);
+void clock_stop(processor_t *proc);
+
+// emulated time at which throttled execution must pause
+int64_t clock_limit(processor_t *proc);
+
+// microseconds the emulated time is ahead of real time
+int64_t clock_ahead(processor_t *proc);
+
+// total real time in microseconds spent executing
+int64_t clock_wall_time(processor_t *proc);
+
+#endif
@@ -0,0 +1,104 @@
+// clock_test.c
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "buffer.h"
+#include "clock.h"
+#include "constants.h"
+#include "core.h"
+#include "cpu803.h"
+#include "processor.h"
+
+// run from address until the processor stops
+static void run(processor_t *proc, int address) {
+  proc->program_counter = address << 1;
+  proc->mode = exec_mode_run;
+  for (int i = 0; i < 1000; ++i) {
+    cpu803_execute(proc);
+    if (exec_mode_stop == proc->mode || busy_none != proc->io_busy) {
+      return;
+    }
+  }
+  printf("program at: %d did not stop\n", address);
+  exit(1);
+}
+
+static void check(const char *title, int64_t actual, int64_t expected) {
+  if (actual != expected) {
+    printf("%-24s: actual:   %" PRId64 "\n"
+           "%-24s  expected: %" PRId64 "\n",
+           title,
+           actual,
+           "",
+           expected);
+    exit(1);
+  }
+}
+
+int main(int argc, char *argv[]) {
+
+  processor_t *proc = calloc(1, sizeof(processor_t));
+  if (NULL == proc) {
+    printf("calloc failed\n");
+    return 1;
+  }
+
+  check("add", clock_instruction_time(004, 4096), 2 * word_time);
+  check("shift 0", clock_instruction_time(050, 0), 2 * word_time);
+  check("shift 10", clock_instruction_time(055, 10), 2 * word_time + 720);
+  check("multiply", clock_instruction_time(053, 4096), 25 * word_time);
+  check("standardise",
+        clock_instruction_time(065, 4096),
+        clock_instruction_time(060, 0));
+
+  // a word of add and shift, a multiply and a stop
+  core_write(proc, 4096, ELLIOTT(004, 4200, 0, 054, 3));
+  core_write(proc, 4097, ELLIOTT(053, 4200, 0, 000, 0));
+  core_write(proc, 4098, ELLIOTT(040, 4098, 0, 000, 0));
+  run(proc, 4096);
+  check("program time",
+        proc->emulated_time,
+        (2 + 2 + 25 + 2 + 2) * word_time + 3 * 72);
+
+  // a B-modified shift is charged for its modified count
+  proc->emulated_time = 0;
+  core_write(proc, 4099, ELLIOTT(000, 4201, 1, 050, 0));
+  core_write(proc, 4100, ELLIOTT(040, 4100, 0, 000, 0));
+  core_write(proc, 4201, (int64_t)(5) << second_address_shift);
+  run(proc, 4099);
+  check("modified time", proc->emulated_time, 3 * 2 * word_time + 5 * 72);
+
+  // characters are charged the device time only when transferred
+  proc->emulated_time = 0;
+  core_write(proc, 4101, ELLIOTT(071, 0, 0, 074, 4096));
+  core_write(proc, 4102, ELLIOTT(040, 4102, 0, 000, 0));
+  run(proc, 4101);
+  check("reader busy", proc->io_busy, busy_reader_1);
+  check("busy time", proc->emulated_time, 2 * word_time);
+  proc->io_busy = busy_none;
+  buffer_put(&proc->reader[0], 1);
+  proc->emulated_time = 0;
+  run(proc, 4101);
+  check("character time",
+        proc->emulated_time,
+        3 * 2 * word_time + reader_char_time + teleprinter_char_time);
+
+  // pacing follows real time
+  clock_start(proc);
+  check("ahead at start", clock_ahead(proc) > 0, false);
+  proc->emulated_time += 1000000;
+  check("ahead", clock_ahead(proc) > 900000, true);
+  check("limit", clock_limit(proc) < proc->emulated_time, true);
+  struct timespec pause = {.tv_sec = 0, .tv_nsec = 20000000};
+  nanosleep(&pause, NULL);
+  clock_stop(proc);
+  check("wall time", clock_wall_time(proc) >= 20000, true);
+
+  free(proc);
+  return 0;
+}
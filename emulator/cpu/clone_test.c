@@ -0,0 +1,140 @@
+// clone_test.c
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/select.h>
+#include <time.h>
+
+#include "elliott803.h"
+
+enum {
+  clone_count = 3,
+};
+
+static void check(const char *title, bool ok) {
+  if (!ok) {
+    printf("failed: %s\n", title);
+    exit(1);
+  }
+}
+
+static void command(elliott803_t *proc, const char *s) {
+  elliott803_send(proc, s, strlen(s) + 1);
+}
+
+// receive messages until one starts with prefix, which is returned in
+// buffer, false on timeout
+static bool
+expect(elliott803_t *proc, const char *prefix, char *buffer, size_t size) {
+  int fd = elliott803_get_fd(proc);
+  time_t deadline = time(NULL) + 5;
+  for (;;) {
+    fd_set fds;
+    FD_ZERO(&fds);
+    FD_SET(fd, &fds);
+    struct timeval timeout = {
+      .tv_sec = deadline - time(NULL),
+      .tv_usec = 0,
+    };
+    if (timeout.tv_sec <= 0) {
+      return false;
+    }
+    int rc = select(FD_SETSIZE, &fds, NULL, NULL, &timeout);
+    if (-1 == rc && EINTR == errno) {
+      continue;
+    }
+    if (rc <= 0) {
+      return false;
+    }
+    ssize_t n = elliott803_receive(proc, buffer, size - 1);
+    if (n <= 0) {
+      continue;
+    }
+    buffer[n] = '\0';
+    if (0 == strncmp(prefix, buffer, strlen(prefix))) {
+      return true;
+    }
+  }
+}
+
+// the numeric part of a word read with "mr"
+static long long read_word(elliott803_t *proc, int address) {
+  char buffer[256];
+  snprintf(buffer, sizeof(buffer), "mr %d", address);
+  command(proc, buffer);
+  check("mr", expect(proc, "mr", buffer, sizeof(buffer)));
+  const char *s = strrchr(buffer, ' ');
+  check("mr value", NULL != s);
+  return strtoll(s, NULL, 10);
+}
+
+int main(int argc, char *argv[]) {
+
+  char buffer[1024];
+  elliott803_t *proc = elliott803_create("clone test");
+  check("create", NULL != proc);
+
+  // count in 4200 until stopped
+  command(proc, "events stop");
+  check("events", expect(proc, "events stop", buffer, sizeof(buffer)));
+  command(proc, "mw 4200 +1");
+  command(proc, "mw 4100 22 4200 : 40 4100");
+  command(proc, "mw 4101 40 4101 : 00 0");
+
+  // clone a stopped machine
+  elliott803_t *clones[clone_count];
+  check("clone", clone_count == elliott803_clone(proc, clones, clone_count));
+  for (int i = 0; i < clone_count; ++i) {
+    check("cloned store", 1 == read_word(clones[i], 4200));
+  }
+
+  // each runs its own program on its own copy of the store, events are
+  // for the parent's client so a clone's must subscribe again
+  for (int i = 0; i < clone_count; ++i) {
+    command(clones[i], "events stop");
+    snprintf(buffer, sizeof(buffer), "mw 4200 +%d", 100 * (i + 1));
+    command(clones[i], buffer);
+    command(clones[i], "run 4101");
+    check("clone stop",
+          expect(clones[i], "event stop", buffer, sizeof(buffer)));
+  }
+  for (int i = 0; i < clone_count; ++i) {
+    check("clone store", 100 * (i + 1) == read_word(clones[i], 4200));
+  }
+  check("parent store", 1 == read_word(proc, 4200));
+
+  // a clone shares the pages it has not written
+  command(clones[0], "stats");
+  check("stats memory",
+        expect(clones[0], "stats memory", buffer, sizeof(buffer)));
+  size_t private_kb = 0;
+  size_t shared_kb = 0;
+  check("stats format",
+        2 == sscanf(buffer,
+                    "stats memory %zu KB private %zu KB shared",
+                    &private_kb,
+                    &shared_kb));
+  check("mostly shared", private_kb < 64 && shared_kb > 0);
+
+  // clone a running machine, which carries on counting
+  command(proc, "run 4100");
+  elliott803_t *running = NULL;
+  check("clone running", 1 == elliott803_clone(proc, &running, 1));
+  command(proc, "stop");
+  check("stop", expect(proc, "event stop", buffer, sizeof(buffer)));
+  long long count = read_word(running, 4200);
+  check("clone counts", read_word(running, 4200) > count);
+  command(running, "stop");
+
+  check("no clones", 0 == elliott803_clone(proc, clones, 0));
+
+  elliott803_destroy(running);
+  for (int i = 0; i < clone_count; ++i) {
+    elliott803_destroy(clones[i]);
+  }
+  elliott803_destroy(proc);
+  return 0;
+}
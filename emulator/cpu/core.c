@@ -1,7 +1,11 @@
 // core.c
 
+#include <string.h>
+
 #include "core.h"
+#include "jit.h"
 #include "processor.h"
+#include "trace.h"
 
 static const uint64_t T1[4] = {
   ELLIOTT(026, 4, 0, 006, 0), // 0
@@ -27,3 +31,71 @@ int64_t core_read_program(processor_t *proc, int address) {
   }
   return proc->core_store[address];
 }
+
+// a word was changed so discard any predecoded or translated copy
+static void changed(processor_t *proc, int address) {
+  ++proc->store_changes;
+  if (NULL != proc->trace) {
+    trace_store(proc, address);
+  }
+  if (proc->decoded[address].valid) {
+    proc->decoded[address].valid = false;
+    ++proc->decode_invalidations;
+    if (NULL != proc->jit) {
+      jit_invalidate(proc, address);
+    }
+  }
+}
+
+// write data to core and discard any predecoded or translated copy of
+// the word
+void core_write(processor_t *proc, int address, int64_t value) {
+  address &= address_bits;
+  if (proc->core_store[address] == value) {
+    return; // nothing changed so any decoded copy is still valid
+  }
+  proc->core_store[address] = value;
+  changed(proc, address);
+}
+
+// read consecutive words; addresses wrap at the end of the store
+void core_read_block(processor_t *proc,
+                     int address,
+                     int64_t *values,
+                     int count) {
+  while (count > 0) {
+    address &= address_bits;
+    int n = memory_size - address < count ? memory_size - address : count;
+    memcpy(values, &proc->core_store[address], n * sizeof(int64_t));
+    for (int i = address; i < 4 && i < address + n; ++i) {
+      values[i - address] = 0; // as core_read
+    }
+    address += n;
+    values += n;
+    count -= n;
+  }
+}
+
+// write consecutive words as core_write; unchanged runs are skipped
+// with a single compare
+void core_write_block(processor_t *proc,
+                      int address,
+                      const int64_t *values,
+                      int count) {
+  while (count > 0) {
+    address &= address_bits;
+    int n = memory_size - address < count ? memory_size - address : count;
+    int64_t *store = &proc->core_store[address];
+    if (0 != memcmp(store, values, n * sizeof(int64_t))) {
+      for (int i = 0; i < n; ++i) {
+        if (store[i] != values[i]) {
+          store[i] = values[i];
+          changed(proc, address + i);
+        }
+      }
+    }
+    address += n;
+    values += n;
+    count -= n;
+  }
+}
@@ -7,5 +7,16 @@
 
 int64_t core_read(processor_t *proc, int address);
 int64_t core_read_program(processor_t *proc, int address);
+void core_write(processor_t *proc, int address, int64_t value);
+
+// block transfers of count words
+void core_read_block(processor_t *proc,
+                     int address,
+                     int64_t *values,
+                     int count);
+void core_write_block(processor_t *proc,
+                      int address,
+                      const int64_t *values,
+                      int count);
 
 #endif
@@ -3,16 +3,41 @@
 #include <stdio.h>
 
 #include "alu.h"
+#include "clock.h"
 #include "core.h"
 #include "cpu803.h"
+#include "film.h"
+#include "flight.h"
 #include "fpu.h"
 #include "processor.h"
 #include "pts.h"
 
+#if defined(SWITCH_DISPATCH)
+
+// functions that use the value of store location N
+// clang-format off
+static const bool operand_used[64] = {
+  [000] = true, [001] = true, [002] = true, [003] = true, // group 0
+  [004] = true, [005] = true, [006] = true, [007] = true, //
+  [010] = true, [011] = true, [012] = true, [013] = true, // group 1
+  [014] = true, [015] = true, [016] = true, [017] = true, //
+  [020] = true, [021] = true, [022] = true, [023] = true, // group 2
+  [024] = true, [025] = true, [026] = true, [027] = true, //
+  [030] = true, [031] = true, [032] = true, [033] = true, // group 3
+  [034] = true, [035] = true, [036] = true, [037] = true, //
+  [052] = true, [053] = true, [056] = true,               // mpy/div
+  [060] = true, [061] = true, [062] = true, [063] = true, // floating
+  [064] = true,                                           //
+};
+// clang-format on
+
 // instruction decoding and execution
 static void cpu(processor_t *proc, int op, int address) {
 
-  int64_t n = core_read(proc, address);
+  int64_t n = 0;
+  if (operand_used[op]) {
+    n = core_read(proc, address);
+  }
   int next_pc = proc->program_counter + 1;
 
   switch ((op >> 3) & 7) {
@@ -45,7 +70,7 @@ static void cpu(processor_t *proc, int op, int address) {
     // 16  Write and clear                        zero      a
     // 17  Write, negate and add                  n - a     a
     // clang-format on
-    proc->core_store[address] = proc->accumulator;
+    core_write(proc, address, proc->accumulator);
     proc->accumulator = alu_add(&proc->overflow, op, proc->accumulator, n, n);
     break;
 
@@ -61,8 +86,10 @@ static void cpu(processor_t *proc, int op, int address) {
     // 26  Clear store                            a         zero
     // 27  Subtract from store                    a         n - a
     // clang-format on
-    proc->core_store[address] =
-      alu_add(&proc->overflow, op, proc->accumulator, proc->accumulator, n);
+    core_write(
+      proc,
+      address,
+      alu_add(&proc->overflow, op, proc->accumulator, proc->accumulator, n));
     break;
 
   case 3:
@@ -77,8 +104,8 @@ static void cpu(processor_t *proc, int op, int address) {
     // 36  Replace and clear store                n         zero
     // 37  Replace and subtract from store        n         n - a
     // clang-format on
-    proc->core_store[address] =
-      alu_add(&proc->overflow, op, proc->accumulator, n, n);
+    core_write(
+      proc, address, alu_add(&proc->overflow, op, proc->accumulator, n, n));
     proc->accumulator = n;
     break;
 
@@ -147,23 +174,11 @@ static void cpu(processor_t *proc, int op, int address) {
     // 57  Copy ar to a, set sign bit zero, do NOT clear the ar
     // clang-format on
     switch (op & 7) {
-    case 0: {
-      for (int i = 0; i < address; ++i) {
-        proc->accumulator >>= 1;
-        proc->auxiliary_register >>= 1;
-        if (0 != (proc->accumulator & half_bit)) {
-          proc->auxiliary_register |= ar_msb;
-        }
-        proc->accumulator &= thirty_nine_bits;
-        proc->auxiliary_register &= thirty_eight_bits;
-      }
+    case 0:
+      alu_shift_right(&proc->accumulator, &proc->auxiliary_register, address);
       break;
-    }
     case 1:
-      for (int i = 0; i < address; ++i) {
-        proc->accumulator >>= 1;
-        proc->accumulator &= thirty_eight_bits; // exclude sign
-      }
+      proc->accumulator = alu_shift_right_logical(proc->accumulator, address);
       proc->auxiliary_register = 0;
       break;
     case 2:
@@ -185,32 +200,17 @@ static void cpu(processor_t *proc, int op, int address) {
       proc->auxiliary_register = 0;
       break;
     }
-    case 4: {
-      bool negative = proc->accumulator < 0;
-      for (int i = 0; i < address; ++i) {
-        proc->auxiliary_register <<= 1;
-        if (0 != (proc->auxiliary_register & sign_bit)) {
-          proc->accumulator |= half_bit;
-        }
-        proc->accumulator <<= 1;
-        if ((proc->accumulator < 0) != negative) {
-          proc->overflow = true;
-        }
-      }
-      proc->auxiliary_register &= thirty_eight_bits;
+    case 4:
+      alu_shift_left(&proc->overflow,
+                     &proc->accumulator,
+                     &proc->auxiliary_register,
+                     address);
       break;
-    }
-    case 5: {
-      bool negative = proc->accumulator < 0;
-      for (int i = 0; i < address; ++i) {
-        proc->accumulator <<= 1;
-        if ((proc->accumulator < 0) != negative) {
-          proc->overflow = true;
-        }
-      }
+    case 5:
+      proc->accumulator =
+        alu_shift_left_logical(&proc->overflow, proc->accumulator, address);
       proc->auxiliary_register = 0;
       break;
-    }
     case 6:
       proc->accumulator = alu_divide(
         &proc->overflow, proc->accumulator, proc->auxiliary_register, n);
@@ -282,12 +282,7 @@ static void cpu(processor_t *proc, int op, int address) {
       break;
     case 5:
       if (address < 4096) {
-        for (int i = 0; i < address; ++i) {
-          if (0 != (proc->accumulator & sign_bit)) {
-            proc->accumulator |= half_bit;
-          }
-          proc->accumulator <<= 1;
-        }
+        proc->accumulator = alu_rotate_left(proc->accumulator, address);
       } else {
         proc->accumulator = fpu_standardise(proc->accumulator);
       }
@@ -295,10 +290,12 @@ static void cpu(processor_t *proc, int op, int address) {
     case 6:
       printf("66 not implemented\n");
       proc->mode = exec_mode_stop;
+      proc->fault = true;
       break;
     case 7:
       printf("67 not implemented\n");
       proc->mode = exec_mode_stop;
+      proc->fault = true;
       break;
     }
     break;
@@ -311,8 +308,8 @@ static void cpu(processor_t *proc, int op, int address) {
     // 73  Write the address of this instruction to location N
     // 74  Punch tape / teleprinter character N
     //     0 = channel 1,  2048 = channel 2,  4096 = tty output
-    // 75  Film handler
-    // 76  Film handler
+    // 75  Film handler status to the accumulator
+    // 76  Film handler function select
     // 77  Block transfer
     // clang-format on
     switch (op & 7) {
@@ -324,11 +321,11 @@ static void cpu(processor_t *proc, int op, int address) {
       int unit = 1;
       busy_t reader_busy = busy_reader_1;
       if (0 != (address & 2048)) {
-        n = 2;
+        unit = 2;
         reader_busy = busy_reader_2;
       }
       if (0 != (address & 4096)) {
-        n = 3;
+        unit = 3;
         reader_busy = busy_reader_3;
       }
       uint8_t c = 0;
@@ -342,13 +339,16 @@ static void cpu(processor_t *proc, int op, int address) {
     case 2:
       printf("72 not implemented\n");
       proc->mode = exec_mode_stop;
+      proc->fault = true;
       break;
     case 3:
       // align integer part of program counter to second address
       // position of memory word
-      proc->core_store[address] =
+      core_write(
+        proc,
+        address,
         ((int64_t)(proc->program_counter) << (second_address_shift - 1)) &
-        thirty_nine_bits;
+          thirty_nine_bits);
       break;
     case 4: {
       int unit = 1;
@@ -368,16 +368,17 @@ static void cpu(processor_t *proc, int op, int address) {
       break;
     }
     case 5:
-      printf("75 not implemented\n");
-      proc->mode = exec_mode_stop;
+      proc->accumulator = film_status(proc, address);
       break;
     case 6:
-      printf("76 not implemented\n");
-      proc->mode = exec_mode_stop;
+      film_select(proc, address);
       break;
     case 7:
-      printf("77 not implemented\n");
-      proc->mode = exec_mode_stop;
+      if (!film_transfer(proc, address)) {
+        printf("77 film allocation failed\n");
+        proc->mode = exec_mode_stop;
+        proc->fault = true;
+      }
       break;
     }
     break;
@@ -395,44 +396,545 @@ static void cpu(processor_t *proc, int op, int address) {
   proc->program_counter = next_pc;
 }
 
-void cpu803_execute(processor_t *proc) {
+// there are no separate handlers
+cpu803_handler_t *cpu803_handler(int op) { return NULL; }
+
+#else
+
+// one handler per function code, selected from a table by the function
+// code; each handler is responsible for advancing the program counter
+
+// transfer control; a jump to itself is a stop
+static inline void jump(processor_t *proc, int next_pc) {
+  if (proc->program_counter == next_pc) {
+    proc->mode = exec_mode_stop;
+  }
+  proc->program_counter = next_pc;
+}
+
+// clang-format off
+// Op  Operation                              a'        n'
+// 00  Do nothing                             a         n
+// 01  Negate                                 -a        n
+// 02  Replace & count                        n + 1     n
+// 03  Collate                                a & n     n
+// 04  Add                                    a + n     n
+// 05  Subtract                               a - n     n
+// 06  Clear                                  zero      n
+// 07  Negate & add                           n - a     n
+// clang-format on
+#define GROUP_0(OP, FN)                                                        \
+  static void f##OP(processor_t *proc, int address) {                          \
+    int64_t n = core_read(proc, address);                                      \
+    proc->accumulator =                                                        \
+      FN(&proc->overflow, proc->accumulator, proc->accumulator, n);            \
+    ++proc->program_counter;                                                   \
+  }
+
+GROUP_0(00, alu_nop)
+GROUP_0(01, alu_negate)
+GROUP_0(02, alu_count)
+GROUP_0(03, alu_collate)
+GROUP_0(04, alu_sum)
+GROUP_0(05, alu_difference)
+GROUP_0(06, alu_clear)
+GROUP_0(07, alu_negate_add)
+
+// clang-format off
+// Op  Operation                              a'        n'
+// 10  Exchange                               n         a
+// 11  Exchange and negate                    -n        a
+// 12  Exchange and count                     n + 1     a
+// 13  Write and collate                      a & n     a
+// 14  Write and add                          a + n     a
+// 15  Write and subtract                     a - n     a
+// 16  Write and clear                        zero      a
+// 17  Write, negate and add                  n - a     a
+// clang-format on
+#define GROUP_1(OP, FN)                                                        \
+  static void f##OP(processor_t *proc, int address) {                          \
+    int64_t n = core_read(proc, address);                                      \
+    core_write(proc, address, proc->accumulator);                              \
+    proc->accumulator = FN(&proc->overflow, proc->accumulator, n, n);          \
+    ++proc->program_counter;                                                   \
+  }
+
+GROUP_1(10, alu_nop)
+GROUP_1(11, alu_negate)
+GROUP_1(12, alu_count)
+GROUP_1(13, alu_collate)
+GROUP_1(14, alu_sum)
+GROUP_1(15, alu_difference)
+GROUP_1(16, alu_clear)
+GROUP_1(17, alu_negate_add)
+
+// clang-format off
+// Op  Operation                              a'        n'
+// 20  Write                                  a         a
+// 21  Write negatively                       a         -a
+// 22  Count in store                         a         n + 1
+// 23  Collate in store                       a         a & n
+// 24  Add into store                         a         a + n
+// 25  Negate store and add                   a         a - n
+// 26  Clear store                            a         zero
+// 27  Subtract from store                    a         n - a
+// clang-format on
+#define GROUP_2(OP, FN)                                                        \
+  static void f##OP(processor_t *proc, int address) {                          \
+    int64_t n = core_read(proc, address);                                      \
+    core_write(                                                                \
+      proc,                                                                    \
+      address,                                                                 \
+      FN(&proc->overflow, proc->accumulator, proc->accumulator, n));           \
+    ++proc->program_counter;                                                   \
+  }
+
+GROUP_2(20, alu_nop)
+GROUP_2(21, alu_negate)
+GROUP_2(22, alu_count)
+GROUP_2(23, alu_collate)
+GROUP_2(24, alu_sum)
+GROUP_2(25, alu_difference)
+GROUP_2(26, alu_clear)
+GROUP_2(27, alu_negate_add)
+
+// clang-format off
+// Op  Operation                              a'        n'
+// 30  Replace                                n         n
+// 31  Replace and negate store               n         -n
+// 32  Replace and count in store             n         n + 1
+// 33  Replace and collate in store           n         a & n
+// 34  Replace and add to store               n         a + n
+// 35  Replace, negate store and add          n         a - n
+// 36  Replace and clear store                n         zero
+// 37  Replace and subtract from store        n         n - a
+// clang-format on
+#define GROUP_3(OP, FN)                                                        \
+  static void f##OP(processor_t *proc, int address) {                          \
+    int64_t n = core_read(proc, address);                                      \
+    core_write(proc, address, FN(&proc->overflow, proc->accumulator, n, n));   \
+    proc->accumulator = n;                                                     \
+    ++proc->program_counter;                                                   \
+  }
+
+GROUP_3(30, alu_nop)
+GROUP_3(31, alu_negate)
+GROUP_3(32, alu_count)
+GROUP_3(33, alu_collate)
+GROUP_3(34, alu_sum)
+GROUP_3(35, alu_difference)
+GROUP_3(36, alu_clear)
+GROUP_3(37, alu_negate_add)
+
+// 40  Transfer to 1st instruction unconditionally
+static void f40(processor_t *proc, int address) { jump(proc, address << 1); }
+
+// 41  Transfer to 1st instruction if a is negative
+static void f41(processor_t *proc, int address) {
+  if (proc->accumulator < 0) {
+    jump(proc, address << 1);
+  } else {
+    ++proc->program_counter;
+  }
+}
+
+// 42  Transfer to 1st instruction if a is zero
+static void f42(processor_t *proc, int address) {
+  if (0 == proc->accumulator) {
+    jump(proc, address << 1);
+  } else {
+    ++proc->program_counter;
+  }
+}
+
+// 43  Transfer to 1st instruction if overflow set, and clear it
+// since 43 and 47 clear the overflow they cannot cause a stop
+static void f43(processor_t *proc, int address) {
+  if (proc->overflow) {
+    proc->program_counter = address << 1;
+    proc->overflow = false;
+  } else {
+    ++proc->program_counter;
+  }
+}
+
+// 44  Transfer to 2nd instruction unconditionally
+static void f44(processor_t *proc, int address) {
+  jump(proc, (address << 1) | 1);
+}
+
+// 45  Transfer to 2nd instruction if a is negative
+static void f45(processor_t *proc, int address) {
+  if (proc->accumulator < 0) {
+    jump(proc, (address << 1) | 1);
+  } else {
+    ++proc->program_counter;
+  }
+}
+
+// 46  Transfer to 2nd instruction if a is zero
+static void f46(processor_t *proc, int address) {
+  if (0 == proc->accumulator) {
+    jump(proc, (address << 1) | 1);
+  } else {
+    ++proc->program_counter;
+  }
+}
+
+// 47  Transfer to 2nd instruction if overflow set, and clear it
+static void f47(processor_t *proc, int address) {
+  if (proc->overflow) {
+    proc->program_counter = (address << 1) | 1;
+    proc->overflow = false;
+  } else {
+    ++proc->program_counter;
+  }
+}
+
+// 50  Arithmetic right shift a/ar N times
+static void f50(processor_t *proc, int address) {
+  alu_shift_right(&proc->accumulator, &proc->auxiliary_register, address);
+  ++proc->program_counter;
+}
+
+// 51  Logical right shift a N times, clear ar (do not retain sign)
+static void f51(processor_t *proc, int address) {
+  proc->accumulator = alu_shift_right_logical(proc->accumulator, address);
+  proc->auxiliary_register = 0;
+  ++proc->program_counter;
+}
+
+// 52  Multiply a by n, result to a/ar
+static void f52(processor_t *proc, int address) {
+  int64_t n = core_read(proc, address);
+  alu_multiply(
+    &proc->accumulator, &proc->auxiliary_register, proc->accumulator, n);
+  ++proc->program_counter;
+}
+
+// 53  Multiply a by n, single length rounded result to a, clear ar
+static void f53(processor_t *proc, int address) {
+  int64_t n = core_read(proc, address);
+  int64_t ah = 0;
+  int64_t al = 0;
+  alu_multiply(&ah, &al, proc->accumulator, n);
+
+  if (thirty_nine_bits == ah) {
+    proc->accumulator = al | sign_bit;
+  } else if (0 == ah) {
+    proc->accumulator = al;
+  } else {
+    proc->overflow = true;
+  }
+  proc->auxiliary_register = 0;
+  ++proc->program_counter;
+}
+
+// 54  Arithmetic left shift a/ar N times
+static void f54(processor_t *proc, int address) {
+  alu_shift_left(&proc->overflow,
+                 &proc->accumulator,
+                 &proc->auxiliary_register,
+                 address);
+  ++proc->program_counter;
+}
+
+// 55  Logical left shift a N times, clear ar
+static void f55(processor_t *proc, int address) {
+  proc->accumulator =
+    alu_shift_left_logical(&proc->overflow, proc->accumulator, address);
+  proc->auxiliary_register = 0;
+  ++proc->program_counter;
+}
+
+// 56  Divide a/ar by n, single length quotient to a, clear ar
+static void f56(processor_t *proc, int address) {
+  int64_t n = core_read(proc, address);
+  proc->accumulator = alu_divide(
+    &proc->overflow, proc->accumulator, proc->auxiliary_register, n);
+  proc->auxiliary_register = 0;
+  ++proc->program_counter;
+}
+
+// 57  Copy ar to a, set sign bit zero, do NOT clear the ar
+static void f57(processor_t *proc, int address) {
+  proc->accumulator = proc->auxiliary_register;
+  ++proc->program_counter;
+}
+
+// group 6 instructions clear the auxiliary register.
+
+// 60  Add                                    a + n     n
+static void f60(processor_t *proc, int address) {
+  int64_t n = core_read(proc, address);
+  proc->auxiliary_register = 0;
+  proc->accumulator = fpu_add(&proc->overflow, proc->accumulator, n);
+  ++proc->program_counter;
+}
+
+// 61  Subtract                               a - n     n
+static void f61(processor_t *proc, int address) {
+  int64_t n = core_read(proc, address);
+  proc->auxiliary_register = 0;
+  proc->accumulator = fpu_add(&proc->overflow, proc->accumulator, fpu_neg(n));
+  ++proc->program_counter;
+}
+
+// 62  Negate and Add                         n - a     n
+static void f62(processor_t *proc, int address) {
+  int64_t n = core_read(proc, address);
+  proc->auxiliary_register = 0;
+  proc->accumulator = fpu_add(&proc->overflow, fpu_neg(proc->accumulator), n);
+  ++proc->program_counter;
+}
+
+// 63  Multiply                               a * n     n
+static void f63(processor_t *proc, int address) {
+  int64_t n = core_read(proc, address);
+  proc->auxiliary_register = 0;
+  proc->accumulator = fpu_mpy(&proc->overflow, proc->accumulator, n);
+  ++proc->program_counter;
+}
+
+// 64  Divide                                 a / n     n
+static void f64(processor_t *proc, int address) {
+  int64_t n = core_read(proc, address);
+  proc->auxiliary_register = 0;
+  proc->accumulator = fpu_div(&proc->overflow, proc->accumulator, n);
+  ++proc->program_counter;
+}
+
+// 65  N = 4096: integer in the accumulator to floating point
+// 65  N < 4096: Fast left (end round) shift N mod 64 places
+static void f65(processor_t *proc, int address) {
+  proc->auxiliary_register = 0;
+  if (address < 4096) {
+    proc->accumulator = alu_rotate_left(proc->accumulator, address);
+  } else {
+    proc->accumulator = fpu_standardise(proc->accumulator);
+  }
+  ++proc->program_counter;
+}
+
+// functions that are not implemented stop the machine
+static void not_implemented(processor_t *proc, int op) {
+  printf("%02o not implemented\n", op);
+  proc->mode = exec_mode_stop;
+  proc->fault = true;
+  ++proc->program_counter;
+}
+
+// 66  (Spare)                                a         n
+static void f66(processor_t *proc, int address) {
+  proc->auxiliary_register = 0;
+  not_implemented(proc, 066);
+}
+
+// 67  (Spare)                                a         n
+static void f67(processor_t *proc, int address) {
+  proc->auxiliary_register = 0;
+  not_implemented(proc, 067);
+}
+
+// 70  Read the keyboard number generator to the accumulator
+static void f70(processor_t *proc, int address) {
+  proc->accumulator = proc->word_generator;
+  ++(proc->wg_polls);
+  ++proc->program_counter;
+}
+
+// 71  Read one char from the tape reader "or" it into A (ls 5..8 bits)
+//     0 = channel 1,  2048 = channel 2,  4096 = tty input
+static void f71(processor_t *proc, int address) {
+  int unit = 1;
+  busy_t reader_busy = busy_reader_1;
+  if (0 != (address & 2048)) {
+    unit = 2;
+    reader_busy = busy_reader_2;
+  }
+  if (0 != (address & 4096)) {
+    unit = 3;
+    reader_busy = busy_reader_3;
+  }
+  uint8_t c = 0;
+  if (!pts_reader(proc, unit, &c)) {
+    proc->io_busy = reader_busy;
+    return; // do not update program counter
+  }
+  proc->accumulator |= (int64_t)(c) << word_shift;
+  ++proc->program_counter;
+}
+
+// 72  Output to plotter
+static void f72(processor_t *proc, int address) { not_implemented(proc, 072); }
+
+// 73  Write the address of this instruction to location N
+static void f73(processor_t *proc, int address) {
+  // align integer part of program counter to second address
+  // position of memory word
+  core_write(proc,
+             address,
+             ((int64_t)(proc->program_counter) << (second_address_shift - 1)) &
+               thirty_nine_bits);
+  ++proc->program_counter;
+}
+
+// 74  Punch tape / teleprinter character N
+//     0 = channel 1,  2048 = channel 2,  4096 = tty output
+static void f74(processor_t *proc, int address) {
+  int unit = 1;
+  busy_t punch_busy = busy_punch_1;
+  if (0 != (address & 2048)) {
+    unit = 2;
+    punch_busy = busy_punch_2;
+  }
+  if (0 != (address & 4096)) {
+    unit = 3;
+    punch_busy = busy_punch_3;
+  }
+  if (!pts_punch(proc, unit, (uint8_t)(0xff & address))) {
+    proc->io_busy = punch_busy;
+    return; // do not update program counter
+  }
+  ++proc->program_counter;
+}
+
+// 75  Film handler status to the accumulator
+static void f75(processor_t *proc, int address) {
+  proc->accumulator = film_status(proc, address);
+  ++proc->program_counter;
+}
+
+// 76  Film handler function select
+static void f76(processor_t *proc, int address) {
+  film_select(proc, address);
+  ++proc->program_counter;
+}
+
+// 77  Block transfer
+static void f77(processor_t *proc, int address) {
+  if (!film_transfer(proc, address)) {
+    printf("77 film allocation failed\n");
+    proc->mode = exec_mode_stop;
+    proc->fault = true;
+  }
+  ++proc->program_counter;
+}
+
+// clang-format off
+static cpu803_handler_t *const dispatch[64] = {
+  f00, f01, f02, f03, f04, f05, f06, f07,
+  f10, f11, f12, f13, f14, f15, f16, f17,
+  f20, f21, f22, f23, f24, f25, f26, f27,
+  f30, f31, f32, f33, f34, f35, f36, f37,
+  f40, f41, f42, f43, f44, f45, f46, f47,
+  f50, f51, f52, f53, f54, f55, f56, f57,
+  f60, f61, f62, f63, f64, f65, f66, f67,
+  f70, f71, f72, f73, f74, f75, f76, f77,
+};
+// clang-format on
+
+// instruction execution
+static inline void cpu(processor_t *proc, int op, int address) {
+  dispatch[op](proc, address);
+}
+
+cpu803_handler_t *cpu803_handler(int op) { return dispatch[op & op_bits]; }
+
+#endif
+
+// split a word into its two instructions
+static void decode(decoded_t *d, int64_t word) {
 
   static const uint64_t stop_mask = ELLIOTT(077, 0, 1, 077, 8191);
   static const uint64_t stop_inst = ELLIOTT(073, 0, 1, 040, 0);
 
+  d->word = word;
+  d->valid = true;
+  d->stop = (word & stop_mask) == stop_inst;
+  d->b_modified = 0 != (b_mod_bit & word);
+  d->op1 = (word >> first_op_shift) & op_bits;
+  d->op2 = (word >> second_op_shift) & op_bits;
+  d->address1 = (word >> first_address_shift) & address_bits;
+  d->address2 = (word >> second_address_shift) & address_bits;
+  d->time1 = clock_instruction_time(d->op1, d->address1);
+  d->time2 = clock_instruction_time(d->op2, d->address2);
+}
+
+// fetch the predecoded form of a word, decoding it if necessary
+static const decoded_t *fetch(processor_t *proc, int address) {
+  decoded_t *d = &proc->decoded[address];
+  if (!d->valid) {
+    decode(d, core_read_program(proc, address));
+  }
+  return d;
+}
+
+const decoded_t *cpu803_fetch(processor_t *proc, int address) {
+  return fetch(proc, address & address_bits);
+}
+
+void cpu803_load_b(processor_t *proc, int64_t word) {
+  proc->b_addr = proc->program_counter | 1; // set the half bit
+  proc->b_data = word;
+  decode(&proc->b_decoded, word);
+}
+
+// execute the instruction at the program counter, if this is the first
+// instruction of a word then continue with the second instruction unless
+// the first one jumped, stopped, is waiting for I/O or overwrote the word
+void cpu803_execute(processor_t *proc) {
+
   // special check for stop like:  73 N / 40 0
-  int64_t word = core_read_program(proc, proc->program_counter >> 1);
-  if ((word & stop_mask) == stop_inst) {
+  // the program counter is not wrapped after the top of store
+  int address_p = (proc->program_counter >> 1) & address_bits;
+  const decoded_t *d = fetch(proc, address_p);
+  if (d->stop) {
     proc->mode = exec_mode_stop;
   }
 
   if (0 == (1 & proc->program_counter)) {
-    // first instruction
-    int op = (word >> first_op_shift) & op_bits;
-    int address = (word >> first_address_shift) & address_bits;
-
     // save second instruction
     proc->b_addr = proc->program_counter | 1; // set the half bit
-    proc->b_data = word;
+    proc->b_data = d->word;
+    proc->b_decoded = *d;
 
     // execute first instruction
-    cpu(proc, op, address);
-
-  } else { // PC half bit is set
+    flight_record(proc, d->word);
+    ++proc->instructions;
+    proc->emulated_time += d->time1;
+    cpu(proc, d->op1, d->address1);
 
-    // use saved data from B Register if possible
-    if (proc->program_counter == proc->b_addr) {
-      word = proc->b_data;
-      proc->b_addr = 0; // invalidate B cache
-    }
-    if (0 != (b_mod_bit & word)) {
-      int address = (word >> first_address_shift) & address_bits;
-      int64_t modifier = core_read(proc, address);
-      word += modifier;
+    if (proc->program_counter != proc->b_addr ||
+        exec_mode_run != proc->mode || !proc->decoded[address_p].valid) {
+      return;
     }
-    // second instruction
-    int op = (word >> second_op_shift) & op_bits;
-    int address = (word >> second_address_shift) & address_bits;
-    cpu(proc, op, address);
   }
+
+  // PC half bit is set
+
+  // use saved data from B Register if possible
+  if (proc->program_counter == proc->b_addr) {
+    d = &proc->b_decoded;
+    proc->b_addr = 0; // invalidate B cache
+  }
+
+  // second instruction
+  flight_record(proc, d->word);
+  ++proc->instructions;
+  if (d->b_modified) {
+    cpu803_execute_modified(proc, d->word);
+  } else {
+    proc->emulated_time += d->time2;
+    cpu(proc, d->op2, d->address2);
+  }
+}
+
+void cpu803_execute_modified(processor_t *proc, int64_t word) {
+  int address = (word >> first_address_shift) & address_bits;
+  word += core_read(proc, address);
+  int op = (word >> second_op_shift) & op_bits;
+  address = (word >> second_address_shift) & address_bits;
+  proc->emulated_time += clock_instruction_time(op, address);
+  cpu(proc, op, address);
 }
@@ -5,6 +5,23 @@
 
 #include "processor.h"
 
+// execute a single function code
+typedef void cpu803_handler_t(processor_t *proc, int address);
+
 void cpu803_execute(processor_t *proc);
 
+// support for translated code
+
+// decoded form of a word, decoding it if necessary
+const decoded_t *cpu803_fetch(processor_t *proc, int address);
+
+// handler for a function code, NULL if built with SWITCH_DISPATCH
+cpu803_handler_t *cpu803_handler(int op);
+
+// execute the B-modified second instruction of word
+void cpu803_execute_modified(processor_t *proc, int64_t word);
+
+// load the B Register with the word containing the program counter
+void cpu803_load_b(processor_t *proc, int64_t word);
+
 #endif
@@ -0,0 +1,126 @@
+// cpu803_test.c
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "constants.h"
+#include "core.h"
+#include "cpu803.h"
+#include "processor.h"
+
+#define INT803(x) ((int64_t)(x) << word_shift)
+
+// run from address until the processor stops
+static void run(processor_t *proc, int address) {
+  proc->program_counter = address << 1;
+  proc->mode = exec_mode_run;
+  for (int i = 0; i < 1000; ++i) {
+    cpu803_execute(proc);
+    if (exec_mode_stop == proc->mode) {
+      return;
+    }
+  }
+  printf("program at: %d did not stop\n", address);
+  exit(1);
+}
+
+static void check(const char *title, int64_t actual, int64_t expected) {
+  if (actual != expected) {
+    printf("%-24s: actual:   %" PRId64 "\n"
+           "%-24s  expected: %" PRId64 "\n",
+           title,
+           actual,
+           "",
+           expected);
+    exit(1);
+  }
+}
+
+int main(int argc, char *argv[]) {
+
+  processor_t *proc = calloc(1, sizeof(processor_t));
+  if (NULL == proc) {
+    printf("calloc failed\n");
+    return 1;
+  }
+
+  const int counter = 4200;
+
+  // replace an already executed word
+  core_write(proc, 4096, ELLIOTT(030, 4100, 0, 020, 4097));
+  core_write(proc, 4097, ELLIOTT(040, 4097, 0, 040, 4097));
+  core_write(proc, 4098, ELLIOTT(040, 4098, 0, 000, 0));
+  core_write(proc, 4100, ELLIOTT(022, 4200, 0, 040, 4098));
+
+  run(proc, 4097);
+  check("initial stop", proc->program_counter, 4097 << 1);
+  check("no invalidations", proc->decode_invalidations, 0);
+
+  run(proc, 4096);
+  check("modified word stop", proc->program_counter, 4098 << 1);
+  check("modified word count", proc->core_store[counter], INT803(1));
+  check("one invalidation", proc->decode_invalidations, 1);
+
+  // second instruction comes from B Register after first overwrites it
+  proc->accumulator = 0;
+  core_write(proc, 4101, ELLIOTT(020, 4101, 0, 022, 4200));
+  core_write(proc, 4102, ELLIOTT(040, 4098, 0, 000, 0));
+  run(proc, 4101);
+  check("B register stop", proc->program_counter, 4098 << 1);
+  check("B register count", proc->core_store[counter], INT803(2));
+  check("B register store", proc->core_store[4101], 0);
+
+  // B-modified second instruction follows changes to the modifier
+  core_write(proc, 4103, ELLIOTT(000, 4105, 1, 022, 0));
+  core_write(proc, 4104, ELLIOTT(040, 4098, 0, 000, 0));
+  core_write(proc, 4105, (int64_t)(counter) << second_address_shift);
+  run(proc, 4103);
+  check("B modified count", proc->core_store[counter], INT803(3));
+
+  core_write(proc, 4105, (int64_t)(counter + 1) << second_address_shift);
+  run(proc, 4103);
+  check("B modified unchanged", proc->core_store[counter], INT803(3));
+  check("B modified new count", proc->core_store[counter + 1], INT803(1));
+
+  // both instructions of a word are executed in one step
+  core_write(proc, 4106, ELLIOTT(022, 4200, 0, 022, 4200));
+  core_write(proc, 4107, ELLIOTT(040, 4107, 0, 000, 0));
+  proc->program_counter = 4106 << 1;
+  proc->mode = exec_mode_run;
+  int64_t instructions = proc->instructions;
+  cpu803_execute(proc);
+  check("whole word pc", proc->program_counter, 4107 << 1);
+  check("whole word count", proc->core_store[counter], INT803(5));
+  check("whole word instructions", proc->instructions - instructions, 2);
+
+  // except if the first instruction jumps
+  core_write(proc, 4108, ELLIOTT(040, 4107, 0, 022, 4200));
+  proc->program_counter = 4108 << 1;
+  instructions = proc->instructions;
+  cpu803_execute(proc);
+  check("first jump pc", proc->program_counter, 4107 << 1);
+  check("first jump count", proc->core_store[counter], INT803(5));
+  check("first jump instructions", proc->instructions - instructions, 1);
+
+  // running off the top of store continues from address 0, whose
+  // initial instructions clear location 4 and the accumulator
+  core_write(proc, 8191, ELLIOTT(022, 4200, 0, 022, 4200));
+  proc->program_counter = 8191 << 1;
+  proc->accumulator = INT803(1);
+  int64_t invalidations = proc->decode_invalidations;
+  instructions = proc->instructions;
+  cpu803_execute(proc);
+  cpu803_execute(proc);
+  check("top of store count", proc->core_store[counter], INT803(7));
+  check("top of store wrap", proc->accumulator, 0);
+  check("top of store instructions", proc->instructions - instructions, 4);
+  check("top of store invalidations",
+        proc->decode_invalidations,
+        invalidations);
+
+  free(proc);
+  return 0;
+}
@@ -0,0 +1,268 @@
+// cpu_bench.c
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "alu.h"
+#include "constants.h"
+#include "core.h"
+#include "cpu803.h"
+#include "fpu.h"
+#include "jit.h"
+#include "processor.h"
+
+#define INT803(x) ((int64_t)(x) << word_shift)
+
+enum {
+  loop_start = 4096, // first word of a benchmark loop
+  batch = 10000,     // iterations between checks of the time
+};
+
+// run each benchmark for at least this long
+static const double minimum_seconds = 0.25;
+
+// the interpreter this program was built with; cpu_bench_switch links
+// the switch version of cpu803.c ahead of the library
+#if defined(SWITCH_DISPATCH)
+static const char interpreter[] = "switch";
+#else
+static const char interpreter[] = "table";
+#endif
+
+static double now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static bool first_result = true;
+
+static void result(const char *name,
+                   const char *engine,
+                   const char *unit,
+                   int64_t count,
+                   double seconds) {
+  printf("%s\n    {\"name\": \"%s\", ", first_result ? "" : ",", name);
+  if (NULL != engine) {
+    printf("\"engine\": \"%s\", ", engine);
+  }
+  printf("\"%s\": %" PRId64 ", \"seconds\": %.6f, \"%s_per_second\": %.0f}",
+         unit,
+         count,
+         seconds,
+         unit,
+         count / seconds);
+  first_result = false;
+}
+
+// a loop of words that only uses the function codes of one group, apart
+// from the jump back to its start
+typedef struct {
+  const char *name;
+  int words;
+  int64_t code[8];
+} loop_t;
+
+// clang-format off
+static const loop_t loops[] = {
+  {"group 0 arithmetic", 5, {
+    ELLIOTT(000, 4200, 0, 001, 4200), ELLIOTT(002, 4200, 0, 003, 4201),
+    ELLIOTT(004, 4200, 0, 005, 4201), ELLIOTT(006, 4200, 0, 007, 4200),
+    ELLIOTT(000, 4200, 0, 040, 4096),
+  }},
+  {"group 1 exchange", 5, {
+    ELLIOTT(010, 4202, 0, 011, 4202), ELLIOTT(012, 4202, 0, 013, 4203),
+    ELLIOTT(014, 4202, 0, 015, 4203), ELLIOTT(016, 4202, 0, 017, 4202),
+    ELLIOTT(000, 4200, 0, 040, 4096),
+  }},
+  {"group 2 store", 5, {
+    ELLIOTT(020, 4204, 0, 021, 4204), ELLIOTT(022, 4204, 0, 023, 4205),
+    ELLIOTT(024, 4204, 0, 025, 4205), ELLIOTT(026, 4204, 0, 027, 4204),
+    ELLIOTT(000, 4200, 0, 040, 4096),
+  }},
+  {"group 3 replace", 5, {
+    ELLIOTT(030, 4200, 0, 031, 4200), ELLIOTT(032, 4200, 0, 033, 4201),
+    ELLIOTT(034, 4200, 0, 035, 4201), ELLIOTT(036, 4200, 0, 037, 4200),
+    ELLIOTT(000, 4200, 0, 040, 4096),
+  }},
+  // with a zero accumulator and no overflow every code is taken once
+  {"group 4 jumps", 6, {
+    ELLIOTT(041, 4097, 0, 042, 4097), ELLIOTT(043, 4098, 0, 045, 4098),
+    ELLIOTT(046, 4099, 0, 000, 0),    ELLIOTT(000, 0, 0, 047, 4100),
+    ELLIOTT(044, 4101, 0, 000, 0),    ELLIOTT(006, 0, 0, 040, 4096),
+  }},
+  {"group 5 shift multiply divide", 5, {
+    ELLIOTT(030, 4206, 0, 050, 3),    ELLIOTT(051, 1, 0, 052, 4207),
+    ELLIOTT(053, 4207, 0, 054, 2),    ELLIOTT(055, 1, 0, 056, 4208),
+    ELLIOTT(057, 0, 0, 040, 4096),
+  }},
+  {"group 6 floating point", 5, {
+    ELLIOTT(030, 4209, 0, 060, 4210), ELLIOTT(061, 4210, 0, 062, 4209),
+    ELLIOTT(063, 4210, 0, 064, 4210), ELLIOTT(065, 4096, 0, 065, 3),
+    ELLIOTT(000, 4200, 0, 040, 4096),
+  }},
+  // peripherals excluded, they would wait for a tape or a client
+  {"group 7 word generator store film", 3, {
+    ELLIOTT(070, 0, 0, 073, 4211),    ELLIOTT(075, 3, 0, 070, 0),
+    ELLIOTT(073, 4211, 0, 040, 4096),
+  }},
+};
+// clang-format on
+
+// run a loop with the interpreter or, if jit is true, translated
+static void bench_loop(processor_t *proc, const loop_t *loop, bool jit) {
+
+  memset(proc, 0, sizeof(*proc));
+  core_write(proc, 4200, INT803(3));
+  core_write(proc, 4201, INT803(5));
+  core_write(proc, 4202, INT803(7));
+  core_write(proc, 4203, INT803(11));
+  core_write(proc, 4206, INT803(12345678));
+  core_write(proc, 4207, INT803(-4321));
+  core_write(proc, 4208, INT803(987654321));
+  core_write(proc, 4209, fpu_standardise(INT803(355)));
+  core_write(proc, 4210, fpu_standardise(INT803(113)));
+  for (int i = 0; i < loop->words; ++i) {
+    core_write(proc, loop_start + i, loop->code[i]);
+  }
+
+  if (jit) {
+    proc->jit = jit_create();
+    if (NULL == proc->jit) {
+      fprintf(stderr, "error: %s jit create failed\n", loop->name);
+      exit(1);
+    }
+  }
+
+  proc->program_counter = loop_start << 1;
+  proc->mode = exec_mode_run;
+  double start = now();
+  double seconds = 0;
+  do {
+    for (int i = 0; i < batch; ++i) {
+      if (jit) {
+        jit_execute(proc);
+      } else {
+        cpu803_execute(proc);
+      }
+    }
+    seconds = now() - start;
+  } while (seconds < minimum_seconds && exec_mode_run == proc->mode);
+
+  jit_destroy(proc->jit);
+  proc->jit = NULL;
+  if (exec_mode_run != proc->mode) {
+    fprintf(stderr, "error: %s stopped\n", loop->name);
+    exit(1);
+  }
+  result(loop->name,
+         jit ? "jit" : interpreter,
+         "instructions",
+         proc->instructions,
+         seconds);
+}
+
+// results are summed so the calls cannot be optimised away
+static volatile int64_t sink = 0;
+
+static void bench_multiply(void) {
+  double start = now();
+  double seconds = 0;
+  int64_t count = 0;
+  do {
+    for (int i = 0; i < batch; ++i) {
+      int64_t acc = 0;
+      int64_t ar = 0;
+      alu_multiply(&acc, &ar, INT803(123456789 + i), INT803(-98765 - i));
+      sink += acc ^ ar;
+    }
+    count += batch;
+    seconds = now() - start;
+  } while (seconds < minimum_seconds);
+  result("alu_multiply", NULL, "operations", count, seconds);
+}
+
+static void bench_divide(void) {
+  double start = now();
+  double seconds = 0;
+  int64_t count = 0;
+  do {
+    for (int i = 0; i < batch; ++i) {
+      bool overflow = false;
+      sink += alu_divide(
+        &overflow, INT803(12345 + i), INT803(678901 + i), INT803(98765432));
+    }
+    count += batch;
+    seconds = now() - start;
+  } while (seconds < minimum_seconds);
+  result("alu_divide", NULL, "operations", count, seconds);
+}
+
+typedef int64_t fpu_function_t(bool *overflow, int64_t a, int64_t b);
+
+static void bench_fpu(const char *name, fpu_function_t *f) {
+  int64_t a = fpu_standardise(INT803(355));
+  int64_t b = fpu_standardise(INT803(-113));
+  double start = now();
+  double seconds = 0;
+  int64_t count = 0;
+  do {
+    for (int i = 0; i < batch; ++i) {
+      bool overflow = false;
+      sink += f(&overflow, a, b + INT803(i & 7));
+    }
+    count += batch;
+    seconds = now() - start;
+  } while (seconds < minimum_seconds);
+  result(name, NULL, "operations", count, seconds);
+}
+
+static void bench_standardise(void) {
+  double start = now();
+  double seconds = 0;
+  int64_t count = 0;
+  do {
+    for (int i = 0; i < batch; ++i) {
+      sink += fpu_standardise(INT803(i - batch / 2));
+    }
+    count += batch;
+    seconds = now() - start;
+  } while (seconds < minimum_seconds);
+  result("fpu_standardise", NULL, "operations", count, seconds);
+}
+
+int main(int argc, char *argv[]) {
+
+  processor_t *proc = calloc(1, sizeof(processor_t));
+  if (NULL == proc) {
+    printf("calloc failed\n");
+    return 1;
+  }
+
+  printf("{\n  \"benchmarks\": [");
+  for (size_t i = 0; i < SizeOfArray(loops); ++i) {
+    bench_loop(proc, &loops[i], false);
+  }
+#if !defined(SWITCH_DISPATCH)
+  if (jit_available()) {
+    for (size_t i = 0; i < SizeOfArray(loops); ++i) {
+      bench_loop(proc, &loops[i], true);
+    }
+  }
+#endif
+  bench_multiply();
+  bench_divide();
+  bench_fpu("fpu_add", fpu_add);
+  bench_fpu("fpu_mpy", fpu_mpy);
+  bench_fpu("fpu_div", fpu_div);
+  bench_standardise();
+  printf("\n  ]\n}\n");
+
+  free(proc);
+  return 0;
+}
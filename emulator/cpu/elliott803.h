@@ -3,6 +3,8 @@
 #if !defined(ELLIOTT803_H)
 #define ELLIOTT803_H
 
+#include <stddef.h>
+#include <stdint.h>
 #include <sys/types.h>
 
 typedef struct elliott803_struct elliott803_t;
@@ -31,4 +33,25 @@ elliott803_send(elliott803_t *proc, const char *buffer, size_t buffer_size);
 ssize_t
 elliott803_receive(elliott803_t *proc, char *buffer, size_t buffer_size);
 
+// load a whole tape into a reader, which then reads it without the
+// client having to supply it in pieces; ownership of data, allocated
+// with malloc, passes to the processor, and NULL removes any tape
+// returns:
+//   positive: bytes sent
+//   negative: error code
+ssize_t elliott803_load_tape(elliott803_t *proc,
+                             int unit,
+                             uint8_t *data,
+                             size_t size);
+
+// create count copies of a running or stopped instance, each with its
+// own thread, channel, registers and buffers and named "NAME.K"; the
+// state, store included, is shared copy-on-write so a clone costs only
+// the pages it writes (see "stats memory"); destroy each as usual
+// Note: waits for the processor to make them, so the client must not
+//       leave replies unread until the processor has no room to send
+// returns:
+//   number created, fewer than count if out of resources
+int elliott803_clone(elliott803_t *proc, elliott803_t **clones, int count);
+
 #endif
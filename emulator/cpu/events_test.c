@@ -0,0 +1,147 @@
+// events_test.c
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/select.h>
+#include <time.h>
+
+#include "elliott803.h"
+
+static void check(const char *title, bool ok) {
+  if (!ok) {
+    printf("failed: %s\n", title);
+    exit(1);
+  }
+}
+
+static void command(elliott803_t *proc, const char *s) {
+  elliott803_send(proc, s, strlen(s) + 1);
+}
+
+// receive messages until one starts with prefix, false on timeout or if
+// a message starting with reject arrives first
+static bool
+expect(elliott803_t *proc, const char *prefix, const char *reject) {
+  int fd = elliott803_get_fd(proc);
+  time_t deadline = time(NULL) + 5;
+  for (;;) {
+    fd_set fds;
+    FD_ZERO(&fds);
+    FD_SET(fd, &fds);
+    struct timeval timeout = {
+      .tv_sec = deadline - time(NULL),
+      .tv_usec = 0,
+    };
+    if (timeout.tv_sec <= 0) {
+      return false;
+    }
+    int rc = select(FD_SETSIZE, &fds, NULL, NULL, &timeout);
+    if (-1 == rc && EINTR == errno) {
+      continue;
+    }
+    if (rc <= 0) {
+      return false;
+    }
+    char buffer[1024];
+    ssize_t n = elliott803_receive(proc, buffer, sizeof(buffer) - 1);
+    if (n <= 0) {
+      continue;
+    }
+    buffer[n] = '\0';
+    if (NULL != reject && 0 == strncmp(reject, buffer, strlen(reject))) {
+      return false;
+    }
+    if (0 == strncmp(prefix, buffer, strlen(prefix))) {
+      return true;
+    }
+  }
+}
+
+int main(int argc, char *argv[]) {
+
+  elliott803_t *proc = elliott803_create("events test");
+  check("create", NULL != proc);
+
+  command(proc, "events all");
+  check("subscribe all",
+        expect(proc, "events stop idle starved punch overflow limit", NULL));
+
+  // a dynamic stop
+  command(proc, "mw 4096 40 4096 : 00 0");
+  command(proc, "run 4096");
+  check("stop", expect(proc, "event stop", NULL));
+
+  // poll the word generator, which run leaves negative
+  command(proc, "mw 4100 70 0 : 41 4100");
+  command(proc, "mw 4101 40 4101 : 00 0");
+  command(proc, "run 4100");
+  check("idle", expect(proc, "event idle", "event stop"));
+  command(proc, "stop");
+  check("stop after idle", expect(proc, "event stop", NULL));
+
+  // read from a reader with no tape
+  command(proc, "mw 4110 71 0 : 40 4110");
+  command(proc, "run 4110");
+  check("starved", expect(proc, "event starved r1", "event stop"));
+
+  // supplying tape and running out again is a new event
+  command(proc, "reader 1 0102");
+  check("starved again", expect(proc, "event starved r1", "event stop"));
+  command(proc, "stop");
+  check("stop after starved", expect(proc, "event stop", NULL));
+
+  // a loaded tape is read without asking the client for more
+  uint8_t *tape = malloc(3000);
+  check("malloc", NULL != tape);
+  memset(tape, 1, 3000);
+  elliott803_load_tape(proc, 1, tape, 3000);
+  command(proc, "run 4110");
+  check("tape read", expect(proc, "event starved r1", "r1 busy"));
+  command(proc, "stop");
+  check("stop after tape", expect(proc, "event stop", NULL));
+
+  // punch faster than the client empties the buffer, in a quantum long
+  // enough to fill it
+  command(proc, "quantum 10000");
+  command(proc, "mw 4120 74 1 : 40 4120");
+  command(proc, "run 4120");
+  check("punch", expect(proc, "event punch p1", "event stop"));
+  command(proc, "stop");
+  check("stop after punch", expect(proc, "event stop", NULL));
+
+  // add the largest number to itself
+  command(proc, "mw 4200 +274877906943");
+  command(proc, "mw 4130 30 4200 : 04 4200");
+  command(proc, "mw 4131 40 4131 : 00 0");
+  command(proc, "run 4130");
+  check("overflow", expect(proc, "event overflow", "event stop"));
+  check("stop after overflow", expect(proc, "event stop", NULL));
+
+  // count until the instruction limit is reached
+  command(proc, "mw 4140 22 4201 : 40 4140");
+  command(proc, "limit 100000");
+  check("limit set", expect(proc, "limit 100000", NULL));
+  command(proc, "run 4140");
+  check("limit", expect(proc, "event limit", "event stop"));
+  check("stop at limit", expect(proc, "event stop", NULL));
+  command(proc, "limit");
+  check("limit is one shot", expect(proc, "limit off", NULL));
+
+  // only subscribed events are sent
+  command(proc, "events stop");
+  check("subscribe stop", expect(proc, "events stop", NULL));
+  command(proc, "run 4130");
+  check("unsubscribed overflow",
+        expect(proc, "event stop", "event overflow"));
+
+  command(proc, "events none");
+  check("subscribe none", expect(proc, "events", NULL));
+  command(proc, "events bogus");
+  check("invalid event", expect(proc, "error invalid event", NULL));
+
+  elliott803_destroy(proc);
+  return 0;
+}
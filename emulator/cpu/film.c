@@ -0,0 +1,76 @@
+// film.c
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "clock.h"
+#include "constants.h"
+#include "core.h"
+#include "film.h"
+#include "processor.h"
+
+// the film passes the heads at one word per word time, so a transfer
+// takes a block of word times and positioning passes over every block
+// between the current and the new position
+static const int64_t film_block_time = film_block_words;
+
+int64_t film_status(processor_t *proc, int address) {
+  if (3 == (address & 3)) {
+    return (int64_t)(proc->film_block) << word_shift;
+  }
+  return 0;
+}
+
+void film_select(processor_t *proc, int address) {
+  switch (address & 3) {
+  case 0:
+    proc->film_function = film_read;
+    break;
+  case 1:
+    proc->film_function = film_write;
+    break;
+  default:
+    proc->film_function = film_position;
+    break;
+  }
+}
+
+bool film_transfer(processor_t *proc, int address) {
+
+  if (film_position == proc->film_function) {
+    int block = address % film_blocks;
+    int64_t t = film_block_time * abs(block - proc->film_block);
+    proc->transfer_time += t;
+    proc->emulated_time += t * word_time;
+    proc->film_block = block;
+    ++proc->transfers;
+    return true;
+  }
+
+  if (NULL == proc->film) {
+    proc->film = calloc(film_words, sizeof(int64_t));
+    if (NULL == proc->film) {
+      return false;
+    }
+  }
+
+  // whole blocks are copied, wrapping at the end of the store
+  int64_t *block = &proc->film[proc->film_block * film_block_words];
+  if (film_read == proc->film_function) {
+    core_write_block(proc, address, block, film_block_words);
+  } else {
+    core_read_block(proc, address, block, film_block_words);
+  }
+  proc->film_block = (proc->film_block + 1) % film_blocks;
+  proc->transfer_time += film_block_time;
+  proc->emulated_time += film_block_time * word_time;
+  ++proc->film_transfers;
+  ++proc->transfers;
+  return true;
+}
+
+void film_release(processor_t *proc) {
+  free(proc->film);
+  proc->film = NULL;
+}
@@ -0,0 +1,50 @@
+// film.h
+
+#if !defined(FILM_H)
+#define FILM_H 1
+
+#include <stdint.h>
+
+#include "processor.h"
+
+// magnetic film backing store
+//
+// a single handler holds film_blocks blocks of film_block_words words;
+// 76 N selects the function for the following 77 N which moves a whole
+// block between the film and the store starting at N, or positions the
+// film at block N
+//
+//   76 N, N mod 4 = 0: read the next block into the store
+//                   1: write the store to the next block
+//                   2: position the film at block N mod 4096
+//   75 N, N mod 4 = 3: the current block number to the accumulator
+//                      otherwise: zero (handler ready)
+//
+// the handler selection bits (e.g. 1024) are ignored
+enum {
+  film_block_words = 64,
+  film_blocks = 4096,
+  film_words = film_block_words * film_blocks,
+};
+
+// film functions selected by 76
+typedef enum {
+  film_read,
+  film_write,
+  film_position,
+} film_function_t;
+
+// 75: status word for the accumulator
+int64_t film_status(processor_t *proc, int address);
+
+// 76: select the function for the next transfer
+void film_select(processor_t *proc, int address);
+
+// 77: perform the selected function, false if the film could not be
+// allocated
+bool film_transfer(processor_t *proc, int address);
+
+// free the film, e.g. when the processor is destroyed
+void film_release(processor_t *proc);
+
+#endif
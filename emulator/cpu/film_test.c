@@ -0,0 +1,107 @@
+// film_test.c
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "constants.h"
+#include "core.h"
+#include "cpu803.h"
+#include "film.h"
+#include "processor.h"
+
+#define INT803(x) ((int64_t)(x) << word_shift)
+
+// run from address until the processor stops
+static void run(processor_t *proc, int address, int limit) {
+  proc->program_counter = address << 1;
+  proc->mode = exec_mode_run;
+  for (int i = 0; i < limit; ++i) {
+    cpu803_execute(proc);
+    if (exec_mode_stop == proc->mode) {
+      return;
+    }
+  }
+  printf("program at: %d did not stop\n", address);
+  exit(1);
+}
+
+static void check(const char *title, int64_t actual, int64_t expected) {
+  if (actual != expected) {
+    printf("%-24s: actual:   %" PRId64 "\n"
+           "%-24s  expected: %" PRId64 "\n",
+           title,
+           actual,
+           "",
+           expected);
+    exit(1);
+  }
+}
+
+int main(int argc, char *argv[]) {
+
+  processor_t *proc = calloc(1, sizeof(processor_t));
+  if (NULL == proc) {
+    printf("calloc failed\n");
+    return 1;
+  }
+
+  // position, write a block and read the position back
+  for (int i = 0; i < film_block_words; ++i) {
+    core_write(proc, 5000 + i, INT803(i + 1));
+  }
+  core_write(proc, 4096, ELLIOTT(076, 1026, 0, 077, 5));
+  core_write(proc, 4097, ELLIOTT(076, 1025, 0, 077, 5000));
+  core_write(proc, 4098, ELLIOTT(075, 1027, 0, 040, 4099));
+  core_write(proc, 4099, ELLIOTT(040, 4099, 0, 000, 0));
+  run(proc, 4096, 100);
+  check("position after write", proc->accumulator, INT803(6));
+  check("film word", proc->film[5 * film_block_words + 63], INT803(64));
+  check("blocks", proc->film_transfers, 1);
+  check("word times", proc->transfer_time, 6 * film_block_words);
+
+  // read it back over previously executed code
+  core_write(proc, 6000, ELLIOTT(040, 6000, 0, 000, 0));
+  run(proc, 6000, 10);
+  core_write(proc, 4100, ELLIOTT(076, 1026, 0, 077, 5));
+  core_write(proc, 4101, ELLIOTT(076, 1024, 0, 077, 6000));
+  core_write(proc, 4102, ELLIOTT(040, 4102, 0, 000, 0));
+  int64_t invalidations = proc->decode_invalidations;
+  int64_t changes = proc->store_changes;
+  run(proc, 4100, 100);
+  for (int i = 0; i < film_block_words; ++i) {
+    check("read word", proc->core_store[6000 + i], INT803(i + 1));
+  }
+  check("read invalidation", proc->decode_invalidations - invalidations, 1);
+  check("read changes", proc->store_changes - changes, film_block_words);
+
+  // reading the same block again changes nothing
+  changes = proc->store_changes;
+  run(proc, 4100, 100);
+  check("unchanged read", proc->store_changes - changes, 0);
+
+  // blocks wrap at the end of the store and the boot loader reads as zero
+  core_write(proc, 4103, ELLIOTT(076, 1026, 0, 077, 5));
+  core_write(proc, 4104, ELLIOTT(076, 1024, 0, 077, 8160));
+  core_write(proc, 4105, ELLIOTT(076, 1026, 0, 077, 7));
+  core_write(proc, 4106, ELLIOTT(076, 1025, 0, 077, 8160));
+  core_write(proc, 4107, ELLIOTT(040, 4107, 0, 000, 0));
+  run(proc, 4103, 100);
+  check("wrap last", proc->core_store[8191], INT803(32));
+  check("wrap first", proc->core_store[0], INT803(33));
+  check("wrap zero", proc->film[7 * film_block_words + 32], 0);
+  check("wrap read", proc->film[7 * film_block_words + 36], INT803(37));
+
+  // the film position wraps after the last block
+  core_write(proc, 4108, ELLIOTT(076, 1026, 0, 077, 4095));
+  core_write(proc, 4109, ELLIOTT(076, 1025, 0, 077, 5000));
+  core_write(proc, 4110, ELLIOTT(075, 1027, 0, 040, 4107));
+  run(proc, 4108, 100);
+  check("position wrap", proc->accumulator, 0);
+
+  film_release(proc);
+  free(proc);
+  return 0;
+}
@@ -0,0 +1,16 @@
+// flight.c
+
+#include <stdint.h>
+
+#include "flight.h"
+#include "processor.h"
+
+int flight_history(processor_t *proc, flight_entry_t history[flight_size]) {
+
+  uint32_t end = proc->flight_position;
+  int n = end < flight_size ? (int)(end) : flight_size;
+  for (int i = 0; i < n; ++i) {
+    history[i] = proc->flight[(end - n + i) & (flight_size - 1)];
+  }
+  return n;
+}
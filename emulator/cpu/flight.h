@@ -0,0 +1,29 @@
+// flight.h
+
+#if !defined(FLIGHT_H)
+#define FLIGHT_H 1
+
+#include <stdint.h>
+
+#include "processor.h"
+
+// flight recorder of the last flight_size instructions executed by the
+// interpreter, always on so there is a history when a long run stops
+// on a fault; the jit does not record the instructions it translates
+
+// record the instruction at the program counter before it executes,
+// a few stores and no branches
+static inline void flight_record(processor_t *proc, int64_t word) {
+  flight_entry_t *e =
+    &proc->flight[proc->flight_position++ & (flight_size - 1)];
+  e->word = word;
+  e->accumulator = proc->accumulator;
+  e->auxiliary_register = proc->auxiliary_register;
+  e->program_counter = proc->program_counter;
+  e->overflow = proc->overflow;
+}
+
+// copy the recording oldest first, returns the number of instructions
+int flight_history(processor_t *proc, flight_entry_t history[flight_size]);
+
+#endif
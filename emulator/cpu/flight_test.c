@@ -0,0 +1,85 @@
+// flight_test.c
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "constants.h"
+#include "core.h"
+#include "cpu803.h"
+#include "flight.h"
+#include "processor.h"
+
+#define INT803(x) ((int64_t)(x) << word_shift)
+
+// run from address until the processor stops
+static void run(processor_t *proc, int address, int limit) {
+  proc->program_counter = address << 1;
+  proc->mode = exec_mode_run;
+  for (int i = 0; i < limit; ++i) {
+    cpu803_execute(proc);
+    if (exec_mode_stop == proc->mode) {
+      return;
+    }
+  }
+  printf("program at: %d did not stop\n", address);
+  exit(1);
+}
+
+static void check(const char *title, int64_t actual, int64_t expected) {
+  if (actual != expected) {
+    printf("%-24s: actual:   %" PRId64 "\n"
+           "%-24s  expected: %" PRId64 "\n",
+           title,
+           actual,
+           "",
+           expected);
+    exit(1);
+  }
+}
+
+int main(int argc, char *argv[]) {
+
+  processor_t *proc = calloc(1, sizeof(processor_t));
+  if (NULL == proc) {
+    printf("calloc failed\n");
+    return 1;
+  }
+  flight_entry_t history[flight_size];
+
+  // nothing recorded yet
+  check("empty", flight_history(proc, history), 0);
+
+  // load, add and stop
+  core_write(proc, 4200, INT803(5));
+  core_write(proc, 4096, ELLIOTT(030, 4200, 0, 004, 4200));
+  core_write(proc, 4097, ELLIOTT(040, 4097, 0, 000, 0));
+  run(proc, 4096, 10);
+  int n = flight_history(proc, history);
+  check("recorded", n, proc->instructions);
+  check("first pc", history[0].program_counter, 4096 << 1);
+  check("first acc", history[0].accumulator, 0);
+  check("second pc", history[1].program_counter, 4096 << 1 | 1);
+  check("second acc", history[1].accumulator, INT803(5));
+  check("second word", history[1].word, proc->core_store[4096]);
+  check("last pc", history[n - 1].program_counter, 4097 << 1);
+  check("no fault", proc->fault, false);
+
+  // an unimplemented function is a fault and the oldest are overwritten
+  core_write(proc, 4201, INT803(1));
+  core_write(proc, 4098, ELLIOTT(004, 4201, 0, 041, 4098));
+  core_write(proc, 4099, ELLIOTT(030, 4200, 0, 066, 0));
+  proc->accumulator = INT803(-200);
+  run(proc, 4098, 1000);
+  check("fault", proc->fault, true);
+  n = flight_history(proc, history);
+  check("full", n, flight_size);
+  check("last fault pc", history[n - 1].program_counter, 4099 << 1 | 1);
+  check("last fault acc", history[n - 1].accumulator, INT803(5));
+  check("before fault", history[n - 2].program_counter, 4099 << 1);
+
+  free(proc);
+  return 0;
+}
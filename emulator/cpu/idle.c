@@ -0,0 +1,53 @@
+// idle.c
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "idle.h"
+#include "processor.h"
+
+// the snapshot interval doubles up to this number of steps so the loops
+// found are at most this long
+static const int idle_period_maximum = 1024;
+
+static void snapshot(processor_t *proc) {
+  idle_state_t *s = &proc->idle_state;
+  s->steps = 0;
+  s->program_counter = proc->program_counter;
+  s->accumulator = proc->accumulator;
+  s->auxiliary_register = proc->auxiliary_register;
+  s->overflow = proc->overflow;
+  s->b_addr = proc->b_addr;
+  s->b_data = proc->b_data;
+  s->store_changes = proc->store_changes;
+  s->transfers = proc->transfers;
+}
+
+void idle_reset(processor_t *proc) {
+  proc->idle_state.period = 1;
+  snapshot(proc);
+}
+
+// Brent's cycle detection: compare with a snapshot that is retaken at
+// doubling intervals; any store change breaks the cycle, so a loop
+// that increments a counter in the store is not detected
+bool idle_detect(processor_t *proc) {
+  idle_state_t *s = &proc->idle_state;
+
+  if (proc->program_counter == s->program_counter &&
+      proc->accumulator == s->accumulator &&
+      proc->auxiliary_register == s->auxiliary_register &&
+      proc->overflow == s->overflow && proc->b_addr == s->b_addr &&
+      proc->b_data == s->b_data && proc->store_changes == s->store_changes &&
+      proc->transfers == s->transfers) {
+    return true;
+  }
+
+  if (++s->steps >= s->period) {
+    if (s->period < idle_period_maximum) {
+      s->period *= 2;
+    }
+    snapshot(proc);
+  }
+  return false;
+}
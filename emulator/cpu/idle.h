@@ -0,0 +1,28 @@
+// idle.h
+
+#if !defined(IDLE_H)
+#define IDLE_H 1
+
+#include <stdbool.h>
+
+#include "processor.h"
+
+// detection of a program that is waiting in a loop for the operator
+//
+// the registers are compared with a snapshot after each step and
+// the program is idle if they repeat while no word of the store has
+// changed and no character was read or punched; a deterministic
+// machine in that state can only leave the loop after a command has
+// been received, e.g. a new word generator value or more tape
+//
+// a wait loop that changes the store on each pass, e.g. by counting,
+// never repeats a state so is not detected; a batch "wait" therefore
+// also ends after an instruction budget
+
+// discard the snapshot, e.g. after any command
+void idle_reset(processor_t *proc);
+
+// true if the program has repeated a state since the snapshot
+bool idle_detect(processor_t *proc);
+
+#endif
@@ -0,0 +1,81 @@
+// idle_test.c
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "buffer.h"
+#include "constants.h"
+#include "core.h"
+#include "cpu803.h"
+#include "idle.h"
+#include "processor.h"
+
+// run from address and return the number of steps until an idle loop is
+// detected or -1 if the program stops, waits for I/O or reaches the limit
+static int run(processor_t *proc, int address, int limit) {
+  proc->program_counter = address << 1;
+  proc->mode = exec_mode_run;
+  proc->io_busy = busy_none;
+  idle_reset(proc);
+  for (int i = 1; i <= limit; ++i) {
+    cpu803_execute(proc);
+    if (exec_mode_run != proc->mode || busy_none != proc->io_busy) {
+      return -1;
+    }
+    if (idle_detect(proc)) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+static void check(const char *title, bool ok) {
+  if (!ok) {
+    printf("failed: %s\n", title);
+    exit(1);
+  }
+}
+
+int main(int argc, char *argv[]) {
+
+  processor_t *proc = calloc(1, sizeof(processor_t));
+  if (NULL == proc) {
+    printf("calloc failed\n");
+    return 1;
+  }
+
+  // wait for the word generator to be negative
+  core_write(proc, 4096, ELLIOTT(070, 0, 0, 041, 4098));
+  core_write(proc, 4097, ELLIOTT(040, 4096, 0, 000, 0));
+  core_write(proc, 4098, ELLIOTT(040, 4098, 0, 000, 0));
+
+  proc->word_generator = 0;
+  int steps = run(proc, 4096, 100000);
+  check("word generator poll is idle", steps > 0 && steps < 100);
+  check("word generator was polled", proc->wg_polls > 0);
+
+  proc->word_generator = sign_bit;
+  check("word generator set is not idle", run(proc, 4096, 100000) < 0);
+  check("word generator set stops", exec_mode_stop == proc->mode);
+
+  // a counter is never idle
+  core_write(proc, 4100, ELLIOTT(022, 4200, 0, 040, 4100));
+  check("counter is not idle", run(proc, 4100, 100000) < 0);
+
+  // rewriting a link with the same value is idle
+  core_write(proc, 4101, ELLIOTT(073, 4201, 0, 040, 4101));
+  check("link store is idle", run(proc, 4101, 100000) > 0);
+
+  // reading characters is not idle, but waits once the tape runs out
+  core_write(proc, 4102, ELLIOTT(071, 0, 0, 040, 4102));
+  for (int i = 0; i < 200; ++i) {
+    buffer_put(&proc->reader[0], 0);
+  }
+  check("reader is not idle", run(proc, 4102, 100000) < 0);
+  check("reader is busy", busy_reader_1 == proc->io_busy);
+
+  free(proc);
+  return 0;
+}
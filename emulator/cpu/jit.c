@@ -0,0 +1,362 @@
+// jit.c
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cpu803.h"
+#include "jit.h"
+
+#if defined(__x86_64__) && !defined(SWITCH_DISPATCH)
+
+#include <sys/mman.h>
+
+enum {
+  jit_threshold = 8,               // executions of a word before translating
+  jit_block_words = 64,            // maximum words in one block
+  jit_word_code = 256,             // upper bound of native code for a word
+  jit_code_size = 4 * 1024 * 1024, // native code buffer
+};
+
+// translated code, called with the processor as its only argument
+typedef void block_t(processor_t *proc);
+
+struct jit_struct {
+  uint8_t *code;                 // native code buffer
+  size_t used;                   // bytes of code buffer in use
+  bool covered[memory_size];     // word may be part of a block
+  int heat[memory_size];         // executions of an untranslated word
+  uint8_t length[memory_size];   // words in the block starting here
+  block_t *entry[memory_size];   // block starting at this word
+  int64_t blocks;                // number of blocks translated
+  int64_t flushes;               // number of times the code buffer filled
+};
+
+bool jit_available(void) { return true; }
+
+jit_t *jit_create(void) {
+
+  jit_t *jit = calloc(1, sizeof(jit_t));
+  if (NULL == jit) {
+    return NULL;
+  }
+  // the buffer is only made executable once code has been written
+  jit->code = mmap(NULL,
+                   jit_code_size,
+                   PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANON,
+                   -1,
+                   0);
+  if (MAP_FAILED == jit->code) {
+    free(jit);
+    return NULL;
+  }
+  return jit;
+}
+
+void jit_destroy(jit_t *jit) {
+  if (NULL == jit) {
+    return;
+  }
+  munmap(jit->code, jit_code_size);
+  free(jit);
+}
+
+int64_t jit_blocks(const jit_t *jit) { return jit->blocks; }
+int64_t jit_flushes(const jit_t *jit) { return jit->flushes; }
+
+// remove every block that contains the overwritten word, their code is
+// only reclaimed when the buffer fills; the running block may be one of
+// them so it must return as soon as the write completes
+void jit_invalidate(processor_t *proc, int address) {
+  jit_t *jit = proc->jit;
+  address &= address_bits;
+  jit->heat[address] = 0; // may now be possible to translate
+  if (!jit->covered[address]) {
+    return;
+  }
+  jit->covered[address] = false;
+  int first = address < jit_block_words ? 0 : address - jit_block_words + 1;
+  for (int start = first; start <= address; ++start) {
+    if (NULL != jit->entry[start] && start + jit->length[start] > address) {
+      jit->entry[start] = NULL;
+      jit->heat[start] = 0;
+    }
+  }
+  proc->jit_abort = true;
+}
+
+static void discard(jit_t *jit) {
+  memset(jit->covered, 0, sizeof(jit->covered));
+  memset(jit->heat, 0, sizeof(jit->heat));
+  memset(jit->entry, 0, sizeof(jit->entry));
+  jit->used = 0;
+  ++jit->flushes;
+}
+
+// functions that leave the straight line: jumps, I/O that may be busy
+// and the functions which may stop
+static bool ends_block(int op) {
+  switch (op) {
+  case 040:
+  case 041:
+  case 042:
+  case 043:
+  case 044:
+  case 045:
+  case 046:
+  case 047:
+  case 066:
+  case 067:
+  case 071:
+  case 072:
+  case 074:
+  case 077:
+    return true;
+  default:
+    return false;
+  }
+}
+
+// functions that write to the store
+static bool writes_store(int op) {
+  return (op >= 010 && op <= 037) || 073 == op;
+}
+
+// x86-64 code generation, the processor pointer is kept in rbx
+
+static uint8_t *emit8(uint8_t *p, uint8_t b) {
+  *p++ = b;
+  return p;
+}
+
+static uint8_t *emit32(uint8_t *p, uint32_t v) {
+  memcpy(p, &v, sizeof(v));
+  return p + sizeof(v);
+}
+
+static uint8_t *emit64(uint8_t *p, uint64_t v) {
+  memcpy(p, &v, sizeof(v));
+  return p + sizeof(v);
+}
+
+// call fn(proc, arg)
+static uint8_t *emit_call(uint8_t *p, uintptr_t fn, int64_t arg) {
+  p = emit8(p, 0x48); // mov rdi, rbx
+  p = emit8(p, 0x89);
+  p = emit8(p, 0xdf);
+  if (arg >= 0 && arg <= UINT32_MAX) {
+    p = emit8(p, 0xbe); // mov esi, imm32
+    p = emit32(p, (uint32_t)arg);
+  } else {
+    p = emit8(p, 0x48); // mov rsi, imm64
+    p = emit8(p, 0xbe);
+    p = emit64(p, (uint64_t)arg);
+  }
+  p = emit8(p, 0x48); // mov rax, imm64
+  p = emit8(p, 0xb8);
+  p = emit64(p, fn);
+  p = emit8(p, 0xff); // call rax
+  p = emit8(p, 0xd0);
+  return p;
+}
+
+static uint8_t *emit_add64(uint8_t *p, size_t offset, uint32_t value) {
+  p = emit8(p, 0x48); // add qword [rbx + offset], imm32
+  p = emit8(p, 0x81);
+  p = emit8(p, 0x83);
+  p = emit32(p, offset);
+  return emit32(p, value);
+}
+
+// count the instructions executed and their time and return; after a
+// first instruction the word is loaded into B so the interpreter can
+// execute the second
+typedef struct {
+  int instructions;
+  uint32_t time; // excluding B-modified instructions which add their own
+} count_t;
+
+static uint8_t *
+emit_return(uint8_t *p, count_t count, bool load_b, int64_t word) {
+  p = emit_add64(p, offsetof(processor_t, instructions), count.instructions);
+  p = emit_add64(p, offsetof(processor_t, emulated_time), count.time);
+  if (load_b) {
+    p = emit_call(p, (uintptr_t)cpu803_load_b, word);
+  }
+  p = emit8(p, 0x5b); // pop rbx
+  p = emit8(p, 0xc3); // ret
+  return p;
+}
+
+// jne to a return that is placed after the checks
+static uint8_t *emit_check_abort(uint8_t *p, uint8_t **branch) {
+  p = emit8(p, 0x80); // cmp byte [rbx + jit_abort], 0
+  p = emit8(p, 0xbb);
+  p = emit32(p, offsetof(processor_t, jit_abort));
+  p = emit8(p, 0x00);
+  p = emit8(p, 0x75); // jne rel8
+  *branch = p;
+  return emit8(p, 0x00);
+}
+
+static uint8_t *
+emit_check32(uint8_t *p, uint8_t **branch, size_t offset, uint32_t value) {
+  p = emit8(p, 0x81); // cmp dword [rbx + offset], imm32
+  p = emit8(p, 0xbb);
+  p = emit32(p, offset);
+  p = emit32(p, value);
+  p = emit8(p, 0x75); // jne rel8
+  *branch = p;
+  return emit8(p, 0x00);
+}
+
+// complete the checks with an out of line return
+static uint8_t *emit_checked_return(uint8_t *p,
+                                    uint8_t **branches,
+                                    size_t branch_count,
+                                    count_t count,
+                                    bool load_b,
+                                    int64_t word) {
+  p = emit8(p, 0xeb); // jmp rel8 over the return
+  uint8_t *skip = p;
+  p = emit8(p, 0x00);
+  for (size_t i = 0; i < branch_count; ++i) {
+    *branches[i] = (uint8_t)(p - (branches[i] + 1));
+  }
+  p = emit_return(p, count, load_b, word);
+  *skip = (uint8_t)(p - (skip + 1));
+  return p;
+}
+
+// translate the words from first to a block, NULL if the first word
+// cannot be translated
+static block_t *translate(jit_t *jit, processor_t *proc, int first) {
+
+  const decoded_t *d = cpu803_fetch(proc, first);
+  if (d->stop || ends_block(d->op1)) {
+    return NULL;
+  }
+
+  if (jit->used + (jit_block_words + 1) * jit_word_code > jit_code_size) {
+    discard(jit);
+  }
+  if (0 != mprotect(jit->code, jit_code_size, PROT_READ | PROT_WRITE)) {
+    return NULL;
+  }
+
+  uint8_t *start = jit->code + jit->used;
+  uint8_t *p = start;
+
+  p = emit8(p, 0x53); // push rbx
+  p = emit8(p, 0x48); // mov rbx, rdi
+  p = emit8(p, 0x89);
+  p = emit8(p, 0xfb);
+
+  int words = 0;
+  count_t count = {0, 0};
+  for (int address = first;
+       words < jit_block_words && address < memory_size;
+       ++address) {
+
+    d = cpu803_fetch(proc, address);
+    if (d->stop || ends_block(d->op1)) {
+      break;
+    }
+    jit->covered[address] = true;
+    ++words;
+
+    uint8_t *branches[3];
+
+    // first instruction
+    p = emit_call(p, (uintptr_t)cpu803_handler(d->op1), d->address1);
+    ++count.instructions;
+    count.time += d->time1;
+    if (writes_store(d->op1)) {
+      p = emit_check_abort(p, &branches[0]);
+      p = emit_checked_return(p, branches, 1, count, true, d->word);
+    }
+
+    // second instruction, the function of a B-modified instruction is
+    // only known when it executes so check that it did not leave the
+    // straight line
+    ++count.instructions;
+    if (d->b_modified) {
+      p = emit_call(p, (uintptr_t)cpu803_execute_modified, d->word);
+      p = emit_check32(p,
+                       &branches[0],
+                       offsetof(processor_t, program_counter),
+                       (address + 1) << 1);
+      p = emit_check32(
+        p, &branches[1], offsetof(processor_t, mode), exec_mode_run);
+      p = emit_check_abort(p, &branches[2]);
+      p = emit_checked_return(p, branches, 3, count, false, 0);
+    } else {
+      count.time += d->time2;
+      p = emit_call(p, (uintptr_t)cpu803_handler(d->op2), d->address2);
+      if (ends_block(d->op2)) {
+        break;
+      }
+      if (writes_store(d->op2)) {
+        p = emit_check_abort(p, &branches[0]);
+        p = emit_checked_return(p, branches, 1, count, false, 0);
+      }
+    }
+  }
+  p = emit_return(p, count, false, 0);
+
+  jit->used += p - start;
+  mprotect(jit->code, jit_code_size, PROT_READ | PROT_EXEC);
+
+  block_t *block = NULL;
+  memcpy(&block, &start, sizeof(block)); // object to function pointer
+  jit->length[first] = words;
+  ++jit->blocks;
+  return block;
+}
+
+void jit_execute(processor_t *proc) {
+
+  jit_t *jit = proc->jit;
+  // past the top of store the program counter is not wrapped, and a
+  // block checks it against its own addresses, so only interpret there
+  int pc = proc->program_counter;
+  int address = (pc >> 1) & address_bits;
+  block_t *block = NULL;
+  if (pc == address << 1) {
+    block = jit->entry[address];
+    if (NULL == block && jit->heat[address] < jit_threshold &&
+        ++jit->heat[address] == jit_threshold) {
+      block = translate(jit, proc, address);
+      jit->entry[address] = block;
+    }
+  }
+
+  if (NULL == block) {
+    cpu803_execute(proc);
+    return;
+  }
+
+  // all words of a block are executed in full so B is not in use
+  proc->b_addr = 0;
+  proc->jit_abort = false;
+  block(proc);
+}
+
+#else
+
+bool jit_available(void) { return false; }
+
+jit_t *jit_create(void) { return NULL; }
+
+void jit_destroy(jit_t *jit) {}
+
+void jit_execute(processor_t *proc) { cpu803_execute(proc); }
+
+void jit_invalidate(processor_t *proc, int address) {}
+
+int64_t jit_blocks(const jit_t *jit) { return 0; }
+int64_t jit_flushes(const jit_t *jit) { return 0; }
+
+#endif
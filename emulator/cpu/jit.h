@@ -0,0 +1,38 @@
+// jit.h
+
+#if !defined(JIT_H)
+#define JIT_H 1
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "processor.h"
+
+// translation of frequently executed words to native code
+//
+// a block is a straight run of words that starts at the first
+// instruction of a word and ends at a jump, I/O or an unimplemented
+// function; each instruction becomes a direct call to its handler
+// so the results are identical to the interpreter
+
+typedef struct jit_struct jit_t;
+
+// true if translation is supported on this host
+bool jit_available(void);
+
+// NULL if not available or out of memory
+jit_t *jit_create(void);
+void jit_destroy(jit_t *jit);
+
+// execute a translated block at the program counter, or fall back to
+// the interpreter for a single word
+void jit_execute(processor_t *proc);
+
+// a previously decoded word was overwritten
+void jit_invalidate(processor_t *proc, int address);
+
+// counters for statistics
+int64_t jit_blocks(const jit_t *jit);
+int64_t jit_flushes(const jit_t *jit);
+
+#endif
@@ -0,0 +1,245 @@
+// jit_test.c
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "constants.h"
+#include "core.h"
+#include "cpu803.h"
+#include "jit.h"
+#include "processor.h"
+
+// program layout
+enum {
+  code_start = 4096,
+  code_words = 64,
+  data_start = 4200,
+  data_words = 32,
+  modifier_start = 4240, // only read, so modified addresses stay small
+  modifier_words = 8,
+  step_limit = 20000,
+};
+
+// deterministic pseudo random numbers
+static uint64_t seed = 803;
+static unsigned int rnd(unsigned int n) {
+  seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+  return (unsigned int)(seed >> 33) % n;
+}
+
+// functions that cannot wait for I/O or stop, except for a jump to
+// itself; the floating point functions are omitted as random operands
+// are not valid floating point numbers
+static int random_op(void) {
+  static const int ops[] = {
+    000, 001, 002, 003, 004, 005, 006, 007, 010, 011, 012, 013,
+    014, 015, 016, 017, 020, 021, 022, 023, 024, 025, 026, 027,
+    030, 031, 032, 033, 034, 035, 036, 037, 040, 041, 042, 043,
+    044, 045, 046, 047, 050, 051, 052, 053, 054, 055, 056, 057,
+    065, 070, 073,
+  };
+  return ops[rnd(sizeof(ops) / sizeof(ops[0]))];
+}
+
+static int random_address(int op) {
+  if (op >= 040 && op <= 047) {
+    return code_start + rnd(code_words);
+  }
+  if ((op >= 050 && op <= 051) || (op >= 054 && op <= 055) || 065 == op) {
+    return rnd(8) ? rnd(40) : 4096; // shift count or standardise
+  }
+  if (073 == op && 0 == rnd(2)) {
+    return code_start + rnd(code_words); // self modification
+  }
+  return data_start + rnd(data_words);
+}
+
+static int64_t random_word(void) {
+  int op1 = random_op();
+  int op2 = random_op();
+  int64_t word = ((int64_t)(op1) << first_op_shift) |
+                 ((int64_t)(op2) << second_op_shift) |
+                 ((int64_t)(random_address(op2)) << second_address_shift);
+  if (0 == rnd(4) && op1 < 010 && !(op2 >= 040 && op2 <= 047)) {
+    int address = modifier_start + rnd(modifier_words);
+    return word | ((int64_t)(address) << first_address_shift) | b_mod_bit;
+  }
+  return word | ((int64_t)(random_address(op1)) << first_address_shift);
+}
+
+static void generate(processor_t *proc) {
+  for (int i = 0; i < code_words; ++i) {
+    core_write(proc, code_start + i, random_word());
+  }
+  // stop rather than execute the data
+  int end = code_start + code_words;
+  core_write(proc,
+             end,
+             (040LL << first_op_shift) |
+               ((int64_t)(end) << first_address_shift));
+  for (int i = 0; i < data_words; ++i) {
+    uint64_t n = rnd(1 << 20) - (1 << 19);
+    core_write(proc, data_start + i, (int64_t)(n << word_shift));
+  }
+  for (int i = 0; i < modifier_words; ++i) {
+    core_write(proc, modifier_start + i, (int64_t)(rnd(4)) << word_shift);
+  }
+}
+
+static bool halted(processor_t *proc) {
+  return exec_mode_run != proc->mode || busy_none != proc->io_busy;
+}
+
+static void
+check(int test, const char *title, int64_t actual, int64_t expected) {
+  if (actual != expected) {
+    printf("test %d %-16s: jit:         %" PRId64 "\n"
+           "%-24s  interpreter: %" PRId64 "\n",
+           test,
+           title,
+           actual,
+           "",
+           expected);
+    exit(1);
+  }
+}
+
+// run both engines and compare them whenever they have executed the
+// same number of instructions
+static void compare(int test, processor_t *jit, processor_t *interpreter) {
+
+  for (int steps = 0; steps < 2 * step_limit; ++steps) {
+    if (jit->instructions < interpreter->instructions) {
+      jit_execute(jit);
+      continue;
+    }
+    if (interpreter->instructions < jit->instructions) {
+      cpu803_execute(interpreter);
+      continue;
+    }
+
+    check(test, "pc", jit->program_counter, interpreter->program_counter);
+    check(test, "a", jit->accumulator, interpreter->accumulator);
+    check(test,
+          "ar",
+          jit->auxiliary_register,
+          interpreter->auxiliary_register);
+    check(test, "overflow", jit->overflow, interpreter->overflow);
+    check(test, "mode", jit->mode, interpreter->mode);
+    check(test, "busy", jit->io_busy, interpreter->io_busy);
+    check(test, "time", jit->emulated_time, interpreter->emulated_time);
+    if (halted(jit) || halted(interpreter) || steps >= step_limit) {
+      for (int i = 0; i < memory_size; ++i) {
+        check(test, "store", jit->core_store[i], interpreter->core_store[i]);
+      }
+      return;
+    }
+    jit_execute(jit);
+  }
+  printf("test %d did not synchronise\n", test);
+  exit(1);
+}
+
+int main(int argc, char *argv[]) {
+
+  if (!jit_available()) {
+    printf("jit not available\n");
+    return 0;
+  }
+
+  processor_t *jit = calloc(1, sizeof(processor_t));
+  processor_t *interpreter = calloc(1, sizeof(processor_t));
+  if (NULL == jit || NULL == interpreter) {
+    printf("calloc failed\n");
+    return 1;
+  }
+  jit->jit = jit_create();
+  if (NULL == jit->jit) {
+    printf("jit_create failed\n");
+    return 1;
+  }
+
+  // a block that overwrites one of its own later words must not execute
+  // the old translation, and a word that overwrites itself must take its
+  // second instruction from the B Register
+  core_write(interpreter, 4096, ELLIOTT(030, 4110, 0, 020, 4097));
+  core_write(interpreter, 4097, ELLIOTT(022, 4200, 0, 000, 0));
+  core_write(interpreter, 4098, ELLIOTT(030, 4111, 0, 020, 4097));
+  core_write(interpreter, 4099, ELLIOTT(030, 4112, 0, 000, 0));
+  core_write(interpreter, 4100, ELLIOTT(020, 4100, 0, 022, 4203));
+  core_write(interpreter, 4101, ELLIOTT(030, 4113, 0, 020, 4100));
+  core_write(interpreter, 4102, ELLIOTT(022, 4201, 0, 040, 4096));
+  core_write(interpreter, 4110, ELLIOTT(022, 4202, 0, 000, 0));
+  core_write(interpreter, 4111, ELLIOTT(022, 4200, 0, 000, 0));
+  core_write(interpreter, 4112, ELLIOTT(000, 0, 0, 022, 4204));
+  core_write(interpreter, 4113, ELLIOTT(020, 4100, 0, 022, 4203));
+  for (int i = 0; i < memory_size; ++i) {
+    core_write(jit, i, interpreter->core_store[i]);
+  }
+  jit->program_counter = interpreter->program_counter = 4096 << 1;
+  jit->mode = interpreter->mode = exec_mode_run;
+  compare(-1, jit, interpreter);
+  if (jit_blocks(jit->jit) < 2) {
+    printf("self modifying block was not translated again\n");
+    return 1;
+  }
+
+  // running off the top of store continues from address 0 as in the
+  // interpreter, also once the initial instructions have been translated
+  for (int pass = 0; pass < 32; ++pass) {
+    for (int i = 4; i < memory_size; ++i) {
+      core_write(interpreter, i, 0);
+    }
+    core_write(interpreter, 8191, ELLIOTT(022, 4201, 0, 022, 4201));
+    for (int i = 0; i < memory_size; ++i) {
+      core_write(jit, i, interpreter->core_store[i]);
+    }
+    int pc = (0 == pass % 2 ? 8191 : 0) << 1;
+    jit->program_counter = interpreter->program_counter = pc;
+    jit->mode = interpreter->mode = exec_mode_run;
+    jit->io_busy = interpreter->io_busy = busy_none;
+    jit->b_addr = interpreter->b_addr = 0;
+    compare(-2, jit, interpreter);
+  }
+
+  for (int test = 0; test < 500; ++test) {
+
+    generate(interpreter);
+    for (int i = 0; i < memory_size; ++i) {
+      core_write(jit, i, interpreter->core_store[i]);
+    }
+
+    // run the same program several times so blocks are translated
+    for (int pass = 0; pass < 3; ++pass) {
+      int64_t wg = (int64_t)(rnd(1 << 20)) << word_shift;
+      int pc = code_start << 1;
+      for (processor_t *p = jit; NULL != p;
+           p = (p == jit) ? interpreter : NULL) {
+        p->program_counter = pc;
+        p->mode = exec_mode_run;
+        p->io_busy = busy_none;
+        p->word_generator = wg;
+        p->b_addr = 0;
+      }
+      compare(test, jit, interpreter);
+    }
+  }
+
+  printf("blocks: %" PRId64 " flushes: %" PRId64 "\n",
+         jit_blocks(jit->jit),
+         jit_flushes(jit->jit));
+
+  if (0 == jit_blocks(jit->jit)) {
+    printf("no blocks were translated\n");
+    return 1;
+  }
+
+  jit_destroy(jit->jit);
+  free(jit);
+  free(interpreter);
+  return 0;
+}
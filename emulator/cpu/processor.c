@@ -6,23 +6,79 @@
 #include <fcntl.h>
 #include <inttypes.h>
 #include <pthread.h>
+#include <semaphore.h>
 #include <stdarg.h>
 #include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
 #include <sys/select.h>
-#include <sys/socket.h>
+#include <time.h>
 #include <unistd.h> // sleep / usleep / read / write / close
 
+#include "clock.h"
 #include "convert.h"
 #include "core.h"
 #include "cpu803.h"
 #include "elliott803.h"
+#include "film.h"
+#include "flight.h"
+#include "idle.h"
+#include "jit.h"
 #include "processor.h"
+#include "profile.h"
+#include "sample.h"
+#include "snapshot.h"
+#include "trace.h"
 
 static void *main_loop(void *arg);
+static void system_reset(elliott803_t *proc);
+
+// free everything but the thread, which must not be running
+static void release(elliott803_t *proc) {
+  free((void *)proc->name);
+  if (NULL != proc->commands) {
+    ring_destroy(proc->commands);
+    free(proc->commands);
+  }
+  if (NULL != proc->replies) {
+    ring_destroy(proc->replies);
+    free(proc->replies);
+  }
+  for (size_t i = 0; i < reader_units; ++i) {
+    free(proc->tape[i].data);
+    tape_t *pending = atomic_exchange(&proc->tape_pending[i], NULL);
+    if (NULL != pending) {
+      free(pending->data);
+      free(pending);
+    }
+  }
+  jit_destroy(proc->jit);
+  profile_destroy(proc->profile);
+  sample_destroy(proc);
+  trace_destroy(proc);
+  film_release(proc);
+
+  if (0 != proc->mapped_size) {
+    munmap(proc, proc->mapped_size);
+  } else {
+    memset(proc, 0, sizeof(elliott803_t));
+    free(proc);
+  }
+}
+
+// one direction of the channel, NULL if it could not be created
+static ring_t *channel(void) {
+  ring_t *ring = malloc(sizeof(ring_t));
+  if (NULL != ring && !ring_init(ring)) {
+    ring_destroy(ring);
+    free(ring);
+    ring = NULL;
+  }
+  return ring;
+}
 
 // create a processor
 elliott803_t *elliott803_create(const char *name) {
@@ -35,14 +91,17 @@ elliott803_t *elliott803_create(const char *name) {
   memset(proc, 0, sizeof(elliott803_t));
   proc->mode = exec_mode_stop;
   proc->name = strdup(name);
+  proc->quantum = quantum_default;
+  proc->punch_frame = buffer_capacity;
+  idle_reset(proc);
+  system_reset(proc);
 
-  int sockets[2];
-  if (0 != socketpair(PF_UNIX, SOCK_DGRAM, 0, sockets)) {
+  proc->commands = channel();
+  proc->replies = channel();
+  if (NULL == proc->commands || NULL == proc->replies) {
     printf("error: %d %s\n", errno, strerror(errno));
     goto fail;
   }
-  proc->client_socket = sockets[0];
-  proc->processor_socket = sockets[1];
 
   pthread_create(&proc->thread, NULL, main_loop, proc);
 
@@ -50,7 +109,7 @@ elliott803_t *elliott803_create(const char *name) {
 
 fail:
   if (NULL != proc) {
-    free(proc);
+    release(proc);
   }
   return NULL;
 }
@@ -63,26 +122,20 @@ void elliott803_destroy(elliott803_t *proc) {
     return;
   }
 
-  // send thread terminate message
+  // nothing will read the replies, so the thread must not sleep on a
+  // full ring before it sees the terminate message
+  ring_close(proc->replies);
   elliott803_send(proc, "terminate", 10);
 
   // use join to wait for shutdown
   void *rc = NULL;
   pthread_join(proc->thread, &rc);
 
-  if (NULL != proc->name) {
-    free((void *)proc->name);
-  }
-
-  close(proc->client_socket);
-  close(proc->processor_socket);
-
-  memset(proc, 0, sizeof(elliott803_t));
-  free(proc);
+  release(proc);
 }
 
-// get the send/receive fd for a select
-int elliott803_get_fd(elliott803_t *proc) { return proc->client_socket; }
+// get the receive fd for a select, readable while replies are waiting
+int elliott803_get_fd(elliott803_t *proc) { return proc->replies->fd; }
 
 // send a command
 // returns:
@@ -91,25 +144,15 @@ int elliott803_get_fd(elliott803_t *proc) { return proc->client_socket; }
 ssize_t
 elliott803_send(elliott803_t *proc, const char *buffer, size_t buffer_size) {
 
-  for (;;) {
-    errno = 0;
-    ssize_t n = send(proc->client_socket, buffer, buffer_size, MSG_DONTROUTE);
-    if (-1 == n) {
-      // if no buffer space, just retry
-      if (ENOBUFS == errno) {
-        pthread_yield();
-        continue;
-      }
-      // if interrupted system call, just retry
-      if (EINTR != errno) {
-        fprintf(stderr, "elliott_send: error: %s\n", strerror(errno));
-        abort();
-        return errno; // negative value
-      }
-      continue;
-    }
-    return n;
+  // the processor ends its current quantum early when it sees the
+  // command, and the client sleeps if it is still busy with earlier ones
+  if (buffer_size > ring_capacity / 2) {
+    return -EMSGSIZE;
   }
+  if (!ring_put_wait(proc->commands, buffer, buffer_size)) {
+    return -EPIPE;
+  }
+  return buffer_size;
 }
 
 // receive a response
@@ -118,48 +161,92 @@ elliott803_send(elliott803_t *proc, const char *buffer, size_t buffer_size) {
 //   negative: error code
 ssize_t
 elliott803_receive(elliott803_t *proc, char *buffer, size_t buffer_size) {
+  return ring_get(proc->replies, buffer, buffer_size);
+}
 
-  for (;;) {
-    errno = 0;
-    ssize_t n = recv(
-      proc->client_socket, buffer, buffer_size, MSG_WAITALL | MSG_DONTWAIT);
-    if (-1 == n) {
-      // if interrupted system call, just retry
-      if (EINTR != errno) {
-        // fprintf(stderr, "select error: %s\n", strerror(errno));
-        return errno; // negative value
-      }
-      continue;
-    }
+// load a tape into a reader
+// returns:
+//   positive: bytes sent
+//   negative: error code
+ssize_t elliott803_load_tape(elliott803_t *proc,
+                             int unit,
+                             uint8_t *data,
+                             size_t size) {
+
+  if (unit < 1 || unit > reader_units) {
+    free(data);
+    return -EINVAL;
+  }
+  tape_t *tape = malloc(sizeof(tape_t));
+  if (NULL == tape) {
+    free(data);
+    return -ENOMEM;
+  }
+  *tape = (tape_t){
+    .data = data,
+    .size = NULL == data ? 0 : size,
+  };
+
+  // the processor thread takes the tape when it runs the command, and
+  // the ring orders this store before it; one it has not yet taken is
+  // no longer wanted
+  tape_t *replaced = atomic_exchange(&proc->tape_pending[unit - 1], tape);
+  if (NULL != replaced) {
+    free(replaced->data);
+    free(replaced);
+  }
+  char packet[256];
+  int n = snprintf(packet, sizeof(packet), "tape %d", unit);
+  return elliott803_send(proc, packet, n + 1);
+}
+
+// a request from elliott803_clone, which waits until it is done
+typedef struct {
+  sem_t done;
+  elliott803_t **clones;
+  int count; // requested, then created
+} clone_request_t;
+
+// create copies of the instance sharing its state copy-on-write
+// returns:
+//   number created
+int elliott803_clone(elliott803_t *proc, elliott803_t **clones, int count) {
 
-    return n;
+  clone_request_t request = {
+    .clones = clones,
+    .count = count,
+  };
+  if (count <= 0 || 0 != sem_init(&request.done, 0, 0)) {
+    return 0;
   }
+
+  // the processor thread makes the copies between instructions so
+  // the state is consistent
+  char packet[256];
+  int n = snprintf(
+    packet, sizeof(packet), "fork %" PRIxPTR, (uintptr_t)(&request));
+  if (elliott803_send(proc, packet, n + 1) < 0) {
+    request.count = 0;
+  } else {
+    while (0 != sem_wait(&request.done) && EINTR == errno) {
+    }
+  }
+  sem_destroy(&request.done);
+  return request.count;
 }
 
 // reply to client
 static ssize_t
 reply(elliott803_t *proc, const char *buffer, size_t buffer_size) {
 
-  for (;;) {
-    errno = 0;
-    ssize_t n =
-      send(proc->processor_socket, buffer, buffer_size, MSG_DONTROUTE);
-    if (-1 == n) {
-      // if no buffer space, just retry
-      if (ENOBUFS == errno) {
-        pthread_yield();
-        continue;
-      }
-      // if interrupted system call, just retry
-      if (EINTR != errno) {
-        fprintf(stderr, "reply: send error: %s\n", strerror(errno));
-        abort();
-        return errno; // negative value
-      }
-      continue;
-    }
-    return n;
+  // if no space, sleep until the client catches up
+  if (buffer_size > ring_capacity / 2) {
+    return -EMSGSIZE;
   }
+  if (!ring_put_wait(proc->replies, buffer, buffer_size)) {
+    return -EPIPE;
+  }
+  return buffer_size;
 }
 
 // must use constant string and it includes '\0'
@@ -170,8 +257,8 @@ reply(elliott803_t *proc, const char *buffer, size_t buffer_size) {
   } while (0)
 
 // busy device as string
-static const char *busy_device(elliott803_t *proc) {
-  switch (proc->io_busy) {
+static const char *busy_device(busy_t busy) {
+  switch (busy) {
   case busy_none:
     return "";
   case busy_reader_1:
@@ -354,7 +441,7 @@ static bool action_memory_write(elliott803_t *proc, const char *params) {
     const_reply(proc, "error invalid machine code");
     return true;
   }
-  proc->core_store[addr & address_bits] = w;
+  core_write(proc, addr, w);
 
   char buffer[256];
   snprintf(buffer, sizeof(buffer), "mw %4" PRId64 ": ", addr);
@@ -385,7 +472,7 @@ static bool action_current_status(elliott803_t *proc, const char *params) {
                        5 * (proc->program_counter & 1),
                        state,
                        proc->overflow ? "overflow" : "",
-                       busy_device(proc));
+                       busy_device(proc->io_busy));
   n = reply(proc, buffer, n + 1); // include '\0'
   assert(0 != n);
 
@@ -598,6 +685,33 @@ static bool action_word_generator(elliott803_t *proc, const char *params) {
   return true;
 }
 
+// replace the tape in a reader with the one the client left pending
+// (for internal use by elliott803_load_tape)
+static bool action_tape(elliott803_t *proc, const char *params) {
+
+  int unit = 0;
+  if (1 != sscanf(params, "%d", &unit)) {
+    const_reply(proc, "error invalid tape");
+    return true;
+  }
+  if (unit < 1 || unit > reader_units) {
+    const_reply(proc, "error invalid reader unit number");
+    return true;
+  }
+
+  // NULL if an earlier command already took a later tape
+  tape_t *pending = atomic_exchange(&proc->tape_pending[unit - 1], NULL);
+  if (NULL != pending) {
+    tape_t *tape = &proc->tape[unit - 1];
+    free(tape->data);
+    *tape = *pending;
+    free(pending);
+  }
+
+  const_reply(proc, "ok");
+  return true;
+}
+
 // check for stopped or word generator polling
 static bool action_check(elliott803_t *proc, const char *params) {
 
@@ -619,6 +733,881 @@ static bool action_check(elliott803_t *proc, const char *params) {
   return true;
 }
 
+// select whether punched characters are sent in batches or one at a
+// time, e.g. to watch the teleprinter
+static bool action_output(elliott803_t *proc, const char *params) {
+
+  if (0 == strcmp("batch", params)) {
+    proc->punch_frame = buffer_capacity;
+  } else if (0 == strcmp("char", params)) {
+    proc->punch_frame = 1;
+  } else if ('\0' != params[0]) {
+    const_reply(proc, "error invalid output");
+    return true;
+  }
+
+  if (1 == proc->punch_frame) {
+    const_reply(proc, "output char");
+  } else {
+    const_reply(proc, "output batch");
+  }
+  return true;
+}
+
+// set and/or display the number of instructions executed between
+// polls of the control channel
+static bool action_quantum(elliott803_t *proc, const char *params) {
+
+  if ('\0' != params[0]) {
+    int quantum = 0;
+    for (;;) {
+      char c = *params++;
+      if (c >= '0' && c <= '9') {
+        quantum = quantum * 10 + c - '0';
+        if (quantum > quantum_maximum) {
+          const_reply(proc, "error quantum too large");
+          return true;
+        }
+      } else if ('\0' == c) {
+        break;
+      } else {
+        const_reply(proc, "error invalid quantum");
+        return true;
+      }
+    }
+    if (quantum < 1) {
+      const_reply(proc, "error quantum too small");
+      return true;
+    }
+    proc->quantum = quantum;
+  }
+
+  char buffer[256];
+  ssize_t n = snprintf(buffer, sizeof(buffer), "quantum %d", proc->quantum);
+  n = reply(proc, buffer, n + 1); // include '\0'
+  assert(0 != n);
+
+  return true;
+}
+
+// names of the events a client can subscribe to
+// clang-format off
+static const struct {
+  const char *name;
+  event_t event;
+} event_names[] = {
+  {"stop", event_stop},         //
+  {"idle", event_idle},         //
+  {"starved", event_starved},   //
+  {"punch", event_punch},       //
+  {"overflow", event_overflow}, //
+  {"limit", event_limit},       //
+};
+// clang-format on
+
+// set and/or display the events pushed to the client
+static bool action_events(elliott803_t *proc, const char *params) {
+
+  if ('\0' != params[0]) {
+    unsigned int events = 0;
+    while ('\0' != *params) {
+      size_t length = strcspn(params, " ");
+      if (0 == strncmp("all", params, length) && 3 == length) {
+        events = ~0u;
+      } else if (0 == strncmp("none", params, length) && 4 == length) {
+        events = 0;
+      } else {
+        size_t i = 0;
+        while (i < SizeOfArray(event_names) &&
+               (strlen(event_names[i].name) != length ||
+                0 != strncmp(event_names[i].name, params, length))) {
+          ++i;
+        }
+        if (i >= SizeOfArray(event_names)) {
+          const_reply(proc, "error invalid event");
+          return true;
+        }
+        events |= event_names[i].event;
+      }
+      params += length;
+      params += strspn(params, " ");
+    }
+    proc->events = events;
+
+    // only changes after subscribing are reported
+    proc->event_mode = proc->mode;
+    proc->event_idle = proc->idle;
+    proc->event_busy = proc->io_busy;
+    proc->event_overflow = proc->overflow;
+    proc->event_transfers = proc->transfers;
+  }
+
+  char buffer[256];
+  ssize_t n = snprintf(buffer, sizeof(buffer), "events");
+  for (size_t i = 0; i < SizeOfArray(event_names); ++i) {
+    if (0 != (proc->events & event_names[i].event)) {
+      n += snprintf(
+        &buffer[n], sizeof(buffer) - n, " %s", event_names[i].name);
+    }
+  }
+  n = reply(proc, buffer, n + 1); // include '\0'
+  assert(0 != n);
+
+  return true;
+}
+
+// set and/or display the number of instructions left before the
+// machine is stopped
+static bool action_limit(elliott803_t *proc, const char *params) {
+
+  if (0 == strcmp("off", params)) {
+    proc->instruction_limit = 0;
+  } else if ('\0' != params[0]) {
+    int64_t limit = 0;
+    for (;;) {
+      char c = *params++;
+      if (c >= '0' && c <= '9') {
+        limit = limit * 10 + c - '0';
+        if (limit > INT64_MAX / 100) {
+          const_reply(proc, "error limit too large");
+          return true;
+        }
+      } else if ('\0' == c) {
+        break;
+      } else {
+        const_reply(proc, "error invalid limit");
+        return true;
+      }
+    }
+    if (limit < 1) {
+      const_reply(proc, "error limit too small");
+      return true;
+    }
+    proc->instruction_limit = proc->instructions + limit;
+  }
+
+  if (0 == proc->instruction_limit) {
+    const_reply(proc, "limit off");
+    return true;
+  }
+  char buffer[256];
+  ssize_t n = snprintf(buffer,
+                       sizeof(buffer),
+                       "limit %" PRId64,
+                       proc->instruction_limit - proc->instructions);
+  n = reply(proc, buffer, n + 1); // include '\0'
+  assert(0 != n);
+
+  return true;
+}
+
+// send an event if the client subscribed to it
+static void push_event(elliott803_t *proc, event_t event, const char *s) {
+  if (0 != (proc->events & event)) {
+    ssize_t n = reply(proc, s, strlen(s) + 1); // include '\0'
+    assert(0 != n);
+  }
+}
+
+// push an event for each change of state since the last call, where a
+// quantum that ran may have started and stopped the machine
+static void push_events(elliott803_t *proc, bool ran) {
+
+  if (exec_mode_stop == proc->mode &&
+      (ran || exec_mode_stop != proc->event_mode)) {
+    push_event(proc, event_stop, "event stop");
+  }
+  proc->event_mode = proc->mode;
+
+  if (proc->idle && !proc->event_idle) {
+    push_event(proc, event_idle, "event idle");
+  }
+  proc->event_idle = proc->idle;
+
+  if (proc->overflow && !proc->event_overflow) {
+    push_event(proc, event_overflow, "event overflow");
+  }
+  proc->event_overflow = proc->overflow;
+
+  // a device that transferred since it was last busy is busy again
+  if (busy_none != proc->io_busy &&
+      (proc->io_busy != proc->event_busy ||
+       proc->transfers != proc->event_transfers)) {
+    char buffer[256];
+    switch (proc->io_busy) {
+    case busy_reader_1:
+    case busy_reader_2:
+    case busy_reader_3:
+      snprintf(buffer,
+               sizeof(buffer),
+               "event starved r%u",
+               proc->io_busy - busy_reader_1 + 1);
+      push_event(proc, event_starved, buffer);
+      break;
+    case busy_punch_1:
+    case busy_punch_2:
+    case busy_punch_3:
+      snprintf(buffer,
+               sizeof(buffer),
+               "event punch p%u",
+               proc->io_busy - busy_punch_1 + 1);
+      push_event(proc, event_punch, buffer);
+      break;
+    default:
+      break;
+    }
+    proc->event_busy = proc->io_busy;
+    proc->event_transfers = proc->transfers;
+  }
+}
+
+// add the time spent in an idle loop to the total
+static int64_t idle_time(elliott803_t *proc) {
+  if (!proc->idle) {
+    return proc->idle_time;
+  }
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return proc->idle_time +
+         (now.tv_sec - proc->idle_start.tv_sec) * 1000000000LL +
+         (now.tv_nsec - proc->idle_start.tv_nsec);
+}
+
+static void idle_end(elliott803_t *proc) {
+  proc->idle_time = idle_time(proc);
+  proc->idle = false;
+  idle_reset(proc);
+}
+
+// why the machine can make no progress without the client, NULL if it
+// is still running
+static const char *settled_state(elliott803_t *proc) {
+  if (exec_mode_stop == proc->mode) {
+    return "wait stop";
+  }
+  if (proc->idle) {
+    return "wait idle";
+  }
+  switch (proc->io_busy) {
+  case busy_reader_1:
+  case busy_reader_2:
+  case busy_reader_3:
+    return "wait busy";
+  default:
+    break;
+  }
+  if (0 != proc->wait_limit && proc->instructions >= proc->wait_limit) {
+    return "wait limit";
+  }
+  return NULL;
+}
+
+// reply when the machine has stopped, is idle or is waiting for a
+// reader, i.e. it can make no progress without the client, or after N
+// instructions, as a loop that changes the store is never found idle
+static bool action_wait(elliott803_t *proc, const char *params) {
+  int64_t budget = 0;
+  if ('\0' != params[0]) {
+    char *end = NULL;
+    budget = strtoll(params, &end, 10);
+    if ('\0' != *end || budget < 1 || budget > INT64_MAX / 2) {
+      const_reply(proc, "error invalid wait");
+      return true;
+    }
+  }
+  proc->wait_limit = 0 == budget ? 0 : proc->instructions + budget;
+  proc->wait_pending = true;
+  return true;
+}
+
+// select the pacing of execution
+static bool action_clock(elliott803_t *proc, const char *params) {
+
+  if (0 == strcmp("authentic", params)) {
+    clock_stop(proc); // restart timing from the current emulated time
+    proc->clock_mode = clock_authentic;
+  } else if (0 == strcmp("turbo", params)) {
+    clock_stop(proc);
+    proc->clock_mode = clock_turbo;
+  } else if ('\0' != params[0]) {
+    const_reply(proc, "error invalid clock");
+    return true;
+  }
+
+  if (clock_authentic == proc->clock_mode) {
+    const_reply(proc, "clock authentic");
+  } else {
+    const_reply(proc, "clock turbo");
+  }
+  return true;
+}
+
+// give a clone, whose pointers are still those of its parent, its own
+// name, channel, engine, film and tapes, without a profile or trace
+// returns false if out of resources, the clone can then be released
+static bool clone_setup(elliott803_t *clone, elliott803_t *proc) {
+
+  clone->name = NULL;
+  clone->commands = NULL;
+  clone->replies = NULL;
+  clone->jit = NULL;
+  clone->profile = NULL;
+  clone->profiling = false;
+  clone->sample = NULL;
+  clone->trace = NULL;
+  clone->film = NULL;
+  for (size_t i = 0; i < reader_units; ++i) {
+    clone->tape[i].data = NULL;
+    atomic_init(&clone->tape_pending[i], NULL);
+  }
+  clone->clones = 0;
+
+  char name[256];
+  snprintf(name, sizeof(name), "%s.%d", proc->name, ++proc->clones);
+  clone->name = strdup(name);
+  clone->commands = channel();
+  clone->replies = channel();
+  if (NULL == clone->name || NULL == clone->commands ||
+      NULL == clone->replies) {
+    return false;
+  }
+
+  if (NULL != proc->jit) {
+    clone->jit = jit_create();
+    if (NULL == clone->jit) {
+      return false;
+    }
+  }
+  if (NULL != proc->film) {
+    clone->film = malloc(film_words * sizeof(int64_t));
+    if (NULL == clone->film) {
+      return false;
+    }
+    memcpy(clone->film, proc->film, film_words * sizeof(int64_t));
+  }
+  for (size_t i = 0; i < reader_units; ++i) {
+    const tape_t *tape = &proc->tape[i];
+    if (NULL == tape->data || tape->position == tape->size) {
+      clone->tape[i].size = 0;
+      clone->tape[i].position = 0;
+      continue;
+    }
+    size_t size = tape->size - tape->position;
+    clone->tape[i].data = malloc(size);
+    if (NULL == clone->tape[i].data) {
+      return false;
+    }
+    memcpy(clone->tape[i].data, &tape->data[tape->position], size);
+    clone->tape[i].size = size;
+    clone->tape[i].position = 0;
+  }
+
+  // the parent's client is waiting for these, not the clone's
+  clone->wait_pending = false;
+  clone->wait_limit = 0;
+  clone->events = 0;
+  clone->clock_running = false;
+  return true;
+}
+
+// copy the whole state for elliott803_clone, the address is only valid
+// in the same process (for internal use)
+//
+// the state is written once to an anonymous file which is mapped
+// privately for each clone, so a clone shares every page, the store
+// and decoded words included, until it or its parent writes to it
+static bool action_fork(elliott803_t *proc, const char *params) {
+
+  uintptr_t address = 0;
+  if (1 != sscanf(params, "%" SCNxPTR, &address)) {
+    const_reply(proc, "error invalid fork");
+    return true;
+  }
+  clone_request_t *request = (clone_request_t *)(address);
+
+  size_t page = sysconf(_SC_PAGESIZE);
+  size_t size = (sizeof(elliott803_t) + page - 1) / page * page;
+  int created = 0;
+  int fd = memfd_create(proc->name, MFD_CLOEXEC);
+  if (-1 != fd && 0 == ftruncate(fd, size) &&
+      (ssize_t)(sizeof(elliott803_t)) ==
+        pwrite(fd, proc, sizeof(elliott803_t), 0)) {
+    for (; created < request->count; ++created) {
+      elliott803_t *clone =
+        mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+      if (MAP_FAILED == clone) {
+        break;
+      }
+      clone->mapped_size = size;
+      if (!clone_setup(clone, proc)) {
+        release(clone);
+        break;
+      }
+      pthread_create(&clone->thread, NULL, main_loop, clone);
+      request->clones[created] = clone;
+    }
+  }
+  if (-1 != fd) {
+    close(fd);
+  }
+
+  request->count = created;
+  sem_post(&request->done);
+  return true;
+}
+
+// resident bytes of part of this process's memory, either private or
+// still shared with a file mapping, e.g. pages a clone has not written
+// returns false if the kernel has no page map
+static bool memory_use(const void *p,
+                       size_t size,
+                       size_t *private_bytes,
+                       size_t *shared_bytes) {
+
+  static const uint64_t present = UINT64_C(1) << 63;
+  static const uint64_t file_or_shared = UINT64_C(1) << 61;
+
+  *private_bytes = 0;
+  *shared_bytes = 0;
+  int fd = open("/proc/self/pagemap", O_RDONLY | O_CLOEXEC);
+  if (-1 == fd) {
+    return false;
+  }
+  size_t page = sysconf(_SC_PAGESIZE);
+  uintptr_t first = (uintptr_t)(p) / page;
+  uintptr_t last = ((uintptr_t)(p) + size - 1) / page;
+  for (uintptr_t i = first; i <= last; ++i) {
+    uint64_t entry = 0;
+    if (sizeof(entry) != pread(fd, &entry, sizeof(entry), i * sizeof(entry))) {
+      close(fd);
+      return false;
+    }
+    if (0 == (entry & present)) {
+      continue;
+    }
+    if (0 == (entry & file_or_shared)) {
+      *private_bytes += page;
+    } else {
+      *shared_bytes += page;
+    }
+  }
+  close(fd);
+  return true;
+}
+
+// save or restore the state of the whole machine
+static bool action_snapshot(elliott803_t *proc, const char *params) {
+
+  snapshot_error_t rc = snapshot_ok;
+  const char *done = NULL;
+  if (0 == strncmp("save ", params, 5)) {
+    rc = snapshot_save(proc, &params[5]);
+    done = "snapshot saved";
+  } else if (0 == strncmp("load ", params, 5)) {
+    rc = snapshot_load(proc, &params[5]);
+    done = "snapshot loaded";
+  } else {
+    const_reply(proc, "error invalid snapshot command");
+    return true;
+  }
+
+  char buffer[256];
+  ssize_t n = 0;
+  if (snapshot_ok == rc) {
+    n = snprintf(buffer, sizeof(buffer), "%s", done);
+  } else {
+    n = snprintf(
+      buffer, sizeof(buffer), "error %s", snapshot_error_string(rc));
+  }
+  n = reply(proc, buffer, n + 1); // include '\0'
+  assert(0 != n);
+
+  return true;
+}
+
+// start, stop, clear or write the execution profile
+static bool action_profile(elliott803_t *proc, const char *params) {
+
+  if (0 == strcmp("on", params)) {
+    if (!profile_start(proc)) {
+      const_reply(proc, "error profile create failed");
+      return true;
+    }
+  } else if (0 == strcmp("off", params)) {
+    profile_stop(proc);
+  } else if (0 == strcmp("clear", params)) {
+    profile_clear(proc);
+  } else if (0 == strncmp("report ", params, 7) ||
+             0 == strncmp("callgrind ", params, 10)) {
+    bool callgrind = 'c' == params[0];
+    const char *filename = strchr(params, ' ') + 1;
+    FILE *f = fopen(filename, "w");
+    if (NULL == f) {
+      char buffer[256];
+      ssize_t n = snprintf(
+        buffer, sizeof(buffer), "error profile %s", strerror(errno));
+      n = reply(proc, buffer, n + 1); // include '\0'
+      assert(0 != n);
+      return true;
+    }
+    bool ok = callgrind ? profile_callgrind(proc, f) : profile_report(proc, f);
+    if (0 != fclose(f) || !ok) {
+      const_reply(proc, "error profile write failed");
+    } else {
+      const_reply(proc, "profile written");
+    }
+    return true;
+  } else if ('\0' != params[0]) {
+    const_reply(proc, "error invalid profile command");
+    return true;
+  }
+
+  if (proc->profiling) {
+    const_reply(proc, "profile on");
+  } else {
+    const_reply(proc, "profile off");
+  }
+  return true;
+}
+
+// start, stop, clear or report the sampled profile
+static bool action_sample(elliott803_t *proc, const char *params) {
+
+  if (0 == strncmp("on", params, 2) &&
+      ('\0' == params[2] || ' ' == params[2])) {
+    int rate = sample_rate_default;
+    if (' ' == params[2]) {
+      params += 3;
+      rate = 0;
+      for (;;) {
+        char c = *params++;
+        if (c >= '0' && c <= '9') {
+          rate = rate * 10 + c - '0';
+          if (rate > sample_rate_max) {
+            const_reply(proc, "error sample rate too large");
+            return true;
+          }
+        } else if ('\0' == c) {
+          break;
+        } else {
+          const_reply(proc, "error invalid sample rate");
+          return true;
+        }
+      }
+      if (rate < 1) {
+        const_reply(proc, "error sample rate too small");
+        return true;
+      }
+    }
+    if (!sample_start(proc, rate)) {
+      const_reply(proc, "error sample start failed");
+      return true;
+    }
+  } else if (0 == strcmp("off", params)) {
+    sample_stop(proc);
+  } else if (0 == strcmp("clear", params)) {
+    sample_clear(proc);
+  } else if (0 == strncmp("report", params, 6) &&
+             ('\0' == params[6] || ' ' == params[6])) {
+    int count = 10;
+    if (' ' == params[6]) {
+      char *end = NULL;
+      long n = strtol(&params[7], &end, 10);
+      if ('\0' != *end || n < 1 || n > 100) {
+        const_reply(proc, "error invalid sample count");
+        return true;
+      }
+      count = n;
+    }
+
+    // the totals, the waits for each device, then the hottest function
+    // codes and half words
+    int64_t totals[sample_states];
+    sample_totals(proc, totals);
+    char buffer[256];
+    ssize_t n = snprintf(buffer,
+                         sizeof(buffer),
+                         "sample running %" PRId64 " busy %" PRId64
+                         " idle %" PRId64 " stopped %" PRId64
+                         " dropped %" PRId64,
+                         totals[sample_state_running],
+                         totals[sample_state_busy],
+                         totals[sample_state_idle],
+                         totals[sample_state_stopped],
+                         totals[sample_state_dropped]);
+    n = reply(proc, buffer, n + 1); // include '\0'
+    assert(0 != n);
+
+    for (busy_t b = busy_reader_1; b <= busy_punch_3; ++b) {
+      int64_t waits = sample_busy_count(proc, b);
+      if (0 != waits) {
+        n = snprintf(buffer,
+                     sizeof(buffer),
+                     "sample busy %s %" PRId64,
+                     busy_device(b),
+                     waits);
+        n = reply(proc, buffer, n + 1); // include '\0'
+        assert(0 != n);
+      }
+    }
+
+    int64_t sampled = totals[sample_state_running] +
+                      totals[sample_state_busy] + totals[sample_state_idle];
+    int keys[100];
+    int64_t counts[100];
+    int found = sample_hottest_ops(proc, keys, counts, count);
+    for (int i = 0; i < found; ++i) {
+      n = snprintf(buffer,
+                   sizeof(buffer),
+                   "sample function %02o %" PRId64 " %.2f%%",
+                   keys[i],
+                   counts[i],
+                   100.0 * counts[i] / sampled);
+      n = reply(proc, buffer, n + 1); // include '\0'
+      assert(0 != n);
+    }
+    found = sample_hottest(proc, keys, counts, count);
+    for (int i = 0; i < found; ++i) {
+      n = snprintf(buffer,
+                   sizeof(buffer),
+                   "sample address %d%s %" PRId64 " %.2f%%",
+                   keys[i] >> 1,
+                   0 == (keys[i] & 1) ? "" : ".5",
+                   counts[i],
+                   100.0 * counts[i] / sampled);
+      n = reply(proc, buffer, n + 1); // include '\0'
+      assert(0 != n);
+    }
+    return true;
+  } else if ('\0' != params[0]) {
+    const_reply(proc, "error invalid sample command");
+    return true;
+  }
+
+  int rate = sample_rate(proc);
+  if (0 == rate) {
+    const_reply(proc, "sample off");
+    return true;
+  }
+  char buffer[256];
+  ssize_t n = snprintf(buffer, sizeof(buffer), "sample on %d", rate);
+  n = reply(proc, buffer, n + 1); // include '\0'
+  assert(0 != n);
+  return true;
+}
+
+// reply with the last count recorded instructions, oldest first
+static void flight_reply(elliott803_t *proc, int count) {
+
+  flight_entry_t history[flight_size];
+  int n = flight_history(proc, history);
+  for (int i = n < count ? 0 : n - count; i < n; ++i) {
+    const flight_entry_t *e = &history[i];
+    int64_t word = e->word;
+    char buffer[256];
+    ssize_t size = snprintf(
+      buffer,
+      sizeof(buffer),
+      "flight %4d.%d  %02o %4d %s %02o %4d  acc %+13" PRId64
+      "  aux %+13" PRId64 "%s",
+      e->program_counter >> 1,
+      5 * (e->program_counter & 1),
+      (int)(op_bits & (word >> first_op_shift)),
+      (int)(address_bits & (word >> first_address_shift)),
+      0 == (word & b_mod_bit) ? ":" : "/",
+      (int)(op_bits & (word >> second_op_shift)),
+      (int)(address_bits & (word >> second_address_shift)),
+      e->accumulator >> word_shift,
+      e->auxiliary_register >> word_shift,
+      e->overflow ? "  overflow" : "");
+    size = reply(proc, buffer, size + 1); // include '\0'
+    assert(0 != size);
+  }
+}
+
+// display the last instructions executed
+static bool action_flight(elliott803_t *proc, const char *params) {
+
+  int count = flight_size;
+  if ('\0' != params[0]) {
+    count = 0;
+    for (;;) {
+      char c = *params++;
+      if (c >= '0' && c <= '9') {
+        count = count * 10 + c - '0';
+        if (count > flight_size) {
+          const_reply(proc, "error flight count too large");
+          return true;
+        }
+      } else if ('\0' == c) {
+        break;
+      } else {
+        const_reply(proc, "error invalid flight count");
+        return true;
+      }
+    }
+  }
+  flight_reply(proc, count);
+  const_reply(proc, "flight end");
+  return true;
+}
+
+// start or stop writing an execution trace
+static bool action_trace(elliott803_t *proc, const char *params) {
+
+  char buffer[256];
+  ssize_t n = 0;
+  if (0 == strncmp("on ", params, 3)) {
+    if (NULL != proc->trace) {
+      const_reply(proc, "error trace already on");
+      return true;
+    }
+    if (!trace_start(proc, &params[3])) {
+      n = snprintf(buffer, sizeof(buffer), "error trace %s", strerror(errno));
+      n = reply(proc, buffer, n + 1); // include '\0'
+      assert(0 != n);
+      return true;
+    }
+  } else if (0 == strcmp("off", params)) {
+    if (!trace_stop(proc)) {
+      const_reply(proc, "error trace write failed");
+      return true;
+    }
+  } else if ('\0' != params[0]) {
+    const_reply(proc, "error invalid trace command");
+    return true;
+  }
+
+  if (NULL == proc->trace) {
+    const_reply(proc, "trace off");
+    return true;
+  }
+  n = snprintf(buffer,
+               sizeof(buffer),
+               "trace on %s %" PRId64 " bytes",
+               trace_filename(proc),
+               trace_bytes(proc));
+  n = reply(proc, buffer, n + 1); // include '\0'
+  assert(0 != n);
+  return true;
+}
+
+// display execution statistics
+static bool action_statistics(elliott803_t *proc, const char *params) {
+
+  char buffer[256];
+  ssize_t n = snprintf(buffer,
+                       sizeof(buffer),
+                       "stats instructions %" PRId64,
+                       proc->instructions);
+  n = reply(proc, buffer, n + 1); // include '\0'
+  assert(0 != n);
+
+  n = snprintf(buffer,
+               sizeof(buffer),
+               "stats invalidations %" PRId64,
+               proc->decode_invalidations);
+  n = reply(proc, buffer, n + 1); // include '\0'
+  assert(0 != n);
+
+  n = snprintf(buffer,
+               sizeof(buffer),
+               "stats idle %" PRId64 " ms",
+               idle_time(proc) / 1000000);
+  n = reply(proc, buffer, n + 1); // include '\0'
+  assert(0 != n);
+
+  // speed relative to a real 803 in hundredths
+  int64_t wall = clock_wall_time(proc);
+  int64_t speed = 0 == wall ? 0 : proc->emulated_time * 100 / wall;
+  n = snprintf(buffer,
+               sizeof(buffer),
+               "stats clock emulated %" PRId64 " ms real %" PRId64
+               " ms speed %" PRId64 ".%02" PRId64,
+               proc->emulated_time / 1000,
+               wall / 1000,
+               speed / 100,
+               speed % 100);
+  n = reply(proc, buffer, n + 1); // include '\0'
+  assert(0 != n);
+
+  n = snprintf(buffer,
+               sizeof(buffer),
+               "stats film %" PRId64 " blocks %" PRId64 " word times",
+               proc->film_transfers,
+               proc->transfer_time);
+  n = reply(proc, buffer, n + 1); // include '\0'
+  assert(0 != n);
+
+  // the film and tapes are private copies
+  size_t private_bytes = 0;
+  size_t shared_bytes = 0;
+  if (memory_use(proc, sizeof(elliott803_t), &private_bytes, &shared_bytes)) {
+    if (NULL != proc->film) {
+      private_bytes += film_words * sizeof(int64_t);
+    }
+    for (size_t i = 0; i < reader_units; ++i) {
+      private_bytes += proc->tape[i].size;
+    }
+    n = snprintf(buffer,
+                 sizeof(buffer),
+                 "stats memory %zu KB private %zu KB shared",
+                 private_bytes / 1024,
+                 shared_bytes / 1024);
+    n = reply(proc, buffer, n + 1); // include '\0'
+    assert(0 != n);
+  }
+
+  if (NULL != proc->jit) {
+    n = snprintf(buffer,
+                 sizeof(buffer),
+                 "stats blocks %" PRId64,
+                 jit_blocks(proc->jit));
+    n = reply(proc, buffer, n + 1); // include '\0'
+    assert(0 != n);
+
+    n = snprintf(buffer,
+                 sizeof(buffer),
+                 "stats flushes %" PRId64,
+                 jit_flushes(proc->jit));
+    n = reply(proc, buffer, n + 1); // include '\0'
+    assert(0 != n);
+  }
+
+  return true;
+}
+
+// select and/or display the execution engine
+static bool action_engine(elliott803_t *proc, const char *params) {
+
+  if (0 == strcmp("interpreter", params)) {
+    jit_destroy(proc->jit);
+    proc->jit = NULL;
+  } else if (0 == strcmp("jit", params)) {
+    if (!jit_available()) {
+      const_reply(proc, "error jit not available");
+      return true;
+    }
+    if (NULL == proc->jit) {
+      proc->jit = jit_create();
+      if (NULL == proc->jit) {
+        const_reply(proc, "error jit create failed");
+        return true;
+      }
+    }
+  } else if ('\0' != params[0]) {
+    const_reply(proc, "error invalid engine");
+    return true;
+  }
+
+  if (NULL == proc->jit) {
+    const_reply(proc, "engine interpreter");
+  } else {
+    const_reply(proc, "engine jit");
+  }
+  return true;
+}
+
 static bool action_help(elliott803_t *proc, const char *params) {
 
   // clang-format off
@@ -637,6 +1626,25 @@ static bool action_help(elliott803_t *proc, const char *params) {
     "?? wg n1 [N][/]          clear/or wg address 1 + B bits (decimal)", //
     "?? wg n2 [N]             clear/or wg address 2 bits (decimal)",     //
     "?? check                 check for stop or word generator polling", //
+    "?? wait [N]              reply when stopped, idle or reader busy",  //
+    "??                       or after N instructions",                  //
+    "?? quantum [N]           instructions executed between polls",      //
+    "?? stats                 display execution statistics",             //
+    "?? engine [NAME]         select engine: interpreter or jit",        //
+    "?? clock [MODE]          select speed: authentic or turbo",         //
+    "?? events [NAME...]      push: stop idle starved punch overflow",   //
+    "??                       limit, or all or none",                    //
+    "?? limit [N|off]         stop after N more instructions",           //
+    "?? output [MODE]         send punched characters: batch or char",   //
+    "?? snapshot save|load F  save or restore the whole machine state",  //
+    "?? profile [MODE]        count instructions: on, off or clear",     //
+    "?? profile report F      write the counts to a file",               //
+    "?? profile callgrind F   write the counts in callgrind format",     //
+    "?? sample [on [HZ]|off]  sample the program counter HZ times/s",    //
+    "?? sample clear          discard the samples",                      //
+    "?? sample report [N]     display the N hottest addresses [10]",     //
+    "?? flight [N]            display the last N instructions executed", //
+    "?? trace [on F|off]      record each instruction in a binary file", //
     "?? ",                                                               //
   };
   // clang-format on
@@ -662,8 +1670,23 @@ static const cmd_t command_list[] = {
   {"cont", action_cont},             //
   {"stop", action_stop},             //
   {"reader", action_reader},         //
+  {"tape", action_tape},             //
+  {"fork", action_fork},             //
   {"wg", action_word_generator},     //
   {"check", action_check},           //
+  {"wait", action_wait},             //
+  {"quantum", action_quantum},       //
+  {"stats", action_statistics},      //
+  {"engine", action_engine},         //
+  {"clock", action_clock},           //
+  {"events", action_events},         //
+  {"output", action_output},         //
+  {"snapshot", action_snapshot},     //
+  {"profile", action_profile},       //
+  {"sample", action_sample},         //
+  {"flight", action_flight},         //
+  {"trace", action_trace},           //
+  {"limit", action_limit},           //
   {"?", action_help},                //
   {"terminate", action_terminate},   // last item (for internal use)
 };
@@ -674,7 +1697,9 @@ static void *main_loop(void *arg) {
 
   processor_t *proc = (processor_t *)arg;
 
-  system_reset(proc);
+  // only report a busy reader when it first becomes busy or after an
+  // idle timeout, as each report causes the client to send more data
+  bool report_busy = false;
 
   for (bool run = true; run;) {
     struct timeval tzero = {
@@ -682,27 +1707,115 @@ static void *main_loop(void *arg) {
       .tv_usec = 0,
     };
 
-    // if running poll for a command
-    if (exec_mode_run == proc->mode && busy_none == proc->io_busy) {
-      cpu803_execute(proc);
+    // if running execute a quantum of instructions, ending early on
+    // stop, on busy I/O, on an idle loop or if the client has sent a
+    // command
+    bool running = exec_mode_run == proc->mode &&
+                   busy_none == proc->io_busy && !proc->idle;
+    bool throttled = false;
+    if (running) {
+      clock_start(proc);
+      int64_t limit = proc->instructions + proc->quantum;
+      if (0 != proc->instruction_limit && proc->instruction_limit < limit) {
+        limit = proc->instruction_limit;
+      }
+      int64_t time_limit = INT64_MAX;
+      if (clock_authentic == proc->clock_mode) {
+        time_limit = clock_limit(proc);
+      }
+      while (proc->instructions < limit && proc->emulated_time < time_limit) {
+        if (NULL != proc->trace) {
+          trace_execute(proc);
+        } else if (proc->profiling) {
+          profile_execute(proc);
+        } else if (NULL != proc->jit) {
+          jit_execute(proc);
+        } else {
+          cpu803_execute(proc);
+        }
+        if (exec_mode_run != proc->mode || busy_none != proc->io_busy ||
+            !ring_empty(proc->commands)) {
+          break;
+        }
+        if (proc->overflow && !proc->event_overflow &&
+            0 != (proc->events & event_overflow)) {
+          break; // report at once, before the program tests it
+        }
+        if (idle_detect(proc)) {
+          proc->idle = true;
+          clock_gettime(CLOCK_MONOTONIC, &proc->idle_start);
+          break;
+        }
+      }
+      report_busy = busy_none != proc->io_busy;
+
+      // a block of jitted code may pass the limit, so stop at the first
+      // chance afterwards
+      if (0 != proc->instruction_limit &&
+          proc->instructions >= proc->instruction_limit) {
+        proc->instruction_limit = 0;
+        proc->mode = exec_mode_stop;
+        push_event(proc, event_limit, "event limit");
+      }
+
+      // show how a fault was reached
+      if (proc->fault) {
+        proc->fault = false;
+        const_reply(proc, "flight fault");
+        flight_reply(proc, flight_size);
+        const_reply(proc, "flight end");
+      }
+
+      // wait for real time to catch up, but still respond to commands
+      int64_t ahead = 0;
+      if (clock_authentic == proc->clock_mode) {
+        ahead = clock_ahead(proc);
+      }
+      if (ahead > 0) {
+        throttled = true;
+        tzero.tv_sec = ahead / 1000000;
+        tzero.tv_usec = ahead % 1000000;
+      }
     } else {
+      clock_stop(proc);
       tzero.tv_sec = 1;
     }
 
+    // a quantum can fill a punch buffer so send everything available,
+    // as "pN " followed by the characters
     for (size_t i = 0; i < punch_units; ++i) {
-      uint8_t b = 0;
-      if (buffer_get(&proc->punch[i], &b)) {
-        char buffer[256];
-        ssize_t n = snprintf(buffer, sizeof(buffer), "p%zu %02x", i + 1, b);
-        n = reply(proc, buffer, n + 1); // include '\0'
-        assert(0 != n);
+      char frame[3 + buffer_capacity];
+      size_t n = snprintf(frame, sizeof(frame), "p%zu ", i + 1);
+      size_t end = n + proc->punch_frame;
+      while (buffer_get(&proc->punch[i], (uint8_t *)(&frame[n]))) {
+        if (++n == end) {
+          ssize_t rc = reply(proc, frame, n);
+          assert(0 != rc);
+          n = 3;
+        }
+      }
+      if (n > 3) {
+        ssize_t rc = reply(proc, frame, n);
+        assert(0 != rc);
       }
     }
 
+    // before a full punch is cleared
+    push_events(proc, running);
+
+    // add up the samples the timer took meanwhile
+    if (NULL != proc->sample) {
+      sample_collect(proc);
+    }
+
     switch (proc->io_busy) {
     case busy_reader_1:
     case busy_reader_2:
     case busy_reader_3: {
+      if (!report_busy) {
+        break;
+      }
+      report_busy = false;
       char buffer[256];
       ssize_t n = snprintf(
         buffer, sizeof(buffer), "r%u busy", proc->io_busy - busy_reader_1 + 1);
@@ -710,31 +1823,54 @@ static void *main_loop(void *arg) {
       assert(0 != n);
       break;
     }
+    case busy_punch_1:
+    case busy_punch_2:
+    case busy_punch_3:
+      // all punch buffers were just emptied
+      proc->io_busy = busy_none;
+      break;
     default:
       break;
     }
 
+    // answer a client that is waiting for the machine to settle
+    const char *settled = proc->wait_pending ? settled_state(proc) : NULL;
+    if (NULL != settled) {
+      proc->wait_pending = false;
+      proc->wait_limit = 0;
+      ssize_t n = reply(proc, settled, strlen(settled) + 1); // include '\0'
+      assert(0 != n);
+    }
+
+    // no need to poll the channel if nothing has been sent
+    if (running && !throttled && ring_empty(proc->commands)) {
+      continue;
+    }
+
     fd_set in;
     FD_ZERO(&in);
-    FD_SET(proc->processor_socket, &in);
-    if (select(FD_SETSIZE, &in, NULL, NULL, &tzero) < 0) {
+    FD_SET(proc->commands->fd, &in);
+    int rc = select(FD_SETSIZE, &in, NULL, NULL, &tzero);
+    if (rc < 0) {
       continue;
     }
-    if (!FD_ISSET(proc->processor_socket, &in)) {
+    if (0 == rc) {
+      // nothing received while idle, so repeat any busy report
+      report_busy = !running;
       continue;
     }
 
     // receive a command
     char buffer[message_buffer_size];
-    ssize_t n = recv(proc->processor_socket,
-                     buffer,
-                     sizeof(buffer) - 1,
-                     MSG_WAITALL | MSG_DONTWAIT);
+    ssize_t n = ring_get(proc->commands, buffer, sizeof(buffer) - 1);
     if (n < 0) {
       continue;
     }
     buffer[n] = '\0';
 
+    // any command may have provided what the idle loop is waiting for
+    idle_end(proc);
+
     // locate first space or the '\0'
     char *p = strchrnul(buffer, ' ');
     size_t word_length = p - buffer;
@@ -4,11 +4,14 @@
 #define PROCESSOR_H 1
 
 #include <pthread.h>
+#include <stdatomic.h>
 #include <stdbool.h>
 #include <stdint.h>
+#include <time.h>
 
 #include "buffer.h"
 #include "constants.h"
+#include "ring.h"
 
 // execution modes
 typedef enum {
@@ -27,24 +30,138 @@ typedef enum {
   busy_punch_3,  // teletype
 } busy_t;
 
+// emulated clock pacing
+typedef enum {
+  clock_turbo,     // as fast as possible
+  clock_authentic, // the speed of a real 803
+} clock_mode_t;
+
+// asynchronous events pushed to a client that subscribed to them
+typedef enum {
+  event_stop = 1 << 0,     // the machine stopped
+  event_idle = 1 << 1,     // waiting in a loop, e.g. polling the wg
+  event_starved = 1 << 2,  // a reader has no more tape
+  event_punch = 1 << 3,    // a punch buffer is full
+  event_overflow = 1 << 4, // the overflow indicator was set
+  event_limit = 1 << 5,    // the instruction limit was reached
+} event_t;
+
+// a whole tape handed to a reader, read without involving the client
+typedef struct {
+  uint8_t *data;   // NULL if none, owned by the processor
+  size_t size;     // bytes of data
+  size_t position; // next byte to read
+} tape_t;
+
 // size for various internal buffers
 static const size_t message_buffer_size = 4096;
 
+// number of instructions executed between polls of the control channel
+enum {
+  quantum_default = 1000,
+  quantum_maximum = 1000000,
+};
+
+// predecoded form of a core store word
+// Note op2/address2 are not valid for a B-modified word as they depend
+//      on the value of the modifier at the time of execution
+typedef struct {
+  int64_t word;      // raw store value
+  bool valid;        // cleared when the word is written
+  bool stop;         // word matches the stop pattern 73 N / 40 0
+  bool b_modified;   // second instruction is B-modified
+  uint8_t op1;       // first instruction function
+  uint8_t op2;       // second instruction function
+  uint16_t address1; // first instruction address
+  uint16_t address2; // second instruction address
+  uint32_t time1;    // first instruction emulated time
+  uint32_t time2;    // second instruction emulated time
+} decoded_t;
+
+// snapshot of the registers for detecting an idle loop
+typedef struct {
+  int period;                 // steps between snapshots
+  int steps;                  // steps since the snapshot
+  int program_counter;        //
+  int64_t accumulator;        //
+  int64_t auxiliary_register; //
+  bool overflow;              //
+  int b_addr;                 //
+  int64_t b_data;             //
+  int64_t store_changes;      // count when snapshot was taken
+  int64_t transfers;          // count when snapshot was taken
+} idle_state_t;
+
+// an instruction as it was about to execute, kept by the flight recorder
+typedef struct {
+  int64_t word;               // containing the instruction
+  int64_t accumulator;        // before it executed
+  int64_t auxiliary_register; //
+  int32_t program_counter;    // LSB is half word indicator
+  bool overflow;              //
+} flight_entry_t;
+
+enum {
+  flight_size = 128, // instructions recorded, a power of two
+};
+
 // store values are in int64_t
 typedef struct elliott803_struct {
 
-  char *name; // name of this processor instance
+  char *name;         // name of this processor instance
+  size_t mapped_size; // bytes mapped if a clone, 0 if allocated
+  int clones;         // made from this instance, for naming them
 
   int64_t core_store[memory_size];
 
+  decoded_t decoded[memory_size]; // predecoded instructions
+  int64_t decode_invalidations;   // writes to previously decoded words
+  int64_t instructions;           // number of instructions executed
+  int64_t store_changes;          // writes that changed a word
+  int64_t transfers;              // characters read or punched
+
+  int64_t emulated_time;        // microseconds a real 803 would take
+  clock_mode_t clock_mode;      // pacing of execution
+  bool clock_running;           // a period of execution is being timed
+  int64_t clock_start_wall;     // real time at the start of the period
+  int64_t clock_start_emulated; // emulated time at the start of the period
+  int64_t clock_wall;           // real microseconds of earlier periods
+
+  struct jit_struct *jit; // native code translation, NULL if interpreting
+  bool jit_abort;         // translated code must return to the interpreter
+
+  struct profile_struct *profile; // execution counts, NULL if never taken
+  bool profiling;                 // counting each instruction executed
+  struct sample_struct *sample;   // sampled by a timer, NULL if never
+  struct trace_struct *trace;     // recording each step, NULL if not
+
   busy_t io_busy;
   bool overflow;
   int64_t accumulator;
   int64_t auxiliary_register;
 
-  int client_socket;    // client side
-  int processor_socket; // processor side
-  pthread_t thread;     // execution state
+  ring_t *commands; // client to processor
+  ring_t *replies;  // processor to client
+  pthread_t thread; // execution state
+
+  int quantum;        // instructions to execute between polls
+  size_t punch_frame; // most characters sent in one punch message
+
+  bool idle;                  // waiting in a loop for a command
+  idle_state_t idle_state;    // for detecting the idle loop
+  struct timespec idle_start; // when the current idle period began
+  int64_t idle_time;          // total nanoseconds idle
+
+  bool wait_pending;  // reply to "wait" when the machine next settles
+  int64_t wait_limit; // instruction count that ends the wait, 0 for none
+
+  unsigned int events;         // subscribed event_t bits
+  execution_mode_t event_mode; // state when events were last pushed
+  bool event_idle;             //
+  busy_t event_busy;           //
+  bool event_overflow;         //
+  int64_t event_transfers;     //
+  int64_t instruction_limit;   // stop when instructions reach this, or 0
 
   int64_t word_generator; // cached value received via control channel
   int wg_polls;           // number of time wg polled since last "check"
@@ -53,15 +170,36 @@ typedef struct elliott803_struct {
   int program_counter;   // LSB is half word indicator
 
   // Note b_addr will always have the half bit set when valid
-  int b_addr;     // address of data in B
-  int64_t b_data; // B Register data value
+  int b_addr;          // address of data in B
+  int64_t b_data;      // B Register data value
+  decoded_t b_decoded; // decoded form of b_data
 
-  // two paper tape readers and one teleprinter
+  // two paper tape readers and one teleprinter, each reads its buffer
+  // before any tape loaded into it
   buffer_t reader[reader_units];
+  tape_t tape[reader_units];
+
+  // a tape from elliott803_load_tape until the "tape" command sent
+  // after it takes it, NULL if none; a later load replaces one not yet
+  // taken
+  _Atomic(tape_t *) tape_pending[reader_units];
 
   // two paper tape punches and one teleprinter
   buffer_t punch[punch_units];
 
+  // film handler backing store
+  int64_t *film;          // allocated when first used
+  int film_block;         // block at the heads
+  int film_function;      // selected by 76 for the next 77
+  int64_t film_transfers; // blocks read or written
+  int64_t transfer_time;  // word times spent in block transfers
+
+  // the last instructions executed, the oldest overwritten
+  flight_entry_t flight[flight_size];
+  uint32_t flight_position; // instructions ever recorded
+  bool fault;               // stopped by an unimplemented function or
+                            // a failure, reported with the recording
+
 } processor_t;
 
 #endif
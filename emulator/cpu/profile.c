@@ -0,0 +1,288 @@
+// profile.c
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "clock.h"
+#include "constants.h"
+#include "core.h"
+#include "cpu803.h"
+#include "processor.h"
+#include "profile.h"
+
+// kept together so counting touches one cache line
+typedef struct {
+  int64_t count; // instructions executed
+  int64_t time;  // emulated us they took
+} cost_t;
+
+struct profile_struct {
+  cost_t half[memory_size][2]; // at each address and half
+  cost_t op[64];               // of each function code
+  int64_t calls[memory_size];  // "73 N : 40 N+1" to each address
+};
+
+bool profile_start(processor_t *proc) {
+  if (NULL == proc->profile) {
+    proc->profile = calloc(1, sizeof(profile_t));
+    if (NULL == proc->profile) {
+      return false;
+    }
+  }
+  proc->profiling = true;
+  return true;
+}
+
+void profile_stop(processor_t *proc) { proc->profiling = false; }
+
+void profile_clear(processor_t *proc) {
+  if (NULL != proc->profile) {
+    memset(proc->profile, 0, sizeof(profile_t));
+  }
+}
+
+void profile_destroy(profile_t *profile) { free(profile); }
+
+void profile_execute(processor_t *proc) {
+
+  profile_t *p = proc->profile;
+  int pc = proc->program_counter;
+  int address = (pc >> 1) & address_bits; // pc is not wrapped at the top
+  int64_t instructions = proc->instructions;
+  int64_t time = proc->emulated_time;
+
+  // the word may be overwritten as it executes, and a second half
+  // reached by a jump may have been saved in the B register
+  const decoded_t *d = cpu803_fetch(proc, address);
+  if (pc == proc->b_addr) {
+    d = &proc->b_decoded;
+  }
+  int op1 = d->op1;
+  int op2 = d->op2;
+  if (d->b_modified) {
+    // the modifier as it is before the word executes
+    op2 = ((d->word + core_read(proc, d->address1)) >> second_op_shift) &
+          op_bits;
+  }
+  int64_t time1 = d->time1;
+  bool call = 073 == op1 && 040 == op2 && d->address2 == d->address1 + 1;
+  int entry = d->address2;
+
+  cpu803_execute(proc);
+
+  int64_t n = proc->instructions - instructions;
+  int64_t t = proc->emulated_time - time;
+  if (0 == (pc & 1)) {
+    // the time of the first includes any character transfer if the
+    // second was not reached
+    int64_t t1 = n > 1 ? time1 : t;
+    ++p->half[address][0].count;
+    p->half[address][0].time += t1;
+    ++p->op[op1].count;
+    p->op[op1].time += t1;
+    t -= t1;
+    if (n > 1 && call) {
+      ++p->calls[entry];
+    }
+  }
+  if (n > 1 || 0 != (pc & 1)) {
+    ++p->half[address][1].count;
+    p->half[address][1].time += t;
+    ++p->op[op2].count;
+    p->op[op2].time += t;
+  }
+}
+
+// the function containing each address: the nearest entry at or below
+// it, or 0 if there is none
+static void find_functions(const profile_t *p, int function[memory_size]) {
+  int entry = 0;
+  for (int a = 0; a < memory_size; ++a) {
+    if (0 != p->calls[a]) {
+      entry = a;
+    }
+    function[a] = entry;
+  }
+}
+
+typedef struct {
+  int key; // address * 2 + half, function code or entry
+  int64_t count;
+  int64_t time;
+} line_t;
+
+static int by_time(const void *a, const void *b) {
+  const line_t *x = a;
+  const line_t *y = b;
+  if (x->time != y->time) {
+    return x->time > y->time ? -1 : 1;
+  }
+  if (x->count != y->count) {
+    return x->count > y->count ? -1 : 1;
+  }
+  return x->key - y->key;
+}
+
+static double percent(int64_t part, int64_t total) {
+  return 0 == total ? 0.0 : 100.0 * part / total;
+}
+
+bool profile_report(processor_t *proc, FILE *f) {
+
+  static profile_t empty;
+  const profile_t *p = NULL == proc->profile ? &empty : proc->profile;
+
+  // each address and half, function code and function with a count
+  line_t *lines = malloc((2 * memory_size + 64 + memory_size) * sizeof(line_t));
+  int *function = malloc(memory_size * sizeof(int));
+  if (NULL == lines || NULL == function) {
+    free(lines);
+    free(function);
+    return false;
+  }
+  find_functions(p, function);
+
+  int64_t count = 0;
+  int64_t time = 0;
+  int n = 0;
+  for (int a = 0; a < memory_size; ++a) {
+    for (int h = 0; h < 2; ++h) {
+      if (0 != p->half[a][h].count) {
+        lines[n++] = (line_t){a * 2 + h, p->half[a][h].count, p->half[a][h].time};
+        count += p->half[a][h].count;
+        time += p->half[a][h].time;
+      }
+    }
+  }
+  qsort(lines, n, sizeof(line_t), by_time);
+
+  fprintf(f,
+          "profile of %s: %" PRId64 " instructions, %.1f word times\n\n",
+          proc->name,
+          count,
+          (double)(time) / word_time);
+  fprintf(f, "address    op  instructions       %%   word times       %%\n");
+  for (int i = 0; i < n; ++i) {
+    const line_t *l = &lines[i];
+    const decoded_t *d = cpu803_fetch(proc, l->key >> 1);
+    fprintf(f,
+            "%4d%-5s  %02o  %12" PRId64 "  %6.2f  %11.1f  %6.2f\n",
+            l->key >> 1,
+            0 == (l->key & 1) ? "" : ".5",
+            0 == (l->key & 1) ? d->op1 : d->op2,
+            l->count,
+            percent(l->count, count),
+            (double)(l->time) / word_time,
+            percent(l->time, time));
+  }
+
+  n = 0;
+  for (int op = 0; op < 64; ++op) {
+    if (0 != p->op[op].count) {
+      lines[n++] = (line_t){op, p->op[op].count, p->op[op].time};
+    }
+  }
+  qsort(lines, n, sizeof(line_t), by_time);
+  fprintf(f, "\nfunction   instructions       %%   word times       %%\n");
+  for (int i = 0; i < n; ++i) {
+    fprintf(f,
+            "%02o       %14" PRId64 "  %6.2f  %11.1f  %6.2f\n",
+            lines[i].key,
+            lines[i].count,
+            percent(lines[i].count, count),
+            (double)(lines[i].time) / word_time,
+            percent(lines[i].time, time));
+  }
+
+  // totals of each subroutine, from its entry to the next
+  n = 0;
+  for (int a = 0; a < memory_size; ++a) {
+    int64_t c = p->half[a][0].count + p->half[a][1].count;
+    int64_t t = p->half[a][0].time + p->half[a][1].time;
+    if (0 == c) {
+      continue;
+    }
+    if (0 == n || lines[n - 1].key != function[a]) {
+      lines[n++] = (line_t){function[a], 0, 0};
+    }
+    lines[n - 1].count += c;
+    lines[n - 1].time += t;
+  }
+  qsort(lines, n, sizeof(line_t), by_time);
+  fprintf(f,
+          "\nentry      calls  instructions       %%   word times       %%\n");
+  for (int i = 0; i < n; ++i) {
+    fprintf(f,
+            "%4d  %10" PRId64 "  %12" PRId64 "  %6.2f  %11.1f  %6.2f\n",
+            lines[i].key,
+            p->calls[lines[i].key],
+            lines[i].count,
+            percent(lines[i].count, count),
+            (double)(lines[i].time) / word_time,
+            percent(lines[i].time, time));
+  }
+
+  free(function);
+  free(lines);
+  fflush(f);
+  return !ferror(f);
+}
+
+bool profile_callgrind(processor_t *proc, FILE *f) {
+
+  static profile_t empty;
+  const profile_t *p = NULL == proc->profile ? &empty : proc->profile;
+
+  int *function = malloc(memory_size * sizeof(int));
+  if (NULL == function) {
+    return false;
+  }
+  find_functions(p, function);
+
+  int64_t count = 0;
+  int64_t time = 0;
+  for (int a = 0; a < memory_size; ++a) {
+    count += p->half[a][0].count + p->half[a][1].count;
+    time += p->half[a][0].time + p->half[a][1].time;
+  }
+
+  // positions are the half word (address * 2 + half) and the address
+  fprintf(f, "# callgrind format\n");
+  fprintf(f, "version: 1\n");
+  fprintf(f, "creator: emu803\n");
+  fprintf(f, "cmd: %s\n", proc->name);
+  fprintf(f, "positions: instr line\n");
+  fprintf(f, "event: Ir : Instructions\n");
+  fprintf(f, "event: Us : Emulated microseconds\n");
+  fprintf(f, "events: Ir Us\n");
+  fprintf(f, "summary: %" PRId64 " %" PRId64 "\n\n", count, time);
+  fprintf(f, "ob=%s\n", proc->name);
+  fprintf(f, "fl=store\n");
+
+  int current = -1;
+  for (int a = 0; a < memory_size; ++a) {
+    for (int h = 0; h < 2; ++h) {
+      if (0 == p->half[a][h].count) {
+        continue;
+      }
+      if (function[a] != current) {
+        current = function[a];
+        fprintf(f, "fn=%04d\n", current);
+      }
+      fprintf(f,
+              "%d %d %" PRId64 " %" PRId64 "\n",
+              a * 2 + h,
+              a,
+              p->half[a][h].count,
+              p->half[a][h].time);
+    }
+  }
+
+  free(function);
+  fflush(f);
+  return !ferror(f);
+}
@@ -0,0 +1,39 @@
+// profile.h
+
+#if !defined(PROFILE_H)
+#define PROFILE_H 1
+
+#include <stdbool.h>
+#include <stdio.h>
+
+#include "processor.h"
+
+// counts of the instructions executed at each address and half word
+// and of each function code, with the emulated time they took
+//
+// while a profile is being taken the main loop calls profile_execute
+// instead of the interpreter or the translated code, so there is no
+// cost when it is not; a word "73 N : 40 N+1", the usual subroutine
+// call, marks N+1 as the entry of a function for the callgrind output
+
+typedef struct profile_struct profile_t;
+
+// start or stop counting, the counts are kept until cleared
+bool profile_start(processor_t *proc);
+void profile_stop(processor_t *proc);
+void profile_clear(processor_t *proc);
+
+// discard the counts
+void profile_destroy(profile_t *profile);
+
+// execute a word counting its instructions
+void profile_execute(processor_t *proc);
+
+// write the counts in order of time, false on a write error
+bool profile_report(processor_t *proc, FILE *f);
+
+// write the counts in callgrind format for kcachegrind, false on a
+// write error
+bool profile_callgrind(processor_t *proc, FILE *f);
+
+#endif
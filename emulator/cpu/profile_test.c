@@ -0,0 +1,148 @@
+// profile_test.c
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "constants.h"
+#include "core.h"
+#include "cpu803.h"
+#include "processor.h"
+#include "profile.h"
+
+// run from address until the processor stops, profiling each word
+static void run(processor_t *proc, int address, int limit) {
+  proc->program_counter = address << 1;
+  proc->mode = exec_mode_run;
+  for (int i = 0; i < limit; ++i) {
+    profile_execute(proc);
+    if (exec_mode_stop == proc->mode) {
+      return;
+    }
+  }
+  printf("program at: %d did not stop\n", address);
+  exit(1);
+}
+
+static void check(const char *title, int64_t actual, int64_t expected) {
+  if (actual != expected) {
+    printf("%-24s: actual:   %" PRId64 "\n"
+           "%-24s  expected: %" PRId64 "\n",
+           title,
+           actual,
+           "",
+           expected);
+    exit(1);
+  }
+}
+
+// totals of the callgrind cost lines, and the cost of one half word
+typedef struct {
+  int64_t count;
+  int64_t time;
+  int64_t at_count;
+  bool entry; // "fn=" line for the subroutine
+} totals_t;
+
+static totals_t callgrind(processor_t *proc, int half_word, int entry) {
+  FILE *f = tmpfile();
+  if (NULL == f || !profile_callgrind(proc, f)) {
+    printf("callgrind write failed\n");
+    exit(1);
+  }
+  rewind(f);
+
+  char fn[32];
+  snprintf(fn, sizeof(fn), "fn=%04d\n", entry);
+  totals_t t = {0};
+  char line[256];
+  while (NULL != fgets(line, sizeof(line), f)) {
+    int instr = 0;
+    int address = 0;
+    int64_t count = 0;
+    int64_t time = 0;
+    if (4 == sscanf(line,
+                    "%d %d %" SCNd64 " %" SCNd64,
+                    &instr,
+                    &address,
+                    &count,
+                    &time)) {
+      check("line of instr", address, instr >> 1);
+      t.count += count;
+      t.time += time;
+      if (instr == half_word) {
+        t.at_count = count;
+      }
+    } else if (0 == strcmp(fn, line)) {
+      t.entry = true;
+    }
+  }
+  fclose(f);
+  return t;
+}
+
+int main(int argc, char *argv[]) {
+
+  processor_t *proc = calloc(1, sizeof(processor_t));
+  if (NULL == proc) {
+    printf("calloc failed\n");
+    return 1;
+  }
+
+  // call a subroutine three times, each time loading and returning
+  core_write(proc, 4096, ELLIOTT(073, 4100, 0, 040, 4101));
+  core_write(proc, 4097, ELLIOTT(073, 4100, 0, 040, 4101));
+  core_write(proc, 4098, ELLIOTT(073, 4100, 0, 040, 4101));
+  core_write(proc, 4099, ELLIOTT(040, 4099, 0, 000, 0));
+  core_write(proc, 4101, ELLIOTT(030, 4200, 0, 000, 0));
+  core_write(proc, 4102, ELLIOTT(000, 4100, 1, 040, 1));
+
+  if (!profile_start(proc)) {
+    printf("profile start failed\n");
+    return 1;
+  }
+  run(proc, 4096, 100);
+
+  // every instruction and microsecond is attributed
+  totals_t t = callgrind(proc, 4101 * 2, 4101);
+  check("instructions", t.count, proc->instructions);
+  check("time", t.time, proc->emulated_time);
+  check("subroutine load", t.at_count, 3);
+  check("subroutine entry", t.entry, true);
+
+  // a second half reached by a jump is counted alone
+  t = callgrind(proc, 4102 * 2 + 1, 4101);
+  check("return jump", t.at_count, 3);
+
+  // the report is written
+  FILE *f = tmpfile();
+  check("report", NULL != f && profile_report(proc, f), true);
+  fclose(f);
+
+  // stopped, nothing more is counted and clearing removes the counts
+  profile_stop(proc);
+  check("stopped", proc->profiling, false);
+  profile_clear(proc);
+  t = callgrind(proc, 4101 * 2, 4101);
+  check("cleared", t.count, 0);
+  check("cleared entry", t.entry, false);
+
+  // running off the top of store is counted at address 0
+  check("restart", profile_start(proc), true);
+  core_write(proc, 8191, ELLIOTT(022, 4200, 0, 022, 4200));
+  proc->program_counter = 8191 << 1;
+  proc->mode = exec_mode_run;
+  int64_t instructions = proc->instructions;
+  profile_execute(proc);
+  profile_execute(proc);
+  t = callgrind(proc, 0, 0);
+  check("wrapped", t.count, proc->instructions - instructions);
+  check("wrapped at 0", t.at_count, 1);
+
+  profile_destroy(proc->profile);
+  free(proc);
+  return 0;
+}
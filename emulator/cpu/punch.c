@@ -4,6 +4,7 @@
 #include <stdint.h>
 #include <stdio.h>
 
+#include "clock.h"
 #include "processor.h"
 #include "pts.h"
 
@@ -14,5 +15,10 @@ bool pts_punch(processor_t *proc, int unit, uint8_t c) {
     return false;
   }
   buffer_t *io = &proc->punch[unit - 1];
-  return buffer_put(io, c);
+  if (!buffer_put(io, c)) {
+    return false;
+  }
+  ++proc->transfers;
+  proc->emulated_time += 3 == unit ? teleprinter_char_time : punch_char_time;
+  return true;
 }
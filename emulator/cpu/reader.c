@@ -4,6 +4,7 @@
 #include <stdint.h>
 #include <stdio.h>
 
+#include "clock.h"
 #include "processor.h"
 #include "pts.h"
 
@@ -12,7 +13,18 @@ bool pts_reader(processor_t *proc, int unit, uint8_t *c) {
   if (NULL == proc || unit < 1 || unit > reader_units) {
     return false;
   }
+
   buffer_t *io = &proc->reader[unit - 1];
+  tape_t *tape = &proc->tape[unit - 1];
 
-  return buffer_get(io, c);
+  if (buffer_get(io, c)) {
+    // characters supplied by the client
+  } else if (tape->position < tape->size) {
+    *c = tape->data[tape->position++];
+  } else {
+    return false;
+  }
+  ++proc->transfers;
+  proc->emulated_time += 3 == unit ? teleprinter_char_time : reader_char_time;
+  return true;
 }
@@ -0,0 +1,171 @@
+// ring.c
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include "ring.h"
+
+typedef uint32_t length_t; // header of each message
+
+bool ring_init(ring_t *ring) {
+  atomic_init(&ring->write_position, 0);
+  atomic_init(&ring->read_position, 0);
+  atomic_init(&ring->waiting, true); // the first message wakes
+  atomic_init(&ring->full, false);
+  atomic_init(&ring->closed, false);
+  pthread_mutex_init(&ring->lock, NULL);
+  pthread_cond_init(&ring->space, NULL);
+  ring->fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  return -1 != ring->fd;
+}
+
+void ring_destroy(ring_t *ring) {
+  if (-1 != ring->fd) {
+    close(ring->fd);
+  }
+  ring->fd = -1;
+  pthread_cond_destroy(&ring->space);
+  pthread_mutex_destroy(&ring->lock);
+}
+
+static void wake(ring_t *ring) {
+  uint64_t one = 1;
+  while (-1 == write(ring->fd, &one, sizeof(one)) && EINTR == errno) {
+  }
+}
+
+// copy into and out of the ring, wrapping at the end of the data
+static void copy_in(ring_t *ring, size_t position, const void *p, size_t n) {
+  size_t i = position & (ring_capacity - 1);
+  size_t first = ring_capacity - i < n ? ring_capacity - i : n;
+  memcpy(&ring->data[i], p, first);
+  memcpy(ring->data, (const uint8_t *)(p) + first, n - first);
+}
+
+static void copy_out(ring_t *ring, size_t position, void *p, size_t n) {
+  size_t i = position & (ring_capacity - 1);
+  size_t first = ring_capacity - i < n ? ring_capacity - i : n;
+  memcpy(p, &ring->data[i], first);
+  memcpy((uint8_t *)(p) + first, ring->data, n - first);
+}
+
+bool ring_put(ring_t *ring, const void *message, size_t size) {
+
+  size_t w = atomic_load_explicit(&ring->write_position, memory_order_relaxed);
+  size_t r = atomic_load_explicit(&ring->read_position, memory_order_acquire);
+  length_t length = size;
+  if (size > ring_capacity / 2 ||
+      ring_capacity - (w - r) < sizeof(length) + size) {
+    return false;
+  }
+  copy_in(ring, w, &length, sizeof(length));
+  copy_in(ring, w + sizeof(length), message, size);
+  atomic_store_explicit(
+    &ring->write_position, w + sizeof(length) + size, memory_order_release);
+
+  // pairs with the consumer setting waiting before it checks again
+  atomic_thread_fence(memory_order_seq_cst);
+  if (atomic_load_explicit(&ring->waiting, memory_order_relaxed) &&
+      atomic_exchange(&ring->waiting, false)) {
+    wake(ring);
+  }
+  return true;
+}
+
+// true if there is space for a message of size
+static bool space(ring_t *ring, size_t size) {
+  size_t w = atomic_load_explicit(&ring->write_position, memory_order_relaxed);
+  size_t r = atomic_load_explicit(&ring->read_position, memory_order_acquire);
+  return ring_capacity - (w - r) >= sizeof(length_t) + size;
+}
+
+bool ring_put_wait(ring_t *ring, const void *message, size_t size) {
+
+  if (size > ring_capacity / 2) {
+    return false;
+  }
+  while (!atomic_load_explicit(&ring->closed, memory_order_acquire)) {
+    if (ring_put(ring, message, size)) {
+      return true;
+    }
+
+    // pairs with the consumer freeing space before it checks full, so
+    // either this sees the space or the consumer sees full and, as it
+    // must take the lock, signals once this is waiting
+    pthread_mutex_lock(&ring->lock);
+    atomic_store_explicit(&ring->full, true, memory_order_relaxed);
+    atomic_thread_fence(memory_order_seq_cst);
+    while (!space(ring, size) &&
+           !atomic_load_explicit(&ring->closed, memory_order_acquire)) {
+      pthread_cond_wait(&ring->space, &ring->lock);
+    }
+    atomic_store_explicit(&ring->full, false, memory_order_relaxed);
+    pthread_mutex_unlock(&ring->lock);
+  }
+  return false;
+}
+
+// wake a producer sleeping in ring_put_wait
+static void wake_producer(ring_t *ring) {
+  pthread_mutex_lock(&ring->lock);
+  pthread_cond_signal(&ring->space);
+  pthread_mutex_unlock(&ring->lock);
+}
+
+void ring_close(ring_t *ring) {
+  atomic_store_explicit(&ring->closed, true, memory_order_release);
+  wake_producer(ring);
+}
+
+ssize_t ring_get(ring_t *ring, void *buffer, size_t buffer_size) {
+
+  bool armed = false;
+  for (;;) {
+    size_t r =
+      atomic_load_explicit(&ring->read_position, memory_order_relaxed);
+    size_t w =
+      atomic_load_explicit(&ring->write_position, memory_order_acquire);
+
+    if (r != w) {
+      length_t length = 0;
+      copy_out(ring, r, &length, sizeof(length));
+      size_t n = length < buffer_size ? length : buffer_size;
+      copy_out(ring, r + sizeof(length), buffer, n);
+      atomic_store_explicit(&ring->read_position,
+                            r + sizeof(length) + length,
+                            memory_order_release);
+
+      // pairs with the producer setting full before it checks again
+      atomic_thread_fence(memory_order_seq_cst);
+      if (atomic_load_explicit(&ring->full, memory_order_relaxed)) {
+        wake_producer(ring);
+      }
+
+      // the message arrived after the fd was cleared, so unless its
+      // producer saw the consumer waiting keep the fd readable, as no
+      // later message will wake it
+      if (armed && atomic_exchange(&ring->waiting, false)) {
+        wake(ring);
+      }
+      return n;
+    }
+    if (armed) {
+      return -EAGAIN;
+    }
+
+    // clear the fd, then check again in case a message was added
+    // before the producer could see that a wakeup is needed
+    uint64_t count = 0;
+    while (-1 == read(ring->fd, &count, sizeof(count)) && EINTR == errno) {
+    }
+    atomic_store_explicit(&ring->waiting, true, memory_order_relaxed);
+    atomic_thread_fence(memory_order_seq_cst);
+    armed = true;
+  }
+}
@@ -0,0 +1,74 @@
+// ring.h
+
+#if !defined(RING_H)
+#define RING_H 1
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+// message queue between one producer thread and one consumer thread
+//
+// each message is a length followed by its bytes; the positions only
+// increase and are reduced modulo the capacity when used, so the ring
+// is empty when they are equal
+//
+// the event fd is readable whenever the ring holds a message, so the
+// consumer can wait in select; the producer only writes to it when the
+// consumer found the ring empty and is about to sleep
+//
+// a producer that finds the ring full can sleep on a condition that the
+// consumer only signals when it has freed space for a waiting producer
+
+enum {
+  ring_capacity = 65536, // bytes, a power of two
+};
+
+typedef struct {
+  _Alignas(64) atomic_size_t write_position; // advanced by the producer
+  _Alignas(64) atomic_size_t read_position;  // advanced by the consumer
+  _Alignas(64) atomic_bool waiting;          // consumer needs a wakeup
+  atomic_bool full;                          // producer needs a wakeup
+  atomic_bool closed;                        // consumer reads no more
+  int fd;                                    // eventfd for select
+  pthread_mutex_t lock;                      // for sleeping on space
+  pthread_cond_t space;                      //
+  uint8_t data[ring_capacity];
+} ring_t;
+
+// returns false if the event fd could not be created
+bool ring_init(ring_t *ring);
+void ring_destroy(ring_t *ring);
+
+// add a message
+// returns:
+//   true  if the message was queued
+//   false if there is no space for it yet
+bool ring_put(ring_t *ring, const void *message, size_t size);
+
+// add a message, sleeping while the ring is full
+// returns:
+//   true  if the message was queued
+//   false if it is too large or the ring was closed
+bool ring_put_wait(ring_t *ring, const void *message, size_t size);
+
+// the consumer will not read any more, so a producer sleeping in
+// ring_put_wait returns and later messages are discarded
+void ring_close(ring_t *ring);
+
+// remove the oldest message, truncated to buffer_size
+// returns:
+//   positive: bytes copied
+//   negative: -EAGAIN if the ring is empty
+ssize_t ring_get(ring_t *ring, void *buffer, size_t buffer_size);
+
+// true if there is no message, only a hint for the producer's side
+static inline bool ring_empty(ring_t *ring) {
+  return atomic_load_explicit(&ring->write_position, memory_order_relaxed) ==
+         atomic_load_explicit(&ring->read_position, memory_order_relaxed);
+}
+
+#endif
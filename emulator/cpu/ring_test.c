@@ -0,0 +1,160 @@
+// ring_test.c
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/select.h>
+#include <unistd.h>
+
+#include "ring.h"
+
+static void check(const char *title, bool ok) {
+  if (!ok) {
+    printf("failed: %s\n", title);
+    exit(1);
+  }
+}
+
+// true if the event fd is readable within the timeout
+static bool readable(ring_t *ring, int timeout_ms) {
+  fd_set fds;
+  FD_ZERO(&fds);
+  FD_SET(ring->fd, &fds);
+  struct timeval timeout = {
+    .tv_sec = timeout_ms / 1000,
+    .tv_usec = (timeout_ms % 1000) * 1000,
+  };
+  return 1 == select(FD_SETSIZE, &fds, NULL, NULL, &timeout);
+}
+
+enum {
+  stress_messages = 200000,
+};
+
+// send numbered messages of varying length
+static void *producer(void *arg) {
+  ring_t *ring = arg;
+  uint8_t message[300];
+  for (uint32_t i = 0; i < stress_messages; ++i) {
+    size_t n = sizeof(i) + i % (sizeof(message) - sizeof(i));
+    memcpy(message, &i, sizeof(i));
+    memset(&message[sizeof(i)], (uint8_t)(i), n - sizeof(i));
+    check("put wait", ring_put_wait(ring, message, n));
+  }
+  return NULL;
+}
+
+// a put into a full ring, which sleeps until space is freed
+typedef struct {
+  ring_t *ring;
+  atomic_bool done;
+  bool ok;
+} blocked_t;
+
+static void *blocked_put(void *arg) {
+  blocked_t *b = arg;
+  char message[1000] = {0};
+  b->ok = ring_put_wait(b->ring, message, sizeof(message));
+  atomic_store(&b->done, true);
+  return NULL;
+}
+
+// fill the ring and start a put that has to wait
+static void start_blocked(ring_t *ring, blocked_t *b, pthread_t *thread) {
+  char buffer[1000] = {0};
+  while (ring_put(ring, buffer, sizeof(buffer))) {
+  }
+  b->ring = ring;
+  atomic_init(&b->done, false);
+  b->ok = false;
+  pthread_create(thread, NULL, blocked_put, b);
+  usleep(50000);
+  check("sleeping", !atomic_load(&b->done));
+}
+
+int main(int argc, char *argv[]) {
+
+  ring_t *ring = malloc(sizeof(ring_t));
+  check("malloc", NULL != ring);
+  check("init", ring_init(ring));
+
+  char buffer[ring_capacity];
+  check("empty", ring_empty(ring));
+  check("empty get", -EAGAIN == ring_get(ring, buffer, sizeof(buffer)));
+  check("empty not readable", !readable(ring, 0));
+
+  check("put", ring_put(ring, "hello", 6));
+  check("put", ring_put(ring, "world", 6));
+  check("not empty", !ring_empty(ring));
+  check("readable", readable(ring, 0));
+  check("get", 6 == ring_get(ring, buffer, sizeof(buffer)));
+  check("first", 0 == strcmp("hello", buffer));
+  check("readable with more", readable(ring, 0));
+  check("truncated", 3 == ring_get(ring, buffer, 3));
+  check("second", 0 == memcmp("wor", buffer, 3));
+  check("drained", -EAGAIN == ring_get(ring, buffer, sizeof(buffer)));
+  check("drained not readable", !readable(ring, 0));
+
+  // fill and wrap around the end of the data several times
+  int count = 0;
+  memset(buffer, 'x', sizeof(buffer));
+  while (ring_put(ring, buffer, 1000)) {
+    ++count;
+  }
+  check("full", count == ring_capacity / 1004);
+  check("too large", !ring_put(ring, buffer, ring_capacity / 2 + 1));
+  for (int i = 0; i < 10 * count; ++i) {
+    check("wrap get", 1000 == ring_get(ring, buffer, sizeof(buffer)));
+    check("wrap put", ring_put(ring, buffer, 1000));
+  }
+  while (ring_get(ring, buffer, sizeof(buffer)) > 0) {
+    --count;
+  }
+  check("wrap count", 0 == count);
+
+  // a full ring wakes a sleeping producer when space is freed
+  blocked_t b;
+  pthread_t thread;
+  start_blocked(ring, &b, &thread);
+  check("freed", ring_get(ring, buffer, sizeof(buffer)) > 0);
+  pthread_join(thread, NULL);
+  check("woken", b.ok);
+  while (ring_get(ring, buffer, sizeof(buffer)) > 0) {
+  }
+
+  // another thread sends while this one sleeps on the fd
+  pthread_create(&thread, NULL, producer, ring);
+  for (uint32_t i = 0; i < stress_messages;) {
+    ssize_t n = ring_get(ring, buffer, sizeof(buffer));
+    if (n < 0) {
+      check("wakeup", readable(ring, 5000));
+      continue;
+    }
+    uint32_t j = 0;
+    memcpy(&j, buffer, sizeof(j));
+    check("order", i == j);
+    check("length", (size_t)(n) == sizeof(i) + i % (300 - sizeof(i)));
+    for (ssize_t k = sizeof(i); k < n; ++k) {
+      check("content", (uint8_t)(i) == (uint8_t)(buffer[k]));
+    }
+    ++i;
+  }
+  pthread_join(thread, NULL);
+  check("stress drained", -EAGAIN == ring_get(ring, buffer, sizeof(buffer)));
+
+  // closing ends a sleeping put and discards later ones
+  start_blocked(ring, &b, &thread);
+  ring_close(ring);
+  pthread_join(thread, NULL);
+  check("closed", !b.ok);
+  check("closed put", !ring_put_wait(ring, "x", 2));
+
+  ring_destroy(ring);
+  free(ring);
+  return 0;
+}
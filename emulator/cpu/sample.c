@@ -0,0 +1,306 @@
+// sample.c
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "constants.h"
+#include "processor.h"
+#include "sample.h"
+
+enum {
+  sample_capacity = 8192, // samples in the ring, a power of two
+};
+
+// a sample is packed as the program counter, the function code and
+// the state of the machine
+enum {
+  pc_bits = 0x3fff,
+  op_shift = 14,
+  busy_shift = 20,
+  busy_bits = 7,
+  idle_bit = 1 << 23,
+  stopped_bit = 1 << 24,
+};
+
+struct sample_struct {
+  // written by the timer thread
+  _Alignas(64) atomic_uint write_position;
+  atomic_uint dropped; // samples lost as the ring was full
+
+  // written by the processor thread
+  _Alignas(64) atomic_uint read_position;
+
+  uint32_t ring[sample_capacity];
+
+  // only used by the timer thread while holding the lock
+  processor_t *next; // the next processor being sampled
+  int64_t period;    // nanoseconds between samples
+  int64_t due;       // monotonic time of the next sample
+  bool registered;   // in the list of the timer thread
+
+  // totals added up by the processor thread
+  int64_t states[sample_states];
+  int64_t busy[busy_punch_3 + 1];
+  int64_t op[64];
+  int64_t half_word[2 * memory_size];
+  unsigned int collected_drops; // of dropped, already counted
+};
+
+// the processors being sampled and the one timer thread for all of them
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t changed;
+static pthread_once_t once = PTHREAD_ONCE_INIT;
+static processor_t *first;
+static bool timer_running;
+
+static void initialise(void) {
+  pthread_condattr_t attr;
+  pthread_condattr_init(&attr);
+  pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+  pthread_cond_init(&changed, &attr);
+  pthread_condattr_destroy(&attr);
+}
+
+static int64_t monotonic_ns(void) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (int64_t)(now.tv_sec) * 1000000000 + now.tv_nsec;
+}
+
+// record the state of a processor that is running on another thread,
+// so it is read without synchronisation and a value that is changing
+// only blurs the sample
+static void take(processor_t *proc) {
+
+  const volatile processor_t *v = proc;
+  int pc = v->program_counter & pc_bits;
+  int64_t word = v->core_store[(pc >> 1) & address_bits];
+  int op = (word >> (0 == (pc & 1) ? first_op_shift : second_op_shift)) &
+           op_bits;
+  uint32_t sample = pc | op << op_shift;
+  sample |= (uint32_t)(v->io_busy & busy_bits) << busy_shift;
+  if (v->idle) {
+    sample |= idle_bit;
+  }
+  if (exec_mode_run != v->mode) {
+    sample |= stopped_bit;
+  }
+
+  sample_t *s = proc->sample;
+  unsigned int w =
+    atomic_load_explicit(&s->write_position, memory_order_relaxed);
+  unsigned int r =
+    atomic_load_explicit(&s->read_position, memory_order_acquire);
+  if (w - r >= sample_capacity) {
+    atomic_fetch_add_explicit(&s->dropped, 1, memory_order_relaxed);
+    return;
+  }
+  s->ring[w % sample_capacity] = sample;
+  atomic_store_explicit(&s->write_position, w + 1, memory_order_release);
+}
+
+// sample each processor when it is due until none are left
+static void *timer(void *arg) {
+
+  pthread_mutex_lock(&lock);
+  while (NULL != first) {
+    int64_t now = monotonic_ns();
+    int64_t next = INT64_MAX;
+    for (processor_t *p = first; NULL != p; p = p->sample->next) {
+      sample_t *s = p->sample;
+      if (s->due <= now) {
+        take(p);
+        s->due += s->period;
+        if (s->due <= now) {
+          s->due = now + s->period; // fell behind, do not catch up
+        }
+      }
+      if (s->due < next) {
+        next = s->due;
+      }
+    }
+    struct timespec until = {
+      .tv_sec = next / 1000000000,
+      .tv_nsec = next % 1000000000,
+    };
+    pthread_cond_timedwait(&changed, &lock, &until);
+  }
+  timer_running = false;
+  pthread_mutex_unlock(&lock);
+  return NULL;
+}
+
+// remove from the list, the lock must be held
+static void unregister(processor_t *proc) {
+  sample_t *s = proc->sample;
+  if (NULL == s || !s->registered) {
+    return;
+  }
+  for (processor_t **p = &first; NULL != *p; p = &(*p)->sample->next) {
+    if (proc == *p) {
+      *p = s->next;
+      break;
+    }
+  }
+  s->next = NULL;
+  s->registered = false;
+}
+
+bool sample_start(processor_t *proc, int rate) {
+
+  pthread_once(&once, initialise);
+  if (NULL == proc->sample) {
+    proc->sample = calloc(1, sizeof(sample_t));
+    if (NULL == proc->sample) {
+      return false;
+    }
+  }
+  sample_t *s = proc->sample;
+
+  pthread_mutex_lock(&lock);
+  bool ok = true;
+  s->period = 1000000000 / rate;
+  s->due = monotonic_ns() + s->period;
+  if (!s->registered) {
+    s->next = first;
+    first = proc;
+    s->registered = true;
+  }
+  if (!timer_running) {
+    pthread_t thread;
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    timer_running = 0 == pthread_create(&thread, &attr, timer, NULL);
+    pthread_attr_destroy(&attr);
+    if (!timer_running) {
+      unregister(proc);
+      ok = false;
+    }
+  }
+  pthread_cond_signal(&changed);
+  pthread_mutex_unlock(&lock);
+  return ok;
+}
+
+void sample_stop(processor_t *proc) {
+  pthread_mutex_lock(&lock);
+  unregister(proc);
+  pthread_cond_signal(&changed);
+  pthread_mutex_unlock(&lock);
+}
+
+int sample_rate(processor_t *proc) {
+  pthread_mutex_lock(&lock);
+  int rate = 0;
+  if (NULL != proc->sample && proc->sample->registered) {
+    rate = 1000000000 / proc->sample->period;
+  }
+  pthread_mutex_unlock(&lock);
+  return rate;
+}
+
+void sample_clear(processor_t *proc) {
+  sample_t *s = proc->sample;
+  if (NULL == s) {
+    return;
+  }
+  sample_collect(proc);
+  memset(s->states, 0, sizeof(s->states));
+  memset(s->busy, 0, sizeof(s->busy));
+  memset(s->op, 0, sizeof(s->op));
+  memset(s->half_word, 0, sizeof(s->half_word));
+}
+
+void sample_destroy(processor_t *proc) {
+  if (NULL == proc->sample) {
+    return;
+  }
+  sample_stop(proc);
+  free(proc->sample);
+  proc->sample = NULL;
+}
+
+void sample_collect(processor_t *proc) {
+
+  sample_t *s = proc->sample;
+  unsigned int r =
+    atomic_load_explicit(&s->read_position, memory_order_relaxed);
+  unsigned int w =
+    atomic_load_explicit(&s->write_position, memory_order_acquire);
+  for (; r != w; ++r) {
+    uint32_t sample = s->ring[r % sample_capacity];
+    busy_t busy = (sample >> busy_shift) & busy_bits;
+    if (0 != (sample & stopped_bit)) {
+      ++s->states[sample_state_stopped];
+      continue;
+    }
+    if (0 != (sample & idle_bit)) {
+      ++s->states[sample_state_idle];
+    } else if (busy_none != busy) {
+      ++s->states[sample_state_busy];
+      ++s->busy[busy];
+    } else {
+      ++s->states[sample_state_running];
+    }
+    ++s->op[(sample >> op_shift) & op_bits];
+    ++s->half_word[sample & pc_bits];
+  }
+  atomic_store_explicit(&s->read_position, r, memory_order_release);
+
+  unsigned int dropped =
+    atomic_load_explicit(&s->dropped, memory_order_relaxed);
+  s->states[sample_state_dropped] += dropped - s->collected_drops;
+  s->collected_drops = dropped;
+}
+
+void sample_totals(processor_t *proc, int64_t totals[sample_states]) {
+  memset(totals, 0, sample_states * sizeof(int64_t));
+  if (NULL != proc->sample) {
+    sample_collect(proc);
+    memcpy(totals, proc->sample->states, sample_states * sizeof(int64_t));
+  }
+}
+
+// keep the n largest counts in order by insertion
+static int top(const int64_t *h, int size, int *keys, int64_t *counts, int n) {
+  int found = 0;
+  for (int i = 0; i < size; ++i) {
+    if (0 == h[i] || (found == n && h[i] <= counts[n - 1])) {
+      continue;
+    }
+    int j = found < n ? found++ : n - 1;
+    for (; j > 0 && counts[j - 1] < h[i]; --j) {
+      keys[j] = keys[j - 1];
+      counts[j] = counts[j - 1];
+    }
+    keys[j] = i;
+    counts[j] = h[i];
+  }
+  return found;
+}
+
+int sample_hottest(processor_t *proc, int *half_words, int64_t *counts, int n) {
+  if (NULL == proc->sample) {
+    return 0;
+  }
+  sample_collect(proc);
+  return top(proc->sample->half_word, 2 * memory_size, half_words, counts, n);
+}
+
+int sample_hottest_ops(processor_t *proc, int *ops, int64_t *counts, int n) {
+  if (NULL == proc->sample) {
+    return 0;
+  }
+  sample_collect(proc);
+  return top(proc->sample->op, 64, ops, counts, n);
+}
+
+int64_t sample_busy_count(processor_t *proc, busy_t busy) {
+  return NULL == proc->sample ? 0 : proc->sample->busy[busy];
+}
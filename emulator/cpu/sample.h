@@ -0,0 +1,63 @@
+// sample.h
+
+#if !defined(SAMPLE_H)
+#define SAMPLE_H 1
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "processor.h"
+
+// statistical profile of long runs: a host timer thread shared by all
+// sampled processors records the program counter, the function code it
+// points at and whether the machine is waiting for I/O, idle or stopped
+//
+// the timer thread only writes each sample to a lock-free ring of the
+// processor, which the processor thread adds up between quanta, so
+// neither waits for the other and the interpreter is unchanged
+
+typedef struct sample_struct sample_t;
+
+enum {
+  sample_rate_default = 1000, // samples per second
+  sample_rate_max = 10000,    //
+};
+
+// the samples of each state
+typedef enum {
+  sample_state_running,
+  sample_state_busy,    // waiting for a reader or punch
+  sample_state_idle,    // in a loop waiting for a command
+  sample_state_stopped, //
+  sample_state_dropped, // lost as the ring was full
+  sample_states,
+} sample_state_t;
+
+// start or change the rate of sampling, false if out of resources
+bool sample_start(processor_t *proc, int rate);
+
+// stop sampling, the counts are kept until cleared
+void sample_stop(processor_t *proc);
+void sample_clear(processor_t *proc);
+
+// samples per second, 0 if not sampling
+int sample_rate(processor_t *proc);
+
+// stop sampling and discard the counts, before the processor is freed
+void sample_destroy(processor_t *proc);
+
+// add up the samples taken since the last call
+void sample_collect(processor_t *proc);
+
+// the totals of each state
+void sample_totals(processor_t *proc, int64_t totals[sample_states]);
+
+// the half words (address * 2 + half) or the function codes that were
+// sampled most, most first; returns the number found, at most n
+int sample_hottest(processor_t *proc, int *half_words, int64_t *counts, int n);
+int sample_hottest_ops(processor_t *proc, int *ops, int64_t *counts, int n);
+
+// the samples waiting for a device
+int64_t sample_busy_count(processor_t *proc, busy_t busy);
+
+#endif
@@ -0,0 +1,129 @@
+// sample_test.c
+
+#include <errno.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/select.h>
+#include <time.h>
+
+#include "elliott803.h"
+
+static void check(const char *title, bool ok) {
+  if (!ok) {
+    printf("failed: %s\n", title);
+    exit(1);
+  }
+}
+
+static void command(elliott803_t *proc, const char *s) {
+  elliott803_send(proc, s, strlen(s) + 1);
+}
+
+// receive messages until one starts with prefix and copy it to buffer,
+// false on timeout
+static bool expect(elliott803_t *proc, const char *prefix, char *buffer) {
+  int fd = elliott803_get_fd(proc);
+  time_t deadline = time(NULL) + 5;
+  for (;;) {
+    fd_set fds;
+    FD_ZERO(&fds);
+    FD_SET(fd, &fds);
+    struct timeval timeout = {
+      .tv_sec = deadline - time(NULL),
+      .tv_usec = 0,
+    };
+    if (timeout.tv_sec <= 0) {
+      return false;
+    }
+    int rc = select(FD_SETSIZE, &fds, NULL, NULL, &timeout);
+    if (-1 == rc && EINTR == errno) {
+      continue;
+    }
+    if (rc <= 0) {
+      return false;
+    }
+    ssize_t n = elliott803_receive(proc, buffer, 1023);
+    if (n <= 0) {
+      continue;
+    }
+    buffer[n] = '\0';
+    if (0 == strncmp(prefix, buffer, strlen(prefix))) {
+      return true;
+    }
+  }
+}
+
+// the running count of "sample running N busy N ..."
+static int64_t running(const char *buffer) {
+  int64_t n = -1;
+  sscanf(buffer, "sample running %" SCNd64, &n);
+  return n;
+}
+
+int main(int argc, char *argv[]) {
+
+  char buffer[1024];
+  elliott803_t *a = elliott803_create("sample a");
+  elliott803_t *b = elliott803_create("sample b");
+  check("create", NULL != a && NULL != b);
+
+  command(a, "sample");
+  check("initially off", expect(a, "sample off", buffer));
+
+  // one machine counts in a loop while the other waits for tape
+  command(a, "mw 4096 22 4200 : 40 4096");
+  command(a, "run 4096");
+  command(b, "mw 4096 71 0 : 40 4096");
+  command(b, "run 4096");
+
+  command(a, "sample on 5000");
+  check("on a", expect(a, "sample on 5000", buffer));
+  command(b, "sample on");
+  check("on b", expect(b, "sample on 1000", buffer));
+
+  struct timespec pause = {
+    .tv_sec = 0,
+    .tv_nsec = 300000000,
+  };
+  nanosleep(&pause, NULL);
+
+  command(a, "sample report 2");
+  check("totals a", expect(a, "sample running", buffer));
+  check("running a", running(buffer) > 0);
+  check("function a", expect(a, "sample function ", buffer));
+  check("hottest a", expect(a, "sample address 4096", buffer));
+
+  command(b, "sample report");
+  check("totals b", expect(b, "sample running", buffer));
+  check("waiting b", expect(b, "sample busy reader_1 ", buffer));
+
+  // stopped, the counts are kept until cleared
+  command(a, "sample off");
+  check("off", expect(a, "sample off", buffer));
+  command(a, "sample report 1");
+  check("kept", expect(a, "sample running", buffer) && running(buffer) > 0);
+  command(a, "sample clear");
+  check("clear", expect(a, "sample off", buffer));
+  command(a, "sample report");
+  check("cleared", expect(a, "sample running 0 ", buffer));
+
+  command(a, "sample on 0");
+  check("rate too small", expect(a, "error sample rate too small", buffer));
+  command(a, "sample bogus");
+  check("invalid", expect(a, "error invalid sample command", buffer));
+
+  // destroying one machine leaves the timer sampling the other
+  elliott803_destroy(a);
+  command(b, "sample clear");
+  check("clear b", expect(b, "sample on 1000", buffer));
+  nanosleep(&pause, NULL);
+  command(b, "sample report");
+  check("still sampled", expect(b, "sample running", buffer));
+  check("busy after destroy", expect(b, "sample busy reader_1 ", buffer));
+
+  elliott803_destroy(b);
+  return 0;
+}
@@ -0,0 +1,377 @@
+// snapshot.c
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "buffer.h"
+#include "core.h"
+#include "cpu803.h"
+#include "film.h"
+#include "processor.h"
+#include "snapshot.h"
+
+typedef struct {
+  char magic[8];     // snapshot_magic, not terminated
+  uint32_t version;  // snapshot_version
+  uint32_t reserved; // zero
+  uint64_t size;     // bytes of payload
+  uint64_t checksum; // of the payload words
+} header_t;
+
+static const char snapshot_magic[8] = "E803SNAP";
+
+// FNV-1a taking a word rather than a byte at a time
+static uint64_t checksum(const int64_t *words, size_t count) {
+  uint64_t h = 0xcbf29ce484222325ULL;
+  for (size_t i = 0; i < count; ++i) {
+    h = (h ^ (uint64_t)(words[i])) * 0x100000001b3ULL;
+  }
+  return h;
+}
+
+// payload being built
+typedef struct {
+  int64_t *words;
+  size_t count;
+  size_t capacity;
+  bool failed; // out of memory
+} writer_t;
+
+static void put(writer_t *w, int64_t value) {
+  if (w->count == w->capacity && !w->failed) {
+    size_t capacity = 2 * w->capacity + 4096;
+    int64_t *p = realloc(w->words, capacity * sizeof(int64_t));
+    if (NULL == p) {
+      w->failed = true;
+    } else {
+      w->words = p;
+      w->capacity = capacity;
+    }
+  }
+  if (!w->failed) {
+    w->words[w->count++] = value;
+  }
+}
+
+// a count followed by the bytes packed into whole words
+static void put_bytes(writer_t *w, const uint8_t *data, size_t size) {
+  put(w, size);
+  for (size_t i = 0; i < size; i += sizeof(int64_t)) {
+    int64_t word = 0;
+    size_t n = size - i < sizeof(word) ? size - i : sizeof(word);
+    memcpy(&word, &data[i], n);
+    put(w, word);
+  }
+}
+
+// characters waiting in a buffer, which is left unchanged
+static void put_buffer(writer_t *w, const buffer_t *buffer) {
+  buffer_t copy = *buffer;
+  uint8_t data[buffer_capacity];
+  size_t n = 0;
+  while (buffer_get(&copy, &data[n])) {
+    ++n;
+  }
+  put_bytes(w, data, n);
+}
+
+snapshot_error_t snapshot_save(processor_t *proc, const char *filename) {
+
+  writer_t w = {0};
+  for (int i = 0; i < memory_size; ++i) {
+    put(&w, proc->core_store[i]);
+  }
+  put(&w, proc->program_counter);
+  put(&w, proc->accumulator);
+  put(&w, proc->auxiliary_register);
+  put(&w, proc->overflow);
+  put(&w, proc->b_addr);
+  put(&w, proc->b_data);
+  put(&w, proc->word_generator);
+  put(&w, proc->mode);
+  put(&w, proc->film_block);
+  put(&w, proc->film_function);
+  for (size_t i = 0; i < reader_units; ++i) {
+    const tape_t *tape = &proc->tape[i];
+    put_buffer(&w, &proc->reader[i]);
+    if (NULL == tape->data) {
+      put_bytes(&w, NULL, 0);
+    } else {
+      put_bytes(
+        &w, &tape->data[tape->position], tape->size - tape->position);
+    }
+  }
+  for (size_t i = 0; i < punch_units; ++i) {
+    put_buffer(&w, &proc->punch[i]);
+  }
+  put(&w, NULL == proc->film ? 0 : film_words);
+  for (int i = 0; NULL != proc->film && i < film_words; ++i) {
+    put(&w, proc->film[i]);
+  }
+  if (w.failed) {
+    free(w.words);
+    return snapshot_no_memory;
+  }
+
+  header_t header = {
+    .version = snapshot_version,
+    .size = w.count * sizeof(int64_t),
+    .checksum = checksum(w.words, w.count),
+  };
+  memcpy(header.magic, snapshot_magic, sizeof(header.magic));
+
+  // write a temporary file and rename it so a reader never sees a
+  // partial snapshot
+  char temporary[4096];
+  int n = snprintf(temporary, sizeof(temporary), "%s.tmp", filename);
+  if (n >= (int)(sizeof(temporary))) {
+    free(w.words);
+    errno = ENAMETOOLONG;
+    return snapshot_io_error;
+  }
+  FILE *f = fopen(temporary, "wb");
+  if (NULL == f) {
+    free(w.words);
+    return snapshot_io_error;
+  }
+  bool ok = 1 == fwrite(&header, sizeof(header), 1, f) &&
+            w.count == fwrite(w.words, sizeof(int64_t), w.count, f);
+  ok = 0 == fclose(f) && ok;
+  free(w.words);
+  if (!ok || 0 != rename(temporary, filename)) {
+    int e = errno;
+    unlink(temporary);
+    errno = e;
+    return snapshot_io_error;
+  }
+  return snapshot_ok;
+}
+
+// payload being parsed
+typedef struct {
+  const int64_t *p;
+  size_t left; // words
+} reader_t;
+
+static bool get(reader_t *r, int64_t *value) {
+  if (0 == r->left) {
+    return false;
+  }
+  *value = *r->p++;
+  --r->left;
+  return true;
+}
+
+// the bytes stay in the mapped file
+static bool get_bytes(reader_t *r, const uint8_t **data, size_t *size) {
+  int64_t n = 0;
+  if (!get(r, &n) || n < 0 || (uint64_t)(n) > r->left * sizeof(int64_t)) {
+    return false;
+  }
+  size_t words = (n + sizeof(int64_t) - 1) / sizeof(int64_t);
+  *data = (const uint8_t *)(r->p);
+  *size = n;
+  r->p += words;
+  r->left -= words;
+  return true;
+}
+
+static bool get_buffer(reader_t *r, buffer_t *buffer) {
+  const uint8_t *data = NULL;
+  size_t size = 0;
+  if (!get_bytes(r, &data, &size) || size > buffer_capacity) {
+    return false;
+  }
+  buffer_clear(buffer);
+  for (size_t i = 0; i < size; ++i) {
+    buffer_put(buffer, data[i]);
+  }
+  return true;
+}
+
+// machine state parsed from a payload before any of it is applied
+typedef struct {
+  const int64_t *core;
+  int64_t registers[10];
+  buffer_t reader[reader_units];
+  const uint8_t *tape[reader_units];
+  size_t tape_size[reader_units];
+  buffer_t punch[punch_units];
+  const int64_t *film; // NULL if the film was not used
+} state_t;
+
+static bool parse(reader_t *r, state_t *s) {
+  if (r->left < memory_size) {
+    return false;
+  }
+  s->core = r->p;
+  r->p += memory_size;
+  r->left -= memory_size;
+
+  for (size_t i = 0; i < SizeOfArray(s->registers); ++i) {
+    if (!get(r, &s->registers[i])) {
+      return false;
+    }
+  }
+  for (size_t i = 0; i < reader_units; ++i) {
+    if (!get_buffer(r, &s->reader[i]) ||
+        !get_bytes(r, &s->tape[i], &s->tape_size[i])) {
+      return false;
+    }
+  }
+  for (size_t i = 0; i < punch_units; ++i) {
+    if (!get_buffer(r, &s->punch[i])) {
+      return false;
+    }
+  }
+
+  int64_t film = 0;
+  if (!get(r, &film) || (0 != film && film_words != film) ||
+      (size_t)(film) != r->left) {
+    return false;
+  }
+  s->film = 0 == film ? NULL : r->p;
+
+  // registers in the order they were saved
+  int64_t *v = s->registers;
+  return v[0] >= 0 && v[0] < 2 * memory_size &&                 // pc
+         (0 == v[4] || (v[4] >= 0 && v[4] < 2 * memory_size)) && // b_addr
+         (exec_mode_stop == v[7] || exec_mode_run == v[7]) &&     // mode
+         v[8] >= 0 && v[8] < film_blocks &&                       // block
+         v[9] >= film_read && v[9] <= film_position;              // function
+}
+
+snapshot_error_t snapshot_load(processor_t *proc, const char *filename) {
+
+  int fd = open(filename, O_RDONLY | O_CLOEXEC);
+  if (-1 == fd) {
+    return snapshot_io_error;
+  }
+  struct stat st;
+  if (0 != fstat(fd, &st)) {
+    close(fd);
+    return snapshot_io_error;
+  }
+  if ((size_t)(st.st_size) < sizeof(header_t)) {
+    close(fd);
+    return snapshot_bad_format;
+  }
+  void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (MAP_FAILED == map) {
+    return snapshot_io_error;
+  }
+
+  snapshot_error_t rc = snapshot_ok;
+  const header_t *header = map;
+  const int64_t *payload = (const int64_t *)(&header[1]);
+  state_t s;
+  reader_t r = {
+    .p = payload,
+    .left = header->size / sizeof(int64_t),
+  };
+  if (0 != memcmp(snapshot_magic, header->magic, sizeof(header->magic))) {
+    rc = snapshot_bad_format;
+  } else if (snapshot_version != header->version) {
+    rc = snapshot_bad_version;
+  } else if (header->size != st.st_size - sizeof(header_t) ||
+             0 != header->size % sizeof(int64_t)) {
+    rc = snapshot_bad_format;
+  } else if (header->checksum !=
+             checksum(payload, header->size / sizeof(int64_t))) {
+    rc = snapshot_bad_checksum;
+  } else if (!parse(&r, &s)) {
+    rc = snapshot_bad_format;
+  }
+
+  // copy the rest of the loaded tapes, which the processor owns
+  uint8_t *tape[reader_units] = {NULL};
+  for (size_t i = 0; snapshot_ok == rc && i < reader_units; ++i) {
+    if (s.tape_size[i] > 0) {
+      tape[i] = malloc(s.tape_size[i]);
+      if (NULL == tape[i]) {
+        rc = snapshot_no_memory;
+      } else {
+        memcpy(tape[i], s.tape[i], s.tape_size[i]);
+      }
+    }
+  }
+  if (snapshot_ok == rc && NULL != s.film && NULL == proc->film) {
+    proc->film = malloc(film_words * sizeof(int64_t));
+    if (NULL == proc->film) {
+      rc = snapshot_no_memory;
+    }
+  }
+  if (snapshot_ok != rc) {
+    for (size_t i = 0; i < reader_units; ++i) {
+      free(tape[i]);
+    }
+    munmap(map, st.st_size);
+    return rc;
+  }
+
+  // only words that differ are invalidated
+  core_write_block(proc, 0, s.core, memory_size);
+
+  int64_t *v = s.registers;
+  proc->program_counter = v[0];
+  proc->accumulator = v[1];
+  proc->auxiliary_register = v[2];
+  proc->overflow = 0 != v[3];
+  proc->b_addr = 0;
+  if (0 != v[4]) {
+    cpu803_load_b(proc, v[5]);
+    proc->b_addr = v[4];
+  }
+  proc->b_data = v[5];
+  proc->word_generator = v[6];
+  proc->mode = v[7];
+  proc->film_block = v[8];
+  proc->film_function = v[9];
+  proc->io_busy = busy_none;
+
+  for (size_t i = 0; i < reader_units; ++i) {
+    proc->reader[i] = s.reader[i];
+    free(proc->tape[i].data);
+    proc->tape[i].data = tape[i];
+    proc->tape[i].size = s.tape_size[i];
+    proc->tape[i].position = 0;
+  }
+  for (size_t i = 0; i < punch_units; ++i) {
+    proc->punch[i] = s.punch[i];
+  }
+  if (NULL == s.film) {
+    film_release(proc);
+  } else {
+    memcpy(proc->film, s.film, film_words * sizeof(int64_t));
+  }
+
+  munmap(map, st.st_size);
+  return snapshot_ok;
+}
+
+const char *snapshot_error_string(snapshot_error_t error) {
+  switch (error) {
+  case snapshot_ok:
+    return "ok";
+  case snapshot_io_error:
+    return strerror(errno);
+  case snapshot_no_memory:
+    return "out of memory";
+  case snapshot_bad_format:
+    return "not a snapshot";
+  case snapshot_bad_version:
+    return "unsupported snapshot version";
+  case snapshot_bad_checksum:
+    return "snapshot checksum mismatch";
+  }
+  return "unknown error";
+}
@@ -0,0 +1,45 @@
+// snapshot.h
+
+#if !defined(SNAPSHOT_H)
+#define SNAPSHOT_H 1
+
+#include "processor.h"
+
+// whole machine state saved to a file
+//
+// the file is a header followed by a payload of 64 bit words in host
+// byte order: the store, the registers, the word generator, the mode,
+// the film handler position and function, for each reader the buffered
+// characters and the rest of any loaded tape, for each punch the
+// characters not yet sent and finally the film if it was used; the
+// header has a magic string, a version, the payload size and a 64 bit
+// FNV-1a checksum of the payload words
+//
+// a file from a host of the other byte order fails the version check;
+// statistics, the clock and the engine are not part of the state
+
+enum {
+  snapshot_version = 1,
+};
+
+typedef enum {
+  snapshot_ok,           //
+  snapshot_io_error,     // see errno
+  snapshot_no_memory,    //
+  snapshot_bad_format,   // not a snapshot or truncated
+  snapshot_bad_version,  // different version or byte order
+  snapshot_bad_checksum, // payload is corrupt
+} snapshot_error_t;
+
+// write the state to a new file, replacing any existing one only once
+// it is complete
+snapshot_error_t snapshot_save(processor_t *proc, const char *filename);
+
+// replace the state with one from a file, which is mapped rather than
+// read; on error the state is unchanged
+snapshot_error_t snapshot_load(processor_t *proc, const char *filename);
+
+// description of an error for a reply
+const char *snapshot_error_string(snapshot_error_t error);
+
+#endif
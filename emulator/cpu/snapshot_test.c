@@ -0,0 +1,130 @@
+// snapshot_test.c
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "buffer.h"
+#include "constants.h"
+#include "core.h"
+#include "cpu803.h"
+#include "film.h"
+#include "processor.h"
+#include "snapshot.h"
+
+static void check(const char *title, bool ok) {
+  if (!ok) {
+    printf("failed: %s\n", title);
+    exit(1);
+  }
+}
+
+// run until the machine stops
+static void run(processor_t *proc, int address) {
+  proc->program_counter = address << 1;
+  proc->mode = exec_mode_run;
+  for (int i = 0; i < 100000 && exec_mode_run == proc->mode; ++i) {
+    cpu803_execute(proc);
+  }
+}
+
+int main(int argc, char *argv[]) {
+
+  processor_t *proc = calloc(1, sizeof(processor_t));
+  processor_t *copy = calloc(1, sizeof(processor_t));
+  check("calloc", NULL != proc && NULL != copy);
+
+  char filename[] = "/tmp/snapshot_test.XXXXXX";
+  int fd = mkstemp(filename);
+  check("mkstemp", -1 != fd);
+  close(fd);
+
+  // add 4200 to 4201 and stop
+  core_write(proc, 4096, ELLIOTT(030, 4200, 0, 004, 4201));
+  core_write(proc, 4097, ELLIOTT(020, 4202, 0, 040, 4098));
+  core_write(proc, 4098, ELLIOTT(040, 4098, 0, 000, 0));
+  core_write(proc, 4200, 1234);
+  core_write(proc, 4201, 4321);
+  proc->accumulator = 77;
+  proc->auxiliary_register = 88;
+  proc->overflow = true;
+  proc->word_generator = ELLIOTT(040, 4096, 0, 000, 0);
+  proc->film_block = 123;
+  proc->film_function = film_write;
+  buffer_put(&proc->reader[0], 0x11);
+  buffer_put(&proc->reader[0], 0x12);
+  buffer_put(&proc->punch[2], 0x13);
+  uint8_t *tape = malloc(5);
+  check("malloc", NULL != tape);
+  memcpy(tape, "\x01\x02\x03\x04\x05", 5);
+  proc->tape[1] = (tape_t){.data = tape, .size = 5, .position = 2};
+  proc->film = calloc(film_words, sizeof(int64_t));
+  check("film", NULL != proc->film);
+  proc->film[film_words - 1] = 99;
+
+  check("save", snapshot_ok == snapshot_save(proc, filename));
+  check("load", snapshot_ok == snapshot_load(copy, filename));
+
+  check("store", 0 == memcmp(proc->core_store,
+                             copy->core_store,
+                             sizeof(proc->core_store)));
+  check("accumulator", 77 == copy->accumulator);
+  check("auxiliary", 88 == copy->auxiliary_register);
+  check("overflow", copy->overflow);
+  check("word generator", proc->word_generator == copy->word_generator);
+  check("film block", 123 == copy->film_block);
+  check("film function", film_write == copy->film_function);
+  check("film", NULL != copy->film && 99 == copy->film[film_words - 1]);
+
+  uint8_t c = 0;
+  check("reader", buffer_get(&copy->reader[0], &c) && 0x11 == c);
+  check("reader", buffer_get(&copy->reader[0], &c) && 0x12 == c);
+  check("reader empty", !buffer_get(&copy->reader[0], &c));
+  check("punch", buffer_get(&copy->punch[2], &c) && 0x13 == c);
+  check("tape", 3 == copy->tape[1].size && 0 == copy->tape[1].position &&
+                  0 == memcmp("\x03\x04\x05", copy->tape[1].data, 3));
+  check("no tape", NULL == copy->tape[0].data);
+
+  // the restored machine runs the same program
+  run(proc, 4096);
+  run(copy, 4096);
+  check("ran", 5555 == core_read(proc, 4202));
+  check("restored ran", 5555 == core_read(copy, 4202));
+
+  // loading replaces changed words and their decoded copies
+  check("reload", snapshot_ok == snapshot_load(copy, filename));
+  check("reloaded", 0 == core_read(copy, 4202));
+  core_write(copy, 4200, 1);
+  check("reload", snapshot_ok == snapshot_load(copy, filename));
+  run(copy, 4096);
+  check("reloaded ran", 5555 == core_read(copy, 4202));
+
+  // a corrupt file is rejected and leaves the state unchanged
+  FILE *f = fopen(filename, "r+b");
+  check("open", NULL != f);
+  fseek(f, 1000, SEEK_SET);
+  fputc(0x55, f);
+  fclose(f);
+  check("checksum", snapshot_bad_checksum == snapshot_load(copy, filename));
+  check("unchanged", 5555 == core_read(copy, 4202));
+
+  f = fopen(filename, "wb");
+  check("open", NULL != f);
+  fputs("not a snapshot, just some text to fill a header", f);
+  fclose(f);
+  check("format", snapshot_bad_format == snapshot_load(copy, filename));
+
+  unlink(filename);
+  check("missing", snapshot_io_error == snapshot_load(copy, filename));
+
+  free(proc->tape[1].data);
+  free(copy->tape[1].data);
+  film_release(proc);
+  film_release(copy);
+  free(proc);
+  free(copy);
+  return 0;
+}
@@ -0,0 +1,1009 @@
+// trace.c
+
+#include <errno.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "constants.h"
+#include "core.h"
+#include "cpu803.h"
+#include "processor.h"
+#include "trace.h"
+
+static const char trace_magic[8] = "E803TRC1";
+static const char index_magic[8] = "E803IDX1";
+
+enum {
+  chunk_size = 1 << 20, // bytes handed to the writer at once
+  chunk_limit = 64,     // queued before the processor waits for the writer
+  trailer_size = 16,    // offset of the end record and the index magic
+};
+
+// tag of a record, for a step the flags of what follows
+enum {
+  step_two = 0x01,         // both instructions of the word executed
+  step_accumulator = 0x02, // change of A
+  step_auxiliary = 0x04,   // change of AR
+  step_overflow = 0x08,    // overflow toggled
+  step_stores = 0x10,      // number of words stored, each address and value
+  step_external = 0x40,    // used a peripheral, B register follows
+  tag_checkpoint = 0x80,   //
+  tag_state = 0x81,        //
+  tag_end = 0xc0,          //
+};
+
+typedef struct chunk_struct {
+  struct chunk_struct *next;
+  size_t used;
+  uint8_t data[chunk_size];
+} chunk_t;
+
+// what a record holds of the registers
+typedef struct {
+  int64_t instructions;
+  int program_counter;
+  int64_t accumulator;
+  int64_t auxiliary_register;
+  bool overflow;
+  int b_addr;
+  int64_t b_data;
+} registers_t;
+
+typedef struct {
+  int address;
+  int64_t value;
+  int64_t instruction; // the count while it was stored
+} store_t;
+
+typedef struct {
+  int64_t instructions;
+  int64_t offset;
+} keyframe_t;
+
+struct trace_struct {
+  char *filename;
+  FILE *file; // NULL when only collecting stores for a replay
+
+  // shared with the writer thread
+  pthread_t thread;
+  pthread_mutex_t lock;
+  pthread_cond_t work;  // a chunk was queued or the trace is closing
+  pthread_cond_t space; // a chunk was written
+  chunk_t *head;        // queued for the writer
+  chunk_t *tail;        //
+  chunk_t *spare;       // written, for reuse
+  int chunks;           // allocated
+  bool closing;         //
+  bool failed;          // a write failed and the rest is discarded
+
+  // only used by the processor thread
+  chunk_t *chunk;        // being filled
+  int64_t offset;        // bytes recorded
+  keyframe_t *keyframes; // each keyframe for the index
+  size_t keyframe_count; //
+  size_t keyframe_size;  //
+  registers_t after;     // registers after the last step
+  int record_pc;         // program counter of the last record
+  int64_t last_keyframe; // instructions at the last keyframe
+  bool changed;          // written outside a step
+  bool stepping;         // collecting stores
+  bool lost;             // a store did not fit
+  store_t *stores;       // made by the current step
+  size_t store_count;    //
+  size_t store_size;     //
+};
+
+static void registers_save(processor_t *proc, registers_t *r) {
+  r->instructions = proc->instructions;
+  r->program_counter = proc->program_counter;
+  r->accumulator = proc->accumulator;
+  r->auxiliary_register = proc->auxiliary_register;
+  r->overflow = proc->overflow;
+  r->b_addr = proc->b_addr;
+  r->b_data = proc->b_data;
+}
+
+static bool registers_same(const registers_t *a, const registers_t *b) {
+  return a->instructions == b->instructions &&
+         a->program_counter == b->program_counter &&
+         a->accumulator == b->accumulator &&
+         a->auxiliary_register == b->auxiliary_register &&
+         a->overflow == b->overflow && a->b_addr == b->b_addr &&
+         a->b_data == b->b_data;
+}
+
+// a function using a peripheral, whose effect a replay cannot repeat
+static bool external(int op) { return op >= 070 && 073 != op; }
+
+static uint64_t zigzag(int64_t v) {
+  return ((uint64_t)v << 1) ^ (uint64_t)(v >> 63);
+}
+
+static int64_t unzigzag(uint64_t v) {
+  return (int64_t)(v >> 1) ^ -(int64_t)(v & 1);
+}
+
+// the change from one word to another, wrapping
+static int64_t difference(int64_t after, int64_t before) {
+  return (int64_t)((uint64_t)after - (uint64_t)before);
+}
+
+// execution
+
+void trace_store(processor_t *proc, int address) {
+
+  trace_t *t = proc->trace;
+  if (!t->stepping) {
+    t->changed = true;
+    return;
+  }
+  if (t->store_count == t->store_size) {
+    size_t size = 0 == t->store_size ? 64 : 2 * t->store_size;
+    store_t *stores = realloc(t->stores, size * sizeof(store_t));
+    if (NULL == stores) {
+      t->lost = true;
+      return;
+    }
+    t->stores = stores;
+    t->store_size = size;
+  }
+  t->stores[t->store_count++] = (store_t){
+    .address = address,
+    .value = proc->core_store[address],
+    .instruction = proc->instructions,
+  };
+}
+
+// execute a word, collecting the stores it made; returns the number of
+// instructions executed and their functions and addresses
+static int execute(processor_t *proc, int op[2], int address[2]) {
+
+  trace_t *t = proc->trace;
+  int64_t first = proc->instructions;
+  int pc = proc->program_counter;
+
+  // the word as cpu803_execute will find it, which it may overwrite;
+  // the program counter is not wrapped at the top of store
+  decoded_t d = *cpu803_fetch(proc, (pc >> 1) & address_bits);
+  if (pc == proc->b_addr) {
+    d = proc->b_decoded;
+  }
+  int64_t modifier = core_read(proc, d.address1);
+
+  t->store_count = 0;
+  t->lost = false;
+  t->stepping = true;
+  cpu803_execute(proc);
+  t->stepping = false;
+
+  int count = (int)(proc->instructions - first);
+  int n = 0;
+  if (0 == (pc & 1)) {
+    op[n] = d.op1;
+    address[n++] = d.address1;
+  }
+  if (n < count) {
+    if (d.b_modified) {
+      // the modifier as any first instruction left it
+      for (size_t i = 0; i < t->store_count && 1 == n; ++i) {
+        const store_t *s = &t->stores[i];
+        if (first + 1 == s->instruction && d.address1 == s->address &&
+            d.address1 >= 4) {
+          modifier = s->value;
+        }
+      }
+      int64_t word = d.word + modifier;
+      op[n] = (word >> second_op_shift) & op_bits;
+      address[n++] = (word >> second_address_shift) & address_bits;
+    } else {
+      op[n] = d.op2;
+      address[n++] = d.address2;
+    }
+  }
+  return count;
+}
+
+// writing
+
+// queue the chunk being filled for the writer
+static void enqueue(trace_t *t) {
+  pthread_mutex_lock(&t->lock);
+  t->chunk->next = NULL;
+  if (NULL == t->tail) {
+    t->head = t->chunk;
+  } else {
+    t->tail->next = t->chunk;
+  }
+  t->tail = t->chunk;
+  t->chunk = NULL;
+  pthread_cond_signal(&t->work);
+  pthread_mutex_unlock(&t->lock);
+}
+
+// queue the full chunk and continue in a spare or a new one, waiting
+// for the writer only when too many are queued
+static void submit(trace_t *t) {
+  enqueue(t);
+  pthread_mutex_lock(&t->lock);
+  for (;;) {
+    if (NULL != t->spare) {
+      t->chunk = t->spare;
+      t->spare = t->chunk->next;
+      break;
+    }
+    if (t->chunks < chunk_limit) {
+      t->chunk = malloc(sizeof(chunk_t));
+      if (NULL != t->chunk) {
+        ++t->chunks;
+        break;
+      }
+    }
+    pthread_cond_wait(&t->space, &t->lock);
+  }
+  pthread_mutex_unlock(&t->lock);
+  t->chunk->used = 0;
+}
+
+static void put_byte(trace_t *t, uint8_t b) {
+  if (chunk_size == t->chunk->used) {
+    submit(t);
+  }
+  t->chunk->data[t->chunk->used++] = b;
+  ++t->offset;
+}
+
+static void put_unsigned(trace_t *t, uint64_t v) {
+  while (v >= 0x80) {
+    put_byte(t, (uint8_t)(v | 0x80));
+    v >>= 7;
+  }
+  put_byte(t, (uint8_t)v);
+}
+
+static void put_signed(trace_t *t, int64_t v) { put_unsigned(t, zigzag(v)); }
+
+// a word is shifted down to its 39 bits; one with any of the low bits
+// set is flagged and written whole
+static void put_word(trace_t *t, int64_t v) {
+  if (0 == (v & (((int64_t)1 << word_shift) - 1))) {
+    put_unsigned(t, zigzag(v >> word_shift) << 1);
+  } else {
+    put_unsigned(t, 1);
+    put_unsigned(t, (uint64_t)v);
+  }
+}
+
+// the registers and the whole store
+static void put_keyframe(trace_t *t, processor_t *proc, uint8_t tag) {
+
+  if (t->keyframe_count == t->keyframe_size) {
+    size_t size = 0 == t->keyframe_size ? 256 : 2 * t->keyframe_size;
+    keyframe_t *k = realloc(t->keyframes, size * sizeof(keyframe_t));
+    if (NULL != k) {
+      t->keyframes = k;
+      t->keyframe_size = size;
+    }
+  }
+  if (t->keyframe_count < t->keyframe_size) {
+    t->keyframes[t->keyframe_count++] = (keyframe_t){
+      .instructions = proc->instructions,
+      .offset = t->offset,
+    };
+  } // otherwise seeking goes back further
+
+  put_byte(t, tag);
+  put_unsigned(t, proc->instructions);
+  put_unsigned(t, proc->program_counter);
+  put_word(t, proc->accumulator);
+  put_word(t, proc->auxiliary_register);
+  put_byte(t, proc->overflow);
+  put_unsigned(t, proc->b_addr);
+  put_word(t, proc->b_data);
+  for (int i = 0; i < memory_size; ++i) {
+    put_word(t, proc->core_store[i]);
+  }
+  t->record_pc = proc->program_counter;
+  t->last_keyframe = proc->instructions;
+}
+
+void trace_execute(processor_t *proc) {
+
+  trace_t *t = proc->trace;
+  registers_t before;
+  registers_save(proc, &before);
+  if (t->changed || !registers_same(&before, &t->after)) {
+    put_keyframe(t, proc, tag_state);
+  } else if (before.instructions - t->last_keyframe >=
+             trace_keyframe_interval) {
+    put_keyframe(t, proc, tag_checkpoint);
+  }
+
+  int op[2];
+  int address[2];
+  int count = execute(proc, op, address);
+
+  uint8_t flags = 0;
+  if (2 == count) {
+    flags |= step_two;
+  }
+  if (proc->accumulator != before.accumulator) {
+    flags |= step_accumulator;
+  }
+  if (proc->auxiliary_register != before.auxiliary_register) {
+    flags |= step_auxiliary;
+  }
+  if (proc->overflow != before.overflow) {
+    flags |= step_overflow;
+  }
+  if (0 != t->store_count) {
+    flags |= step_stores;
+  }
+  for (int i = 0; i < count; ++i) {
+    if (external(op[i])) {
+      flags |= step_external;
+    }
+  }
+  if (t->lost) {
+    flags |= step_external; // a replay loads the next keyframe
+  }
+
+  put_byte(t, flags);
+  put_signed(t, before.program_counter - t->record_pc);
+  t->record_pc = before.program_counter;
+  for (int i = 0; i < count; ++i) {
+    put_unsigned(t, (uint64_t)op[i] << 13 | address[i]);
+  }
+  if (0 != (flags & step_accumulator)) {
+    put_word(t, difference(proc->accumulator, before.accumulator));
+  }
+  if (0 != (flags & step_auxiliary)) {
+    put_word(
+      t, difference(proc->auxiliary_register, before.auxiliary_register));
+  }
+  if (0 != (flags & step_stores)) {
+    put_unsigned(t, t->store_count);
+    for (size_t i = 0; i < t->store_count; ++i) {
+      put_unsigned(t, t->stores[i].address);
+      put_word(t, t->stores[i].value);
+    }
+  }
+  if (0 != (flags & step_external)) {
+    put_unsigned(t, proc->b_addr);
+    if (0 != proc->b_addr) {
+      put_word(t, proc->b_data);
+    }
+  }
+
+  registers_save(proc, &t->after);
+  t->changed = t->lost;
+}
+
+// write each queued chunk to the file
+static void *writer(void *arg) {
+
+  trace_t *t = arg;
+  pthread_mutex_lock(&t->lock);
+  for (;;) {
+    while (NULL == t->head && !t->closing) {
+      pthread_cond_wait(&t->work, &t->lock);
+    }
+    chunk_t *c = t->head;
+    if (NULL == c) {
+      break;
+    }
+    t->head = c->next;
+    if (NULL == t->head) {
+      t->tail = NULL;
+    }
+    bool failed = t->failed;
+    pthread_mutex_unlock(&t->lock);
+
+    if (!failed && c->used != fwrite(c->data, 1, c->used, t->file)) {
+      failed = true;
+    }
+
+    pthread_mutex_lock(&t->lock);
+    t->failed = failed;
+    c->next = t->spare;
+    t->spare = c;
+    pthread_cond_signal(&t->space);
+  }
+  pthread_mutex_unlock(&t->lock);
+  return NULL;
+}
+
+static void release(trace_t *t) {
+  free(t->chunk);
+  while (NULL != t->spare) {
+    chunk_t *c = t->spare;
+    t->spare = c->next;
+    free(c);
+  }
+  free(t->keyframes);
+  free(t->stores);
+  free(t->filename);
+  free(t);
+}
+
+bool trace_start(processor_t *proc, const char *filename) {
+
+  trace_t *t = calloc(1, sizeof(trace_t));
+  if (NULL == t) {
+    return false;
+  }
+  t->filename = strdup(filename);
+  t->chunk = malloc(sizeof(chunk_t));
+  if (NULL == t->filename || NULL == t->chunk) {
+    release(t);
+    errno = ENOMEM;
+    return false;
+  }
+  t->chunk->used = 0;
+  t->chunks = 1;
+  t->file = fopen(filename, "wb");
+  if (NULL == t->file) {
+    release(t);
+    return false;
+  }
+  pthread_mutex_init(&t->lock, NULL);
+  pthread_cond_init(&t->work, NULL);
+  pthread_cond_init(&t->space, NULL);
+  int rc = pthread_create(&t->thread, NULL, writer, t);
+  if (0 != rc) {
+    pthread_cond_destroy(&t->space);
+    pthread_cond_destroy(&t->work);
+    pthread_mutex_destroy(&t->lock);
+    fclose(t->file);
+    release(t);
+    errno = rc;
+    return false;
+  }
+
+  for (size_t i = 0; i < sizeof(trace_magic); ++i) {
+    put_byte(t, trace_magic[i]);
+  }
+  t->changed = true; // the first step starts with the state
+  proc->trace = t;
+  return true;
+}
+
+bool trace_stop(processor_t *proc) {
+
+  trace_t *t = proc->trace;
+  if (NULL == t) {
+    return true;
+  }
+  proc->trace = NULL;
+
+  // the index of keyframes and, fixed size at the very end, where it is
+  int64_t end = t->offset;
+  put_byte(t, tag_end);
+  put_unsigned(t, t->keyframe_count);
+  for (size_t i = 0; i < t->keyframe_count; ++i) {
+    put_unsigned(t, t->keyframes[i].instructions);
+    put_unsigned(t, t->keyframes[i].offset);
+  }
+  for (int i = 0; i < 8; ++i) {
+    put_byte(t, (uint8_t)(end >> (8 * i)));
+  }
+  for (size_t i = 0; i < sizeof(index_magic); ++i) {
+    put_byte(t, index_magic[i]);
+  }
+
+  enqueue(t);
+  pthread_mutex_lock(&t->lock);
+  t->closing = true;
+  pthread_cond_signal(&t->work);
+  pthread_mutex_unlock(&t->lock);
+  pthread_join(t->thread, NULL);
+
+  bool ok = !t->failed;
+  if (0 != fclose(t->file)) {
+    ok = false;
+  }
+  pthread_cond_destroy(&t->space);
+  pthread_cond_destroy(&t->work);
+  pthread_mutex_destroy(&t->lock);
+  release(t);
+  return ok;
+}
+
+void trace_destroy(processor_t *proc) { trace_stop(proc); }
+
+const char *trace_filename(processor_t *proc) {
+  return NULL == proc->trace ? NULL : proc->trace->filename;
+}
+
+int64_t trace_bytes(processor_t *proc) {
+  return NULL == proc->trace ? 0 : proc->trace->offset;
+}
+
+// reading
+
+typedef struct {
+  FILE *in;
+  bool error; // end of file or a malformed value
+} reader_t;
+
+static int get_byte(reader_t *r) {
+  int c = getc(r->in);
+  if (EOF == c) {
+    r->error = true;
+    return 0;
+  }
+  return c;
+}
+
+static uint64_t get_unsigned(reader_t *r) {
+  uint64_t v = 0;
+  for (int shift = 0; shift < 64; shift += 7) {
+    int c = getc(r->in);
+    if (EOF == c) {
+      break;
+    }
+    v |= (uint64_t)(c & 0x7f) << shift;
+    if (0 == (c & 0x80)) {
+      return v;
+    }
+  }
+  r->error = true;
+  return 0;
+}
+
+static int64_t get_signed(reader_t *r) { return unzigzag(get_unsigned(r)); }
+
+static int64_t get_word(reader_t *r) {
+  uint64_t v = get_unsigned(r);
+  if (0 != (v & 1)) {
+    return (int64_t)get_unsigned(r);
+  }
+  return (int64_t)((uint64_t)unzigzag(v >> 1) << word_shift);
+}
+
+// registers and store of a keyframe
+static void get_keyframe(reader_t *r, registers_t *k, int64_t *store) {
+  k->instructions = (int64_t)get_unsigned(r);
+  k->program_counter = (int)get_unsigned(r);
+  k->accumulator = get_word(r);
+  k->auxiliary_register = get_word(r);
+  k->overflow = 0 != get_byte(r);
+  k->b_addr = (int)get_unsigned(r);
+  k->b_data = get_word(r);
+  for (int i = 0; i < memory_size; ++i) {
+    store[i] = get_word(r);
+  }
+}
+
+// the offset of the last keyframe at or before an instruction count,
+// from the index at the end; the start if there is none
+static int64_t find_keyframe(FILE *in, int64_t instruction) {
+
+  int64_t start = sizeof(trace_magic);
+  uint8_t trailer[trailer_size];
+  if (0 != fseeko(in, -trailer_size, SEEK_END) ||
+      1 != fread(trailer, sizeof(trailer), 1, in) ||
+      0 != memcmp(&trailer[8], index_magic, sizeof(index_magic))) {
+    return start; // not finished, so replay it all
+  }
+  int64_t end = 0;
+  for (int i = 7; i >= 0; --i) {
+    end = end << 8 | trailer[i];
+  }
+  reader_t r = {.in = in};
+  if (0 != fseeko(in, end, SEEK_SET) || tag_end != get_byte(&r)) {
+    return start;
+  }
+  uint64_t count = get_unsigned(&r);
+  for (uint64_t i = 0; i < count && !r.error; ++i) {
+    int64_t instructions = (int64_t)get_unsigned(&r);
+    int64_t offset = (int64_t)get_unsigned(&r);
+    if (instructions > instruction) {
+      break;
+    }
+    if (!r.error) {
+      start = offset;
+    }
+  }
+  return start;
+}
+
+// replay
+
+// a step as read from the trace
+typedef struct {
+  uint8_t flags;              // the tag
+  int program_counter;        //
+  int count;                  // instructions executed
+  int op[2];                  //
+  int address[2];             //
+  int64_t accumulator;        // change
+  int64_t auxiliary_register; // change
+  size_t store_count;         //
+  int b_addr;                 // afterwards, if external
+  int64_t b_data;             //
+  int64_t instruction;        // the number of the first instruction
+} step_t;
+
+typedef struct {
+  processor_t *proc;
+  trace_t collect;   // the stores of each replayed step
+  store_t *stores;   // the stores of the recorded step
+  size_t store_size; //
+  step_t last;       // the step before the current record
+  bool started;      // a keyframe was loaded
+  bool pc_unknown;   // after an external step until the next record
+  FILE *out;         //
+} replay_t;
+
+// describe the instructions of the last step
+static void describe(replay_t *rp) {
+  const step_t *s = &rp->last;
+  if (0 == s->count) {
+    fprintf(rp->out, "trace diverges before the first instruction\n");
+    return;
+  }
+  fprintf(rp->out,
+          "trace diverges at instruction %" PRId64 ", %d.%d ",
+          s->instruction,
+          s->program_counter >> 1,
+          5 * (s->program_counter & 1));
+  for (int i = 0; i < s->count; ++i) {
+    fprintf(rp->out, " %02o %4d", s->op[i], s->address[i]);
+  }
+  fprintf(rp->out, "\n");
+}
+
+static bool diverged(replay_t *rp,
+                     const char *what,
+                     int64_t expected,
+                     int64_t actual) {
+  describe(rp);
+  fprintf(rp->out,
+          "  %s expected %+" PRId64 " got %+" PRId64 "\n",
+          what,
+          expected,
+          actual);
+  return false;
+}
+
+// a word, shown as the integer in its 39 bits unless any low bit is set
+static bool word_diverged(replay_t *rp,
+                          const char *what,
+                          int64_t expected,
+                          int64_t actual) {
+  if (0 != ((expected | actual) & (((int64_t)1 << word_shift) - 1))) {
+    describe(rp);
+    fprintf(rp->out,
+            "  %s expected %016" PRIx64 " got %016" PRIx64 "\n",
+            what,
+            (uint64_t)expected,
+            (uint64_t)actual);
+    return false;
+  }
+  return diverged(rp, what, expected >> word_shift, actual >> word_shift);
+}
+
+static bool pc_diverged(replay_t *rp, int expected, int actual) {
+  describe(rp);
+  fprintf(rp->out,
+          "  program counter expected %d.%d got %d.%d\n",
+          expected >> 1,
+          5 * (expected & 1),
+          actual >> 1,
+          5 * (actual & 1));
+  return false;
+}
+
+// load a keyframe, or check it against the replayed state
+static bool keyframe(replay_t *rp,
+                     const registers_t *k,
+                     const int64_t *store,
+                     bool load) {
+
+  processor_t *proc = rp->proc;
+  if (rp->pc_unknown) {
+    proc->program_counter = k->program_counter;
+    rp->pc_unknown = false;
+  }
+  if (!load) {
+    if (k->program_counter != proc->program_counter) {
+      return pc_diverged(rp, k->program_counter, proc->program_counter);
+    }
+    if (k->instructions != proc->instructions) {
+      return diverged(
+        rp, "instruction count", k->instructions, proc->instructions);
+    }
+    if (k->accumulator != proc->accumulator) {
+      return word_diverged(rp,
+                           "accumulator",
+                           k->accumulator,
+                           proc->accumulator);
+    }
+    if (k->auxiliary_register != proc->auxiliary_register) {
+      return word_diverged(rp,
+                           "auxiliary register",
+                           k->auxiliary_register,
+                           proc->auxiliary_register);
+    }
+    if (k->overflow != proc->overflow) {
+      return diverged(rp, "overflow", k->overflow, proc->overflow);
+    }
+    if (k->b_addr != proc->b_addr) {
+      return diverged(rp, "B register", k->b_addr >> 1, proc->b_addr >> 1);
+    }
+    if (0 != k->b_addr && k->b_data != proc->b_data) {
+      return word_diverged(rp, "B register", k->b_data, proc->b_data);
+    }
+    for (int i = 0; i < memory_size; ++i) {
+      if (store[i] != proc->core_store[i]) {
+        char what[32];
+        snprintf(what, sizeof(what), "store %d", i);
+        return word_diverged(rp, what, store[i], proc->core_store[i]);
+      }
+    }
+    return true;
+  }
+
+  core_write_block(proc, 0, store, memory_size);
+  proc->instructions = k->instructions;
+  proc->accumulator = k->accumulator;
+  proc->auxiliary_register = k->auxiliary_register;
+  proc->overflow = k->overflow;
+  proc->b_addr = 0;
+  if (0 != k->b_addr) {
+    proc->program_counter = k->b_addr;
+    cpu803_load_b(proc, k->b_data);
+  }
+  proc->program_counter = k->program_counter;
+  rp->started = true;
+  return true;
+}
+
+// read the rest of a step record after its flags, false if out of
+// memory
+static bool get_step(reader_t *r, replay_t *rp, step_t *s) {
+
+  s->program_counter += (int)get_signed(r);
+  s->count = 0 != (s->flags & step_two) ? 2 : 1;
+  for (int i = 0; i < s->count; ++i) {
+    uint64_t v = get_unsigned(r);
+    s->op[i] = (int)(v >> 13) & op_bits;
+    s->address[i] = (int)v & address_bits;
+  }
+  s->accumulator = 0;
+  if (0 != (s->flags & step_accumulator)) {
+    s->accumulator = get_word(r);
+  }
+  s->auxiliary_register = 0;
+  if (0 != (s->flags & step_auxiliary)) {
+    s->auxiliary_register = get_word(r);
+  }
+  s->store_count = 0;
+  if (0 != (s->flags & step_stores)) {
+    s->store_count = (size_t)get_unsigned(r);
+    if (s->store_count > memory_size) {
+      r->error = true; // more than a step could store
+      s->store_count = 0;
+    }
+    if (s->store_count > rp->store_size) {
+      store_t *stores = realloc(rp->stores, s->store_count * sizeof(store_t));
+      if (NULL == stores) {
+        return false;
+      }
+      rp->stores = stores;
+      rp->store_size = s->store_count;
+    }
+    for (size_t i = 0; i < s->store_count && !r->error; ++i) {
+      rp->stores[i].address = (int)get_unsigned(r) & address_bits;
+      rp->stores[i].value = get_word(r);
+    }
+  }
+  if (0 != (s->flags & step_external)) {
+    s->b_addr = (int)get_unsigned(r);
+    s->b_data = 0 != s->b_addr ? get_word(r) : 0;
+  }
+  return true;
+}
+
+// repeat the recorded effects of a step that used a peripheral
+static void apply(replay_t *rp, const step_t *s) {
+  processor_t *proc = rp->proc;
+  proc->instructions += s->count;
+  proc->accumulator = (int64_t)((uint64_t)proc->accumulator + s->accumulator);
+  proc->auxiliary_register =
+    (int64_t)((uint64_t)proc->auxiliary_register + s->auxiliary_register);
+  if (0 != (s->flags & step_overflow)) {
+    proc->overflow = !proc->overflow;
+  }
+  for (size_t i = 0; i < s->store_count; ++i) {
+    core_write(proc, rp->stores[i].address, rp->stores[i].value);
+  }
+  proc->b_addr = 0;
+  if (0 != s->b_addr) {
+    proc->program_counter = s->b_addr;
+    cpu803_load_b(proc, s->b_data);
+  }
+  rp->pc_unknown = true; // until the next record
+}
+
+// execute a step and check it does what was recorded
+static bool check(replay_t *rp, const step_t *s) {
+
+  processor_t *proc = rp->proc;
+  registers_t before;
+  registers_save(proc, &before);
+  proc->mode = exec_mode_run;
+  int op[2];
+  int address[2];
+  int count = execute(proc, op, address);
+
+  if (count != s->count) {
+    return diverged(rp, "instructions executed", s->count, count);
+  }
+  for (int i = 0; i < count; ++i) {
+    if (op[i] != s->op[i]) {
+      return diverged(rp, "function", s->op[i], op[i]);
+    }
+    if (address[i] != s->address[i]) {
+      return diverged(rp, "address", s->address[i], address[i]);
+    }
+  }
+  int64_t accumulator =
+    (int64_t)((uint64_t)before.accumulator + s->accumulator);
+  if (accumulator != proc->accumulator) {
+    return word_diverged(rp, "accumulator", accumulator, proc->accumulator);
+  }
+  int64_t auxiliary =
+    (int64_t)((uint64_t)before.auxiliary_register + s->auxiliary_register);
+  if (auxiliary != proc->auxiliary_register) {
+    return word_diverged(rp,
+                         "auxiliary register",
+                         auxiliary,
+                         proc->auxiliary_register);
+  }
+  bool overflow = before.overflow != (0 != (s->flags & step_overflow));
+  if (overflow != proc->overflow) {
+    return diverged(rp, "overflow", overflow, proc->overflow);
+  }
+  if (rp->collect.lost) {
+    fprintf(rp->out, "trace replay out of memory\n");
+    return false;
+  }
+  if (s->store_count != rp->collect.store_count) {
+    return diverged(
+      rp, "words stored", s->store_count, rp->collect.store_count);
+  }
+  for (size_t i = 0; i < s->store_count; ++i) {
+    const store_t *e = &rp->stores[i];
+    const store_t *a = &rp->collect.stores[i];
+    if (e->address != a->address) {
+      return diverged(rp, "store address", e->address, a->address);
+    }
+    if (e->value != a->value) {
+      char what[32];
+      snprintf(what, sizeof(what), "store %d", e->address);
+      return word_diverged(rp, what, e->value, a->value);
+    }
+  }
+  return true;
+}
+
+static bool replay(reader_t *r, replay_t *rp, int64_t *store) {
+
+  processor_t *proc = rp->proc;
+  step_t s = {0};
+  int64_t keyframes = 0;
+  int64_t first = -1;
+  bool truncated = false; // by the emulator exiting while tracing
+  int64_t record = 0;
+  for (;;) {
+    record = ftello(r->in);
+    int tag = getc(r->in);
+    if (EOF == tag) {
+      truncated = true;
+      break;
+    }
+    if (tag_end == tag) {
+      break;
+    }
+
+    if (tag_checkpoint == tag || tag_state == tag) {
+      registers_t k;
+      get_keyframe(r, &k, store);
+      if (r->error) {
+        truncated = true;
+        break;
+      }
+      if (!keyframe(rp, &k, store, tag_state == tag || !rp->started)) {
+        return false;
+      }
+      if (first < 0) {
+        first = proc->instructions;
+      }
+      s.program_counter = k.program_counter;
+      ++keyframes;
+      continue;
+    }
+
+    if (0 != (tag & 0x80) || !rp->started) {
+      fprintf(rp->out, "trace record at %" PRId64 " is not valid\n", record);
+      return false;
+    }
+    s.flags = (uint8_t)tag;
+    if (!get_step(r, rp, &s)) {
+      fprintf(rp->out, "trace replay out of memory\n");
+      return false;
+    }
+    if (r->error) {
+      truncated = true;
+      break;
+    }
+
+    if (rp->pc_unknown) {
+      proc->program_counter = s.program_counter;
+      rp->pc_unknown = false;
+    } else if (s.program_counter != proc->program_counter) {
+      return pc_diverged(rp, s.program_counter, proc->program_counter);
+    }
+    s.instruction = proc->instructions + 1;
+    rp->last = s;
+    if (0 != (s.flags & step_external)) {
+      apply(rp, &s);
+    } else if (!check(rp, &s)) {
+      return false;
+    }
+  }
+
+  if (truncated && !feof(r->in)) {
+    fprintf(rp->out, "trace record at %" PRId64 " is not valid\n", record);
+    return false;
+  }
+  fprintf(rp->out,
+          "trace matches: %" PRId64 " instructions from %" PRId64
+          ", %" PRId64 " keyframes%s\n",
+          proc->instructions - (first < 0 ? 0 : first),
+          first < 0 ? 0 : first,
+          keyframes,
+          truncated ? ", then it is truncated" : "");
+  return true;
+}
+
+bool trace_replay(FILE *in, int64_t instruction, FILE *out) {
+
+  char magic[sizeof(trace_magic)];
+  if (1 != fread(magic, sizeof(magic), 1, in) ||
+      0 != memcmp(magic, trace_magic, sizeof(magic))) {
+    fprintf(out, "not a trace file\n");
+    return false;
+  }
+  int64_t start = find_keyframe(in, instruction);
+  if (0 != fseeko(in, start, SEEK_SET)) {
+    fprintf(out, "trace seek failed: %s\n", strerror(errno));
+    return false;
+  }
+
+  replay_t rp = {
+    .proc = calloc(1, sizeof(processor_t)),
+    .out = out,
+  };
+  int64_t *store = malloc(memory_size * sizeof(int64_t));
+  bool ok = false;
+  if (NULL == rp.proc || NULL == store) {
+    fprintf(out, "trace replay out of memory\n");
+  } else {
+    rp.proc->trace = &rp.collect;
+    reader_t r = {.in = in};
+    ok = replay(&r, &rp, store);
+    rp.proc->trace = NULL;
+  }
+  free(store);
+  free(rp.stores);
+  free(rp.collect.stores);
+  free(rp.proc);
+  return ok;
+}
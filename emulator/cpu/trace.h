@@ -0,0 +1,67 @@
+// trace.h
+
+#if !defined(TRACE_H)
+#define TRACE_H 1
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "processor.h"
+
+// a binary record of every instruction executed, to find where two
+// engines or two builds part company
+//
+// the file starts with a magic string and each record starts with a
+// tag byte; integers are LEB128 varints, signed ones zigzag encoded and
+// words shifted down to their 39 bits, so most records are a few bytes
+//
+//   step:       flags (below 0x80), the program counter as a change
+//               from the previous record, op << 13 | address of each
+//               instruction, then as flagged the change of A and AR,
+//               the overflow toggled, the words stored and, for a step
+//               that used a peripheral, the B register afterwards
+//   checkpoint: 0x80 then the whole state before the next step, which
+//               a replay checks
+//   state:      0x81 the same, set from outside (e.g. a command) so a
+//               replay loads it
+//   end:        0xc0, the instruction count and offset of each
+//               keyframe, then the offset of the end record and a
+//               second magic string, so a reader can seek from the end
+//
+// the address of a B-modified instruction is worked out with the
+// modifier as it was before the word executed; the processor thread
+// only fills memory chunks and a writer thread does the file I/O
+
+typedef struct trace_struct trace_t;
+
+enum {
+  trace_keyframe_interval = 1 << 20, // instructions between checkpoints
+};
+
+// create a trace file and record every step from now on
+bool trace_start(processor_t *proc, const char *filename);
+
+// finish the trace file, false if it could not all be written
+bool trace_stop(processor_t *proc);
+
+// stop tracing, before the processor is freed
+void trace_destroy(processor_t *proc);
+
+// the file being written, and bytes recorded so far
+const char *trace_filename(processor_t *proc);
+int64_t trace_bytes(processor_t *proc);
+
+// execute a word as cpu803_execute and record what it did
+void trace_execute(processor_t *proc);
+
+// a word of the store was changed
+void trace_store(processor_t *proc, int address);
+
+// replay a trace from the last keyframe at or before an instruction
+// count on a new processor, checking each step; writes the first
+// divergence or a summary to out and returns false on a divergence or
+// an unreadable trace
+bool trace_replay(FILE *in, int64_t instruction, FILE *out);
+
+#endif
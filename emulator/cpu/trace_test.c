@@ -0,0 +1,157 @@
+// trace_test.c
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "constants.h"
+#include "core.h"
+#include "cpu803.h"
+#include "processor.h"
+#include "trace.h"
+
+#define INT803(x) ((int64_t)(x) << word_shift)
+
+static void check(const char *title, bool ok) {
+  if (!ok) {
+    printf("failed: %s\n", title);
+    exit(1);
+  }
+}
+
+// run until the machine stops, tracing each word; at step poke, if
+// not negative, change the store behind the trace's back
+static void run(processor_t *proc, int address, int poke) {
+  proc->program_counter = address << 1;
+  proc->mode = exec_mode_run;
+  for (int i = 0; i < 1000000 && exec_mode_run == proc->mode; ++i) {
+    if (i == poke) {
+      proc->core_store[4212] = INT803(99);
+    }
+    trace_execute(proc);
+  }
+  check("stopped", exec_mode_stop == proc->mode);
+}
+
+// replay a trace, returning the result and the first line written
+static bool replay(const char *filename, int64_t instruction, char *line) {
+  FILE *in = fopen(filename, "rb");
+  FILE *out = tmpfile();
+  check("open", NULL != in && NULL != out);
+  bool ok = trace_replay(in, instruction, out);
+  rewind(out);
+  check("output", NULL != fgets(line, 256, out));
+  fclose(out);
+  fclose(in);
+  return ok;
+}
+
+// count down a B-modified table lookup, then read the word generator
+static void load(processor_t *proc) {
+  core_write(proc, 4096, ELLIOTT(030, 4200, 0, 005, 4201));
+  core_write(proc, 4097, ELLIOTT(020, 4200, 1, 030, 4210));
+  core_write(proc, 4098, ELLIOTT(014, 4202, 0, 030, 4200));
+  core_write(proc, 4099, ELLIOTT(041, 4101, 0, 040, 4096));
+  core_write(proc, 4101, ELLIOTT(070, 0, 0, 052, 4201));
+  core_write(proc, 4102, ELLIOTT(020, 4203, 0, 040, 4103));
+  core_write(proc, 4103, ELLIOTT(040, 4103, 0, 000, 0));
+  for (int i = 0; i < 6; ++i) {
+    core_write(proc, 4209 + i, INT803(10 * i + 1));
+  }
+  core_write(proc, 4200, INT803(5));
+  core_write(proc, 4201, INT803(1));
+  proc->word_generator = INT803(3);
+}
+
+int main(int argc, char *argv[]) {
+
+  processor_t *proc = calloc(1, sizeof(processor_t));
+  check("calloc", NULL != proc);
+
+  char filename[] = "/tmp/trace_test.XXXXXX";
+  int fd = mkstemp(filename);
+  check("mkstemp", -1 != fd);
+  close(fd);
+  char line[256];
+
+  // the trace replays, including a change made between runs
+  load(proc);
+  check("start", trace_start(proc, filename));
+  run(proc, 4096, -1);
+  check("read", 1 == proc->wg_polls);
+  core_write(proc, 4201, INT803(2));
+  core_write(proc, 4200, INT803(4));
+  proc->accumulator = INT803(-7);
+  run(proc, 4096, -1);
+  check("traced", trace_bytes(proc) > 2 * memory_size);
+  check("stop", trace_stop(proc));
+  check("replay", replay(filename, 0, line));
+  check("matches", 0 == strncmp("trace matches: ", line, 15));
+
+  // a word changed without the trace knowing shows as a divergence at
+  // the instruction that reads it
+  memset(proc, 0, sizeof(processor_t));
+  load(proc);
+  check("restart", trace_start(proc, filename));
+  run(proc, 4096, 4);
+  check("stop again", trace_stop(proc));
+  check("diverges", !replay(filename, 0, line));
+  check("where",
+        NULL != strstr(line, "at instruction 19, 4097.0  20 4200 30 4212"));
+
+  // count down over a million instructions and seek to a checkpoint
+  memset(proc, 0, sizeof(processor_t));
+  core_write(proc, 4096, ELLIOTT(030, 4200, 0, 005, 4201));
+  core_write(proc, 4097, ELLIOTT(020, 4200, 0, 041, 4099));
+  core_write(proc, 4098, ELLIOTT(040, 4096, 0, 000, 0));
+  core_write(proc, 4099, ELLIOTT(040, 4099, 0, 000, 0));
+  core_write(proc, 4200, INT803(250000));
+  core_write(proc, 4201, INT803(1));
+  check("long start", trace_start(proc, filename));
+  run(proc, 4096, -1);
+  check("long stop", trace_stop(proc));
+  int64_t seek = trace_keyframe_interval + 1000;
+  check("seek", replay(filename, seek, line));
+  int64_t count = 0;
+  int64_t from = 0;
+  int keyframes = 0;
+  check("summary",
+        3 == sscanf(line,
+                    "trace matches: %" SCNd64 " instructions from %" SCNd64
+                    ", %d keyframes",
+                    &count,
+                    &from,
+                    &keyframes));
+  check("from checkpoint", from >= trace_keyframe_interval && from <= seek);
+  check("to the end", from + count == proc->instructions);
+  check("one keyframe", 1 == keyframes);
+  check("whole", replay(filename, 0, line));
+  check("both keyframes", NULL != strstr(line, " from 0, 2 keyframes"));
+
+  // running off the top of store into the initial instructions
+  memset(proc, 0, sizeof(processor_t));
+  core_write(proc, 8191, ELLIOTT(022, 4200, 0, 022, 4200));
+  check("top start", trace_start(proc, filename));
+  proc->program_counter = 8191 << 1;
+  proc->mode = exec_mode_run;
+  trace_execute(proc);
+  trace_execute(proc);
+  check("top executed", 4 == proc->instructions);
+  check("top stop", trace_stop(proc));
+  check("top replay", replay(filename, 0, line));
+  check("top matches", NULL != strstr(line, "trace matches: 4 "));
+
+  // not a trace
+  FILE *f = fopen(filename, "wb");
+  check("rewrite", NULL != f && 1 == fwrite("E803", 4, 1, f));
+  fclose(f);
+  check("invalid", !replay(filename, 0, line));
+
+  unlink(filename);
+  free(proc);
+  return 0;
+}
@@ -0,0 +1,684 @@
+// daemon.c
+
+#include <errno.h>
+#include <inttypes.h>
+#include <locale.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "batch.h"
+#include "cpu/elliott803.h"
+#include "daemon.h"
+#include "pathsearch.h"
+
+#if !defined(SizeOfArray)
+#define SizeOfArray(a) (sizeof(a) / sizeof((a)[0]))
+#endif
+
+enum {
+  daemon_pools = 8,              // compilers or other warm states
+  daemon_workers = 64,           // jobs run at once
+  daemon_queue = 64,             // connections waiting for a worker
+  daemon_request_size = 65536,   // largest script accepted
+  daemon_recent = 1024,          // latest jobs kept for percentiles
+  daemon_timeout = 5,            // seconds allowed to send a request
+  daemon_job_limit = 1000000000, // instructions a job may execute
+};
+
+// latency of the jobs of one pool in microseconds
+typedef struct {
+  int64_t jobs;
+  int64_t failed;
+  int64_t queue_total;
+  int64_t queue_max;
+  int64_t run_total;
+  int64_t run_max;
+  int64_t recent[daemon_recent]; // queue plus run of the latest jobs
+} latency_t;
+
+typedef struct {
+  char name[64];
+  elliott803_t *warm;   // state each job starts from, never runs a job
+  pthread_mutex_t lock; // one clone at a time, its channel is one client
+  latency_t latency;    // protected by the daemon lock
+} pool_t;
+
+typedef struct {
+  int fd;
+  int64_t accepted; // when the connection was accepted
+} connection_t;
+
+typedef struct {
+  pool_t pool[daemon_pools];
+  int pools;
+
+  pthread_mutex_t lock; // the queue, stopping and latencies
+  pthread_cond_t ready; // a connection was queued or stopping was set
+  connection_t queue[daemon_queue];
+  int head;
+  int count;
+  bool stopping;
+} daemon_t;
+
+typedef struct {
+  daemon_t *d;
+  pthread_t thread;
+  elliott803_t *machine[daemon_pools]; // a clone of each warm machine
+} worker_t;
+
+// microseconds from an arbitrary start
+static int64_t now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000000LL + ts.tv_nsec / 1000;
+}
+
+// write everything, false if the client has gone
+static bool send_all(int fd, const void *data, size_t size) {
+  const char *p = data;
+  while (size > 0) {
+    ssize_t n = send(fd, p, size, MSG_NOSIGNAL);
+    if (-1 == n && EINTR == errno) {
+      continue;
+    }
+    if (n <= 0) {
+      return false;
+    }
+    p += n;
+    size -= n;
+  }
+  return true;
+}
+
+static bool
+send_section(int fd, const char *title, const char *data, size_t size) {
+  char header[128];
+  int n = snprintf(header, sizeof(header), "%s %zu\n", title, size);
+  return send_all(fd, header, n) && send_all(fd, data, size);
+}
+
+// the text of each screen and the messages of a job
+typedef struct {
+  FILE *f[4];
+  char *data[4];
+  size_t size[4];
+} job_output_t;
+
+static bool open_output(job_output_t *o) {
+  memset(o, 0, sizeof(*o));
+  for (size_t i = 0; i < SizeOfArray(o->f); ++i) {
+    o->f[i] = open_memstream(&o->data[i], &o->size[i]);
+    if (NULL == o->f[i]) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// close the streams, after which the data is complete
+static void close_output(job_output_t *o) {
+  for (size_t i = 0; i < SizeOfArray(o->f); ++i) {
+    if (NULL != o->f[i]) {
+      fclose(o->f[i]);
+      o->f[i] = NULL;
+    }
+  }
+}
+
+static void release_output(job_output_t *o) {
+  close_output(o);
+  for (size_t i = 0; i < SizeOfArray(o->data); ++i) {
+    free(o->data[i]);
+    o->data[i] = NULL;
+  }
+}
+
+static void send_reply(int fd,
+                       job_output_t *o,
+                       const char *status,
+                       int64_t queue_time,
+                       int64_t run_time) {
+  close_output(o);
+  static const char *titles[] = {
+    "screen 1",
+    "screen 2",
+    "screen 3",
+    "messages",
+  };
+  for (size_t i = 0; i < SizeOfArray(titles); ++i) {
+    if (!send_section(fd, titles[i], o->data[i], o->size[i])) {
+      return;
+    }
+  }
+  char line[128];
+  int n = snprintf(line,
+                   sizeof(line),
+                   "status %s queue %" PRId64 " run %" PRId64 "\n",
+                   status,
+                   queue_time,
+                   run_time);
+  send_all(fd, line, n);
+}
+
+// read until the client shuts down its side, NULL on error
+static char *receive_request(int fd, size_t *size, const char **error) {
+  char *request = malloc(daemon_request_size + 1);
+  if (NULL == request) {
+    *error = "error: out of memory";
+    return NULL;
+  }
+  size_t n = 0;
+  for (;;) {
+    ssize_t k = recv(fd, &request[n], daemon_request_size + 1 - n, 0);
+    if (-1 == k && EINTR == errno) {
+      continue;
+    }
+    if (k < 0) {
+      *error = "error: request not received";
+      free(request);
+      return NULL;
+    }
+    if (0 == k) {
+      break;
+    }
+    n += k;
+    if (n > daemon_request_size) {
+      *error = "error: request too large";
+      free(request);
+      return NULL;
+    }
+  }
+  request[n] = '\0';
+  *size = n;
+  return request;
+}
+
+static int compare(const void *a, const void *b) {
+  int64_t x = *(const int64_t *)(a);
+  int64_t y = *(const int64_t *)(b);
+  return (x > y) - (x < y);
+}
+
+// one line for each pool, times in milliseconds
+static void report_latency(daemon_t *d, FILE *f) {
+  static int64_t sorted[daemon_recent];
+  pthread_mutex_lock(&d->lock);
+  for (int i = 0; i < d->pools; ++i) {
+    const latency_t *l = &d->pool[i].latency;
+    size_t n = l->jobs < daemon_recent ? l->jobs : daemon_recent;
+    memcpy(sorted, l->recent, n * sizeof(int64_t));
+    qsort(sorted, n, sizeof(int64_t), compare);
+    int64_t jobs = 0 == l->jobs ? 1 : l->jobs;
+    int64_t p50 = 0 == n ? 0 : sorted[n / 2];
+    int64_t p95 = 0 == n ? 0 : sorted[n * 95 / 100];
+    fprintf(f,
+            "pool %s jobs %" PRId64 " failed %" PRId64
+            " queue mean %.3f max %.3f run mean %.3f max %.3f"
+            " total p50 %.3f p95 %.3f ms\n",
+            d->pool[i].name,
+            l->jobs,
+            l->failed,
+            l->queue_total / jobs / 1000.0,
+            l->queue_max / 1000.0,
+            l->run_total / jobs / 1000.0,
+            l->run_max / 1000.0,
+            p50 / 1000.0,
+            p95 / 1000.0);
+  }
+  pthread_mutex_unlock(&d->lock);
+}
+
+static void record_latency(daemon_t *d,
+                           pool_t *pool,
+                           bool ok,
+                           int64_t queue_time,
+                           int64_t run_time) {
+  pthread_mutex_lock(&d->lock);
+  latency_t *l = &pool->latency;
+  l->recent[l->jobs % daemon_recent] = queue_time + run_time;
+  ++l->jobs;
+  l->failed += ok ? 0 : 1;
+  l->queue_total += queue_time;
+  l->queue_max = queue_time > l->queue_max ? queue_time : l->queue_max;
+  l->run_total += run_time;
+  l->run_max = run_time > l->run_max ? run_time : l->run_max;
+  pthread_mutex_unlock(&d->lock);
+}
+
+// replace a worker's machine with a fresh clone of the warm one
+static void recycle(worker_t *w, int k) {
+  pool_t *pool = &w->d->pool[k];
+  elliott803_destroy(w->machine[k]);
+  w->machine[k] = NULL;
+  pthread_mutex_lock(&pool->lock);
+  if (1 != elliott803_clone(pool->warm, &w->machine[k], 1)) {
+    w->machine[k] = NULL;
+  }
+  pthread_mutex_unlock(&pool->lock);
+}
+
+// wait for the machine's answer to a command, false if it is an error
+// or does not come
+static bool answer(elliott803_t *proc) {
+  int fd = elliott803_get_fd(proc);
+  for (;;) {
+    fd_set fds;
+    FD_ZERO(&fds);
+    FD_SET(fd, &fds);
+    struct timeval timeout = {
+      .tv_sec = daemon_timeout,
+      .tv_usec = 0,
+    };
+    int rc = select(fd + 1, &fds, NULL, NULL, &timeout);
+    if (-1 == rc && EINTR == errno) {
+      continue;
+    }
+    if (rc <= 0) {
+      return false;
+    }
+    char buffer[256];
+    ssize_t n = elliott803_receive(proc, buffer, sizeof(buffer) - 1);
+    if (n > 0) {
+      buffer[n] = '\0';
+      return 0 != strncmp("error", buffer, 5);
+    }
+  }
+}
+
+// stop a job that never halts or waits, as the runner does, so it
+// cannot hold a worker for ever; batch ends it with "event limit"
+static bool limit_job(elliott803_t *proc) {
+  char limit[64];
+  int n = snprintf(limit, sizeof(limit), "limit %d", daemon_job_limit);
+  return elliott803_send(proc, "events limit", 13) > 0 && answer(proc) &&
+         elliott803_send(proc, limit, n + 1) > 0 && answer(proc);
+}
+
+// run one request and reply to it
+static void serve(worker_t *w, const connection_t *c) {
+
+  daemon_t *d = w->d;
+  int64_t started = now();
+  job_output_t o;
+  if (!open_output(&o)) {
+    release_output(&o);
+    return;
+  }
+
+  const char *error = NULL;
+  size_t size = 0;
+  char *request = receive_request(c->fd, &size, &error);
+  if (NULL == request) {
+    fprintf(o.f[3], "%s\n", error);
+    send_reply(c->fd, &o, "failed", started - c->accepted, 0);
+    release_output(&o);
+    return;
+  }
+
+  // the first line selects the pool
+  size_t line = strcspn(request, "\r\n");
+  char *script = &request[line];
+  script += '\0' == *script ? 0 : 1;
+  request[line] = '\0';
+
+  if (0 == strcmp("stats", request)) {
+    report_latency(d, o.f[3]);
+    send_reply(c->fd, &o, "ok", started - c->accepted, 0);
+    release_output(&o);
+    free(request);
+    return;
+  }
+
+  int k = 0;
+  while (k < d->pools && (0 != strncmp("pool ", request, 5) ||
+                          0 != strcmp(d->pool[k].name, &request[5]))) {
+    ++k;
+  }
+  if (k == d->pools) {
+    fprintf(o.f[3], "error: unknown pool: %s\n", request);
+    send_reply(c->fd, &o, "failed", started - c->accepted, 0);
+    release_output(&o);
+    free(request);
+    return;
+  }
+  if (NULL == w->machine[k]) {
+    recycle(w, k);
+  }
+
+  // batch reads wide characters, which a memory stream cannot supply,
+  // and the file is written without giving the stream an orientation
+  bool ok = false;
+  ssize_t script_size = size - (script - request);
+  FILE *f = tmpfile();
+  if (NULL != f && (script_size != write(fileno(f), script, script_size) ||
+                    0 != lseek(fileno(f), 0, SEEK_SET))) {
+    fclose(f);
+    f = NULL;
+  }
+  if (NULL == w->machine[k]) {
+    fprintf(o.f[3], "error: no machine for pool: %s\n", d->pool[k].name);
+  } else if (NULL == f) {
+    fprintf(o.f[3], "error: %s\n", strerror(errno));
+  } else if (!limit_job(w->machine[k])) {
+    fprintf(o.f[3], "error: no limit for pool: %s\n", d->pool[k].name);
+  } else {
+    ok = EXIT_SUCCESS == batch_machine(w->machine[k], f, o.f, o.f[3]);
+  }
+  if (NULL != f) {
+    fclose(f);
+  }
+  fflush(o.f[3]);
+  const char *status = ok ? "ok" : "failed";
+  if (NULL != strstr(o.data[3], "event limit\n")) {
+    status = "timeout";
+  }
+  int64_t finished = now();
+  record_latency(d, &d->pool[k], ok, started - c->accepted, finished - started);
+  send_reply(c->fd, &o, status, started - c->accepted, finished - started);
+  release_output(&o);
+  free(request);
+
+  // the client has its reply, so the next job need not wait for this
+  recycle(w, k);
+}
+
+static void *worker_loop(void *arg) {
+
+  worker_t *w = arg;
+  daemon_t *d = w->d;
+  for (;;) {
+    pthread_mutex_lock(&d->lock);
+    while (0 == d->count && !d->stopping) {
+      pthread_cond_wait(&d->ready, &d->lock);
+    }
+    if (0 == d->count) {
+      pthread_mutex_unlock(&d->lock);
+      return NULL;
+    }
+    connection_t c = d->queue[d->head];
+    d->head = (d->head + 1) % daemon_queue;
+    --d->count;
+    pthread_mutex_unlock(&d->lock);
+
+    serve(w, &c);
+    close(c.fd);
+  }
+}
+
+// run the script of a pool on a new machine
+static bool warm_up(pool_t *pool, const char *arg) {
+
+  const char *equals = strchr(arg, '=');
+  if (NULL == equals || equals == arg ||
+      (size_t)(equals - arg) >= sizeof(pool->name)) {
+    fprintf(stderr, "error: pool must be NAME=SCRIPT: %s\n", arg);
+    return false;
+  }
+  memcpy(pool->name, arg, equals - arg);
+  pool->name[equals - arg] = '\0';
+
+  char filename[1024];
+  if (PS_ok != path_search(filename, sizeof(filename), &equals[1], L"")) {
+    fprintf(stderr, "error: script not found: %s\n", &equals[1]);
+    return false;
+  }
+  FILE *f = fopen(filename, "r");
+  if (NULL == f) {
+    fprintf(stderr, "error: %s: %s\n", filename, strerror(errno));
+    return false;
+  }
+
+  pool->warm = elliott803_create(pool->name);
+  FILE *output[3] = {NULL, NULL, NULL};
+  bool ok = NULL != pool->warm &&
+            EXIT_SUCCESS == batch_machine(pool->warm, f, output, stderr);
+  fclose(f);
+  if (!ok) {
+    fprintf(stderr, "error: pool %s failed to warm up\n", pool->name);
+  }
+  return ok;
+}
+
+static volatile sig_atomic_t stop_signal = 0;
+
+static void stop_handler(int signal) { stop_signal = signal; }
+
+int daemon_serve(const char *socket_path,
+                 int workers,
+                 int argc,
+                 char *argv[]) {
+
+  setlocale(LC_ALL, "");
+
+  if (workers < 1 || workers > daemon_workers) {
+    fprintf(stderr, "error: workers must be 1 to %d\n", daemon_workers);
+    return EXIT_FAILURE;
+  }
+  if (argc < 1 || argc > daemon_pools) {
+    fprintf(stderr, "error: give 1 to %d pools as NAME=SCRIPT\n", daemon_pools);
+    return EXIT_FAILURE;
+  }
+
+  struct sockaddr_un address = {
+    .sun_family = AF_UNIX,
+  };
+  if (strlen(socket_path) >= sizeof(address.sun_path)) {
+    fprintf(stderr, "error: socket path too long: %s\n", socket_path);
+    return EXIT_FAILURE;
+  }
+  strcpy(address.sun_path, socket_path);
+
+  // every thread, including those of the machines, inherits the mask so
+  // only the select below sees the signals
+  sigset_t stop_signals;
+  sigset_t old_mask;
+  sigemptyset(&stop_signals);
+  sigaddset(&stop_signals, SIGINT);
+  sigaddset(&stop_signals, SIGTERM);
+  pthread_sigmask(SIG_BLOCK, &stop_signals, &old_mask);
+  struct sigaction sa;
+  memset(&sa, 0, sizeof(sa));
+  sa.sa_handler = stop_handler;
+  sigaction(SIGINT, &sa, NULL);
+  sigaction(SIGTERM, &sa, NULL);
+
+  static daemon_t d;
+  static worker_t worker[daemon_workers];
+  pthread_mutex_init(&d.lock, NULL);
+  pthread_cond_init(&d.ready, NULL);
+  int rc = EXIT_FAILURE;
+  int listener = -1;
+  int started = 0;
+
+  for (int i = 0; i < argc; ++i) {
+    pthread_mutex_init(&d.pool[i].lock, NULL);
+    d.pools = i + 1;
+    if (!warm_up(&d.pool[i], argv[i])) {
+      goto done;
+    }
+  }
+
+  for (int i = 0; i < workers; ++i) {
+    worker[i].d = &d;
+    for (int k = 0; k < d.pools; ++k) {
+      recycle(&worker[i], k);
+      if (NULL == worker[i].machine[k]) {
+        fprintf(stderr, "error: cannot clone pool %s\n", d.pool[k].name);
+        goto done;
+      }
+    }
+  }
+
+  // replace a socket left by an earlier daemon, but nothing else
+  struct stat st;
+  if (0 == lstat(socket_path, &st) && S_ISSOCK(st.st_mode)) {
+    unlink(socket_path);
+  }
+  listener = socket(AF_UNIX, SOCK_STREAM, 0);
+  mode_t old_umask = umask(077);
+  bool bound =
+    -1 != listener &&
+    0 == bind(listener, (struct sockaddr *)(&address), sizeof(address));
+  umask(old_umask);
+  if (!bound || 0 != listen(listener, daemon_queue)) {
+    fprintf(stderr, "error: %s: %s\n", socket_path, strerror(errno));
+    goto done;
+  }
+
+  for (; started < workers; ++started) {
+    pthread_create(
+      &worker[started].thread, NULL, worker_loop, &worker[started]);
+  }
+  fprintf(stderr, "listening on %s with %d workers\n", socket_path, workers);
+
+  while (0 == stop_signal) {
+    fd_set fds;
+    FD_ZERO(&fds);
+    FD_SET(listener, &fds);
+    int n = pselect(listener + 1, &fds, NULL, NULL, NULL, &old_mask);
+    if (n <= 0) {
+      continue;
+    }
+    int fd = accept(listener, NULL, NULL);
+    if (-1 == fd) {
+      continue;
+    }
+    struct timeval timeout = {
+      .tv_sec = daemon_timeout,
+      .tv_usec = 0,
+    };
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+    pthread_mutex_lock(&d.lock);
+    bool queued = d.count < daemon_queue;
+    if (queued) {
+      d.queue[(d.head + d.count) % daemon_queue] = (connection_t){
+        .fd = fd,
+        .accepted = now(),
+      };
+      ++d.count;
+      pthread_cond_signal(&d.ready);
+    }
+    pthread_mutex_unlock(&d.lock);
+    if (!queued) {
+      static const char busy[] = "error: queue is full\n";
+      static const char status[] = "status failed queue 0 run 0\n";
+      if (send_section(fd, "messages", busy, sizeof(busy) - 1)) {
+        send_all(fd, status, sizeof(status) - 1);
+      }
+      close(fd);
+    }
+  }
+  fprintf(stderr, "stopping\n");
+  rc = EXIT_SUCCESS;
+
+done:
+  // queued jobs are finished before the workers stop
+  pthread_mutex_lock(&d.lock);
+  d.stopping = true;
+  pthread_cond_broadcast(&d.ready);
+  pthread_mutex_unlock(&d.lock);
+  for (int i = 0; i < started; ++i) {
+    pthread_join(worker[i].thread, NULL);
+  }
+  for (int i = 0; i < workers; ++i) {
+    for (int k = 0; k < d.pools; ++k) {
+      elliott803_destroy(worker[i].machine[k]);
+    }
+  }
+  for (int k = 0; k < d.pools; ++k) {
+    elliott803_destroy(d.pool[k].warm);
+    pthread_mutex_destroy(&d.pool[k].lock);
+  }
+  if (-1 != listener) {
+    close(listener);
+    unlink(socket_path);
+  }
+  pthread_sigmask(SIG_SETMASK, &old_mask, NULL);
+  return rc;
+}
+
+int daemon_client(const char *socket_path, FILE *script, FILE *output[3]) {
+
+  struct sockaddr_un address = {
+    .sun_family = AF_UNIX,
+  };
+  if (strlen(socket_path) >= sizeof(address.sun_path)) {
+    fprintf(stderr, "error: socket path too long: %s\n", socket_path);
+    return EXIT_FAILURE;
+  }
+  strcpy(address.sun_path, socket_path);
+
+  int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (-1 == fd ||
+      0 != connect(fd, (struct sockaddr *)(&address), sizeof(address))) {
+    fprintf(stderr, "error: %s: %s\n", socket_path, strerror(errno));
+    if (-1 != fd) {
+      close(fd);
+    }
+    return EXIT_FAILURE;
+  }
+
+  char buffer[4096];
+  size_t n = 0;
+  bool sent = true;
+  while (sent && (n = fread(buffer, 1, sizeof(buffer), script)) > 0) {
+    sent = send_all(fd, buffer, n);
+  }
+  shutdown(fd, SHUT_WR);
+
+  FILE *f = fdopen(fd, "r");
+  if (NULL == f) {
+    close(fd);
+    return EXIT_FAILURE;
+  }
+
+  // copy each section to its output
+  int rc = EXIT_FAILURE;
+  char line[256];
+  while (NULL != fgets(line, sizeof(line), f)) {
+    int unit = 0;
+    size_t size = 0;
+    FILE *out = NULL;
+    if (2 == sscanf(line, "screen %d %zu", &unit, &size) && unit >= 1 &&
+        unit <= 3) {
+      out = output[unit - 1];
+    } else if (1 == sscanf(line, "messages %zu", &size)) {
+      out = stderr;
+    } else if (0 == strncmp("status ok", line, 9)) {
+      rc = EXIT_SUCCESS;
+      break;
+    } else {
+      break;
+    }
+    while (size > 0) {
+      size_t k =
+        fread(buffer, 1, size < sizeof(buffer) ? size : sizeof(buffer), f);
+      if (0 == k) {
+        break;
+      }
+      if (NULL != out) {
+        fwrite(buffer, 1, k, out);
+      }
+      size -= k;
+    }
+  }
+  fclose(f);
+  for (size_t i = 0; i < 3; ++i) {
+    if (NULL != output[i]) {
+      fflush(output[i]);
+    }
+  }
+  return rc;
+}
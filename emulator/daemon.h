@@ -0,0 +1,38 @@
+// daemon.h
+
+#if !defined(DAEMON_H)
+#define DAEMON_H
+
+#include <stdio.h>
+
+// serve batch jobs on a Unix socket from pools of warm machines
+//
+// each pool is given as NAME=SCRIPT; the script is run in batch mode on
+// a new machine which then holds the warm state of the pool, e.g. a
+// compiler loaded and waiting for a program; every worker keeps a
+// copy-on-write clone of it for each pool, runs one job at a time on
+// it and replaces it with a fresh clone afterwards
+//
+// a request is a batch script whose first line is "pool NAME", or the
+// single line "stats" for the latency of each pool; the client ends it
+// by shutting down its side of the connection and the reply is
+//   screen N SIZE  (N = 1..3) each followed by SIZE bytes of text
+//   messages SIZE  followed by SIZE bytes of console messages
+//   status ok|failed|timeout queue US run US
+// and a job that has not finished after 10^9 instructions, e.g. one
+// that never halts or waits, is stopped as a timeout
+// file names in a job are found by the daemon, relative to its current
+// directory or in E803_TAPE_DIR
+//
+// returns EXIT_SUCCESS after SIGINT or SIGTERM, or EXIT_FAILURE
+int daemon_serve(const char *socket_path,
+                 int workers,
+                 int argc,
+                 char *argv[]);
+
+// send a script to a daemon and write the reply as batch mode would
+//
+// returns EXIT_SUCCESS or EXIT_FAILURE if the job failed
+int daemon_client(const char *socket_path, FILE *script, FILE *output[3]);
+
+#endif
@@ -13,7 +13,7 @@
 #include <sys/select.h>
 #include <sys/socket.h>
 #include <sys/types.h> // struct sockaddr
-#include <unistd.h>    // sleep
+#include <unistd.h>    // STDIN_FILENO
 #include <wctype.h>
 
 #include "commands.h"
@@ -60,6 +60,7 @@ typedef struct {
 
 // handlers
 static void handle_proc_fd(commands_t *cmd,
+                           int number,
                            pads_t *pads,
                            const layout_t *layout,
                            io5_conv_t *conv_punch[3]);
@@ -110,8 +111,6 @@ int emulator(const char *name,
     }
   }
 
-  int proc_fd = elliott803_get_fd(cmd.proc);
-
   io5_conv_t *conv_punch[3];
   memset(conv_punch, 0, sizeof(conv_punch));
   for (size_t i = 0; i < SizeOfArray(conv_punch); ++i) {
@@ -191,17 +190,26 @@ int emulator(const char *name,
 
     while (!cmd.exit_program) {
 
+      // the machines can change with each command, and every one is read
+      // so a clone that is not selected still runs to completion
+      int count = commands_machine_count(&cmd);
       fd_set fds;
       FD_ZERO(&fds);
       FD_SET(STDIN_FILENO, &fds);
-      FD_SET(proc_fd, &fds);
+      for (int i = 1; i <= count; ++i) {
+        FD_SET(elliott803_get_fd(commands_get_machine(&cmd, i)), &fds);
+      }
 
-      // timeout for select
-      struct timeval tv;
-      tv.tv_sec = 1;
-      tv.tv_usec = 0;
+      // a script runs without delay until a wait, otherwise block until
+      // a key is pressed or the processor sends a message
+      bool script_ready = NULL != script && !cmd.wait;
+      struct timeval tzero = {
+        .tv_sec = 0,
+        .tv_usec = 0,
+      };
 
-      int rc = select(FD_SETSIZE, &fds, NULL, NULL, &tv);
+      int rc =
+        select(FD_SETSIZE, &fds, NULL, NULL, script_ready ? &tzero : NULL);
 
       if (-1 == rc) {
         // if interrupted system call, just retry
@@ -212,11 +220,12 @@ int emulator(const char *name,
         continue;
       }
       if (rc > 0) {
-        if (FD_ISSET(proc_fd, &fds)) {
-          handle_proc_fd(&cmd, &pads, &layout, conv_punch);
-          continue;
+        for (int i = 1; i <= count; ++i) {
+          elliott803_t *proc = commands_get_machine(&cmd, i);
+          if (FD_ISSET(elliott803_get_fd(proc), &fds)) {
+            handle_proc_fd(&cmd, i, &pads, &layout, conv_punch);
+          }
         }
-        // only possibility here is keyboard
         if (FD_ISSET(STDIN_FILENO, &fds)) {
           if (handle_key(&cmd, &pads, &layout, &kb, script)) {
             break;
@@ -224,14 +233,9 @@ int emulator(const char *name,
         }
       }
 
-      if (cmd.wait) {
-        // beep();
-        sleep(1);
-        elliott803_send(cmd.proc, "check", 5);
-      }
-
-      // if executing script
-      if (NULL != script) {
+      // if executing script, one line per pass so messages are handled
+      // in between
+      if (NULL != script && !cmd.wait) {
         wchar_t buffer[100];
         memset(buffer, 0, sizeof(buffer));
         size_t index = 0;
@@ -291,9 +295,7 @@ int emulator(const char *name,
     }
   }
 
-  if (NULL != cmd.proc) {
-    elliott803_destroy(cmd.proc);
-  }
+  commands_destroy_machines(&cmd);
 
   for (size_t i = 0; i < commands_io_count; ++i) {
     if (NULL == cmd.file[i]) {
@@ -331,35 +333,20 @@ fail:
 }
 
 void handle_proc_fd(commands_t *cmd,
+                    int number,
                     pads_t *pads,
                     const layout_t *layout,
                     io5_conv_t *conv_punch[3]) {
-  char in_buffer[1024];
-  ssize_t n = elliott803_receive(cmd->proc, in_buffer, sizeof(in_buffer) - 1);
+  elliott803_t *proc = commands_get_machine(cmd, number);
+  char in_buffer[4096];
+  ssize_t n = elliott803_receive(proc, in_buffer, sizeof(in_buffer) - 1);
   if (n > 0) {
-    in_buffer[n + 1] = '\0';
+    in_buffer[n] = '\0';
 
     pad_select_t pad_modified = pad_console;
 
-    if (0 == strncmp("check ", in_buffer, 6)) {
-      if (cmd->wait) {
-        switch (in_buffer[6]) {
-        case 'r':
-          break;
-        case 's':
-          cmd->wait = false;
-          cmd->wait_delay = 0;
-          break;
-        default:
-          if (cmd->wait_delay < 1) {
-            cmd->wait = false;
-            cmd->wait_delay = 0;
-          } else {
-            --cmd->wait_delay;
-          }
-          break;
-        }
-      }
+    if (0 == strncmp("wait ", in_buffer, 5)) {
+      commands_wait_reply(cmd);
 
     } else if (0 == strncmp("p1 ", in_buffer, 3) ||
                0 == strncmp("p2 ", in_buffer, 3) ||
@@ -382,24 +369,32 @@ void handle_proc_fd(commands_t *cmd,
         conv = conv_punch[2];
         break;
       }
-      int c = 0;
-      sscanf(&in_buffer[3], "%02x", &c);
-
-      uint8_t b[256];
-      b[0] = (uint8_t)(c & 0xff);
+      // the punched characters follow the "pN " prefix
+      const uint8_t *data = (const uint8_t *)(&in_buffer[3]);
+      size_t size = n - 3;
 
       if (NULL != f) {
-        io5_file_write(f, b, 1);
+        io5_file_write(f, data, size);
       }
 
-      io5_conv_put(conv, b, 1);
-      n = io5_conv_get(conv, b, sizeof(b));
-      b[n] = '\0';
-
-      if ('\r' == b[0]) {
-        b[0] = '\0';
+      while (size > 0) {
+        size_t k = io5_conv_put(conv, data, size);
+        data += k;
+        size -= k;
+
+        // carriage returns and blank tape are not shown
+        uint8_t b[256];
+        size_t m = io5_conv_get(conv, b, sizeof(b));
+        size_t j = 0;
+        for (size_t i = 0; i < m; ++i) {
+          if ('\r' != b[i] && '\0' != b[i]) {
+            b[j++] = b[i];
+          }
+        }
+        if (j > 0) {
+          waddnstr(pads->pad[pad_modified], (const char *)(b), j);
+        }
       }
-      wprintw(pads->pad[pad_modified], "%s", b);
 
     } else if (0 == strncmp("r1 ", in_buffer, 3) ||
                0 == strncmp("r2 ", in_buffer, 3) ||
@@ -434,12 +429,16 @@ void handle_proc_fd(commands_t *cmd,
             i += k;
             l -= k;
           }
-          elliott803_send(cmd->proc, packet, i);
+          elliott803_send(proc, packet, i);
+          cmd->wait_supplied |= proc == cmd->proc;
         }
       }
 
     } else if (0 != strncmp("ok", in_buffer, 2)) {
-      // only display non-ok messages
+      // only display non-ok messages, naming an unselected machine
+      if (proc != cmd->proc) {
+        wprintw(pads->pad[pad_console], "machine %d: ", number);
+      }
       wprintw(pads->pad[pad_console], "%s\n", in_buffer);
     }
     // refresh if current pad is on the screen
@@ -587,7 +586,6 @@ bool handle_key(commands_t *cmd,
     break;
 
   case KEY_F(7):
-    cmd->wait_delay = 0;
     cmd->wait = false;
     break;
 
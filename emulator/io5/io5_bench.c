@@ -0,0 +1,145 @@
+// io5_bench.c
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "io5.h"
+
+enum {
+  tape_size = 65536, // characters of binary tape converted per pass
+};
+
+// run each benchmark for at least this long
+static const double minimum_seconds = 0.25;
+
+static const char *mode_names[] = {
+  [io5_mode_hex5] = "hex5",
+  [io5_mode_hex8] = "hex8",
+  [io5_mode_binary] = "binary",
+  [io5_mode_elliott] = "elliott",
+};
+
+static double now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// convert all of a buffer, returning the converted size or 0 on error
+static size_t convert(io5_conv_t *conv,
+                      const uint8_t *in,
+                      size_t size,
+                      uint8_t *out,
+                      size_t out_size) {
+  size_t in_used = 0;
+  size_t out_used = 0;
+  while (in_used < size) {
+    size_t n = io5_conv_put(conv, &in[in_used], size - in_used);
+    in_used += n;
+    size_t m = 0;
+    do {
+      m = io5_conv_get(conv, &out[out_used], out_size - out_used);
+      out_used += m;
+    } while (0 != m && out_used < out_size);
+    if (0 == n && 0 == m) {
+      return 0;
+    }
+  }
+  return out_used;
+}
+
+static bool first_result = true;
+
+// convert a tape from one mode to another repeatedly
+static bool bench(const uint8_t *binary, io5_mode_t from, io5_mode_t to) {
+
+  // output of each character is at most a UTF-8 sequence and newline
+  size_t buffer_size = 8 * tape_size;
+  uint8_t *in = malloc(buffer_size);
+  uint8_t *out = malloc(buffer_size);
+  io5_conv_t *setup = io5_conv_allocate(io5_mode_binary, from);
+  io5_conv_t *conv = io5_conv_allocate(from, to);
+  bool ok = NULL != in && NULL != out && NULL != setup && NULL != conv;
+
+  size_t size = 0;
+  if (ok) {
+    size = convert(setup, binary, tape_size, in, buffer_size);
+    ok = 0 != size;
+  }
+
+  int64_t bytes_in = 0;
+  int64_t bytes_out = 0;
+  double start = now();
+  double seconds = 0;
+  while (ok && seconds < minimum_seconds) {
+    size_t n = convert(conv, in, size, out, buffer_size);
+    ok = 0 != n;
+    bytes_in += size;
+    bytes_out += n;
+    seconds = now() - start;
+  }
+
+  if (ok) {
+    printf("%s\n    {\"name\": \"%s to %s\", \"bytes\": %" PRId64
+           ", \"output_bytes\": %" PRId64 ", \"seconds\": %.6f"
+           ", \"bytes_per_second\": %.0f}",
+           first_result ? "" : ",",
+           mode_names[from],
+           mode_names[to],
+           bytes_in,
+           bytes_out,
+           seconds,
+           bytes_in / seconds);
+    first_result = false;
+  } else {
+    fprintf(stderr,
+            "error: %s to %s conversion failed\n",
+            mode_names[from],
+            mode_names[to]);
+  }
+
+  if (NULL != conv) {
+    io5_conv_deallocate(conv);
+  }
+  if (NULL != setup) {
+    io5_conv_deallocate(setup);
+  }
+  free(out);
+  free(in);
+  return ok;
+}
+
+int main(int argc, char *argv[]) {
+
+  // a text tape: letters and figures with shifts between them
+  static uint8_t binary[tape_size];
+  uint32_t seed = 803;
+  for (size_t i = 0; i < sizeof(binary); ++i) {
+    seed = seed * 1103515245 + 12345;
+    uint8_t c = (seed >> 16) % 27;
+    binary[i] = 0 == c ? (0 == (i & 64) ? 0x1f : 0x1b) : c;
+  }
+
+  static const io5_mode_t modes[][2] = {
+    {io5_mode_binary, io5_mode_hex5},
+    {io5_mode_hex5, io5_mode_binary},
+    {io5_mode_binary, io5_mode_hex8},
+    {io5_mode_hex8, io5_mode_binary},
+    {io5_mode_binary, io5_mode_elliott},
+    {io5_mode_elliott, io5_mode_binary},
+  };
+
+  int rc = 0;
+  printf("{\n  \"benchmarks\": [");
+  for (size_t i = 0; i < sizeof(modes) / sizeof(modes[0]); ++i) {
+    if (!bench(binary, modes[i][0], modes[i][1])) {
+      rc = 1;
+    }
+  }
+  printf("\n  ]\n}\n");
+  return rc;
+}
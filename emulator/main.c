@@ -8,8 +8,13 @@
 #include <string.h>
 #include <unistd.h>
 
+#include "batch.h"
+#include "cache.h"
+#include "cpu/trace.h"
+#include "daemon.h"
 #include "emulator.h"
 #include "pathsearch.h"
+#include "runner.h"
 
 // display usage message and exit
 __attribute__((noreturn)) static void
@@ -28,11 +33,42 @@ usage(const char *program, const char *format, ...) {
   fprintf(stderr, "       -h           this message\n");
   fprintf(stderr, "       -e FILE      execute a file of commands\n");
   fprintf(stderr, "       -i           interactive mode (after commands)\n");
+  fprintf(stderr, "       -b           batch mode, no display (requires -e)\n");
+  fprintf(stderr, "       -1|2|3 FILE  batch output of screen F1..F3\n");
+  fprintf(stderr, "       -n           batch mode without the result cache\n");
+  fprintf(stderr, "       -s           display result cache statistics\n");
+  fprintf(stderr, "       -d SOCKET    daemon serving pools NAME=SCRIPT...\n");
+  fprintf(stderr, "       -j N         jobs run at once by -d or -m\n");
+  fprintf(stderr, "       -m FILE      run a manifest of jobs in parallel\n");
+  fprintf(stderr, "       -c SOCKET    run -e as a job of a daemon\n");
+  fprintf(stderr, "       -r FILE [N]  replay a trace from instruction N\n");
   fprintf(stderr, "       -V           display program version\n");
 
   exit(EXIT_FAILURE);
 }
 
+// open a file found by path_search or exit
+static FILE *search_open(const char *program, const char *name) {
+  char filename[1024];
+  switch (path_search(filename, sizeof(filename), name, L"")) {
+  case PS_ok:
+    break;
+  case PS_malloc_failed:
+    usage(program, "file: %s  error: %s\n", name, "malloc failed");
+
+  case PS_filename_too_long:
+    usage(program, "file: %s  error: %s\n", name, "filename too long");
+
+  case PS_file_not_found:
+    usage(program, "file: %s  error: %s\n", name, "file not found");
+  }
+  FILE *f = fopen(filename, "r");
+  if (NULL == f) {
+    usage(program, "file: %s  error: %s\n", name, strerror(errno));
+  }
+  return f;
+}
+
 // main program
 int main(int argc, char *argv[]) {
 
@@ -40,37 +76,77 @@ int main(int argc, char *argv[]) {
   static const char *version = VERSION_STRING;
 
   FILE *f = NULL;
+  FILE *manifest = NULL;
   int ch = 0;
   bool interactive = false;
-  while ((ch = getopt(argc, argv, "e:hiV")) != -1) {
+  bool batch_mode = false;
+  bool cached = true;
+  const char *daemon_socket = NULL;
+  const char *client_socket = NULL;
+  const char *trace = NULL;
+  long workers = sysconf(_SC_NPROCESSORS_ONLN);
+  FILE *output[3] = {stdout, stdout, stdout};
+  while ((ch = getopt(argc, argv, "1:2:3:bc:d:e:hij:m:nr:sV")) != -1) {
     switch (ch) {
+    case '1':
+    case '2':
+    case '3':
+      output[ch - '1'] = fopen(optarg, "w");
+      if (NULL == output[ch - '1']) {
+        usage(program, "file: %s  error: %s\n", optarg, strerror(errno));
+      }
+      break;
+
+    case 'b':
+      batch_mode = true;
+      break;
+
+    case 'c':
+      client_socket = optarg;
+      break;
+
+    case 'd':
+      daemon_socket = optarg;
+      break;
+
     case 'e':
       if (NULL != f) {
         usage(program, "only one -e option is permitted");
       }
-      char filename[1024];
-      switch (path_search(filename, sizeof(filename), optarg, L"")) {
-      case PS_ok:
-        f = fopen(filename, "r");
-        if (NULL == f) {
-          usage(program, "file: %s  error: %s\n", optarg, strerror(errno));
-        }
-        break;
-      case PS_malloc_failed:
-        usage(program, "file: %s  error: %s\n", optarg, "malloc failed");
-
-      case PS_filename_too_long:
-        usage(program, "file: %s  error: %s\n", optarg, "filename too long");
-
-      case PS_file_not_found:
-        usage(program, "file: %s  error: %s\n", optarg, "file not found");
-      }
+      f = search_open(program, optarg);
       break;
 
     case 'i':
       interactive = true;
       break;
 
+    case 'm':
+      if (NULL != manifest) {
+        usage(program, "only one -m option is permitted");
+      }
+      manifest = search_open(program, optarg);
+      break;
+
+    case 'j': {
+      char *end = NULL;
+      workers = strtol(optarg, &end, 10);
+      if ('\0' != *end || workers < 1) {
+        usage(program, "invalid number of jobs: %s", optarg);
+      }
+      break;
+    }
+
+    case 'n':
+      cached = false;
+      break;
+
+    case 'r':
+      trace = optarg;
+      break;
+
+    case 's':
+      return cache_statistics(stdout);
+
     case 'V':
       printf("%s version: %s\n", program, version);
       return 0;
@@ -94,10 +170,59 @@ int main(int argc, char *argv[]) {
   exit(99);
 #endif
 
-  int rc = emulator(program, version, f, interactive, argc, argv);
+  int rc = EXIT_FAILURE;
+  if (NULL != trace) {
+    if (NULL != f || NULL != manifest || interactive || batch_mode ||
+        NULL != client_socket || NULL != daemon_socket || argc > 1) {
+      usage(program, "replay mode excludes all other options");
+    }
+    long long instruction = 0;
+    if (1 == argc) {
+      char *end = NULL;
+      instruction = strtoll(argv[0], &end, 10);
+      if ('\0' != *end || instruction < 0) {
+        usage(program, "invalid instruction: %s", argv[0]);
+      }
+    }
+    FILE *in = fopen(trace, "rb");
+    if (NULL == in) {
+      usage(program, "file: %s  error: %s\n", trace, strerror(errno));
+    }
+    rc = trace_replay(in, instruction, stdout) ? EXIT_SUCCESS : EXIT_FAILURE;
+    fclose(in);
+  } else if (NULL != manifest) {
+    if (NULL != f || interactive || batch_mode || NULL != client_socket ||
+        NULL != daemon_socket) {
+      usage(program, "runner mode excludes -b, -c, -d, -e and -i");
+    }
+    rc = runner(manifest, workers, stdout);
+    fclose(manifest);
+  } else if (NULL != daemon_socket) {
+    if (NULL != f || interactive || batch_mode || NULL != client_socket) {
+      usage(program, "daemon mode excludes -b, -c, -e and -i");
+    }
+    rc = daemon_serve(daemon_socket, workers, argc, argv);
+  } else if (NULL != client_socket) {
+    if (NULL == f || interactive || batch_mode) {
+      usage(program, "client mode requires -e and excludes -b and -i");
+    }
+    rc = daemon_client(client_socket, f, output);
+  } else if (batch_mode) {
+    if (NULL == f || interactive) {
+      usage(program, "batch mode requires -e and excludes -i");
+    }
+    rc = batch(f, output, cached);
+  } else {
+    rc = emulator(program, version, f, interactive, argc, argv);
+  }
   if (NULL != f) {
     fclose(f);
     f = NULL;
   }
+  for (size_t i = 0; i < 3; ++i) {
+    if (stdout != output[i]) {
+      fclose(output[i]);
+    }
+  }
   return rc;
 }
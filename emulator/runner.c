@@ -0,0 +1,558 @@
+// runner.c
+
+#include <errno.h>
+#include <inttypes.h>
+#include <locale.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/select.h>
+#include <time.h>
+#include <unistd.h>
+
+#if defined(__linux__)
+#include <sched.h>
+#elif defined(__FreeBSD__)
+#include <pthread_np.h>
+#include <sys/cpuset.h>
+#endif
+
+#include "batch.h"
+#include "cpu/elliott803.h"
+#include "pathsearch.h"
+#include "runner.h"
+
+#if !defined(SizeOfArray)
+#define SizeOfArray(a) (sizeof(a) / sizeof((a)[0]))
+#endif
+
+enum {
+  runner_tapes = 9,     // $1..$9
+  runner_screens = 3,   // F1..F3
+  runner_workers = 256, //
+};
+
+typedef enum {
+  job_passed,
+  job_failed,  // an error was reported or the output differs
+  job_timeout, // the instruction limit was reached
+  job_error,   // the job could not be run
+} job_status_t;
+
+static const char *status_names[] = {
+  [job_passed] = "passed",
+  [job_failed] = "failed",
+  [job_timeout] = "timeout",
+  [job_error] = "error",
+};
+
+typedef struct {
+  // from the manifest
+  char *name;
+  char *script;
+  char *tape[runner_tapes];
+  int tapes;
+  int64_t limit; // 0 for none
+  char *expect[runner_screens];
+
+  // result
+  job_status_t status;
+  int worker;
+  int64_t instructions;
+  double seconds;
+  char detail[256]; // the first reason it did not pass
+} job_t;
+
+// jobs a worker owns, taken from the bottom by the worker itself and
+// from the top by others
+typedef struct {
+  pthread_mutex_t lock;
+  int *jobs;
+  int top;
+  int bottom;
+} deque_t;
+
+typedef struct runner_struct runner_t;
+
+typedef struct {
+  runner_t *r;
+  int index;
+  pthread_t thread;
+  deque_t deque;
+  int64_t steals; // jobs taken from other workers
+} worker_t;
+
+struct runner_struct {
+  job_t *job;
+  int jobs;
+  worker_t *worker;
+  int workers;
+};
+
+static double now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int pop(deque_t *d) {
+  pthread_mutex_lock(&d->lock);
+  int j = d->top < d->bottom ? d->jobs[--d->bottom] : -1;
+  pthread_mutex_unlock(&d->lock);
+  return j;
+}
+
+static int steal(deque_t *d) {
+  pthread_mutex_lock(&d->lock);
+  int j = d->top < d->bottom ? d->jobs[d->top++] : -1;
+  pthread_mutex_unlock(&d->lock);
+  return j;
+}
+
+// keep a worker, and the machines it creates, on one processor
+static void set_affinity(int worker) {
+  long processors = sysconf(_SC_NPROCESSORS_ONLN);
+  if (processors < 1) {
+    return;
+  }
+#if defined(__linux__)
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  CPU_SET(worker % processors, &set);
+  pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+#elif defined(__FreeBSD__)
+  cpuset_t set;
+  CPU_ZERO(&set);
+  CPU_SET(worker % processors, &set);
+  pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+#endif
+}
+
+// read a whole file, NULL on error
+static char *read_file(const char *name, size_t *size) {
+  char filename[1024];
+  if (PS_ok != path_search(filename, sizeof(filename), name, L"")) {
+    return NULL;
+  }
+  FILE *f = fopen(filename, "rb");
+  if (NULL == f) {
+    return NULL;
+  }
+  char *data = NULL;
+  size_t n = 0;
+  FILE *m = open_memstream(&data, &n);
+  if (NULL != m) {
+    char buffer[4096];
+    size_t k = 0;
+    while ((k = fread(buffer, 1, sizeof(buffer), f)) > 0) {
+      fwrite(buffer, 1, k, m);
+    }
+    fclose(m);
+  }
+  fclose(f);
+  *size = n;
+  return data;
+}
+
+// the script with "$N" replaced by the tapes, in a file that batch can
+// read as wide characters
+static FILE *prepare_script(job_t *job) {
+
+  size_t size = 0;
+  char *text = read_file(job->script, &size);
+  if (NULL == text) {
+    snprintf(job->detail, sizeof(job->detail), "cannot read script");
+    return NULL;
+  }
+
+  FILE *f = tmpfile();
+  char *script = NULL;
+  size_t script_size = 0;
+  FILE *m = open_memstream(&script, &script_size);
+  if (NULL == f || NULL == m) {
+    snprintf(job->detail, sizeof(job->detail), "%s", strerror(errno));
+    free(text);
+    if (NULL != f) {
+      fclose(f);
+    }
+    if (NULL != m) {
+      fclose(m);
+      free(script);
+    }
+    return NULL;
+  }
+
+  if (0 != job->limit) {
+    fprintf(m, "events limit\nlimit %" PRId64 "\n", job->limit);
+  }
+  for (size_t i = 0; i < size; ++i) {
+    int k = '$' == text[i] && i + 1 < size ? text[i + 1] - '1' : -1;
+    if (k >= 0 && k < job->tapes) {
+      fputs(job->tape[k], m);
+      ++i;
+    } else {
+      fputc(text[i], m);
+    }
+  }
+  fclose(m);
+  free(text);
+
+  // written without giving the stream an orientation
+  bool ok = (ssize_t)(script_size) ==
+              write(fileno(f), script, script_size) &&
+            0 == lseek(fileno(f), 0, SEEK_SET);
+  free(script);
+  if (!ok) {
+    snprintf(job->detail, sizeof(job->detail), "%s", strerror(errno));
+    fclose(f);
+    return NULL;
+  }
+  return f;
+}
+
+// instructions the machine has executed
+static int64_t executed(elliott803_t *proc) {
+  elliott803_send(proc, "stats", 6);
+  int fd = elliott803_get_fd(proc);
+  for (;;) {
+    fd_set fds;
+    FD_ZERO(&fds);
+    FD_SET(fd, &fds);
+    struct timeval timeout = {
+      .tv_sec = 5,
+      .tv_usec = 0,
+    };
+    int rc = select(FD_SETSIZE, &fds, NULL, NULL, &timeout);
+    if (-1 == rc && EINTR == errno) {
+      continue;
+    }
+    if (rc <= 0) {
+      return 0;
+    }
+    char buffer[4096];
+    ssize_t n = elliott803_receive(proc, buffer, sizeof(buffer) - 1);
+    if (n <= 0) {
+      continue;
+    }
+    buffer[n] = '\0';
+    int64_t count = 0;
+    if (1 == sscanf(buffer, "stats instructions %" SCNd64, &count)) {
+      return count;
+    }
+  }
+}
+
+// compare screen text with the expected file
+static bool check_output(job_t *job, int screen, const char *text, size_t n) {
+  if (NULL == job->expect[screen]) {
+    return true;
+  }
+  size_t size = 0;
+  char *expected = read_file(job->expect[screen], &size);
+  if (NULL == expected) {
+    snprintf(job->detail,
+             sizeof(job->detail),
+             "cannot read %s",
+             job->expect[screen]);
+    return false;
+  }
+  size_t i = 0;
+  while (i < n && i < size && text[i] == expected[i]) {
+    ++i;
+  }
+  free(expected);
+  if (i == n && i == size) {
+    return true;
+  }
+  snprintf(job->detail,
+           sizeof(job->detail),
+           "screen %d differs at byte %zu",
+           screen + 1,
+           i);
+  return false;
+}
+
+static void run_job(worker_t *w, job_t *job) {
+
+  double start = now();
+  job->worker = w->index;
+  job->status = job_error;
+
+  FILE *script = prepare_script(job);
+  if (NULL == script) {
+    return;
+  }
+
+  FILE *output[runner_screens + 1] = {NULL};
+  char *data[runner_screens + 1] = {NULL};
+  size_t size[runner_screens + 1] = {0};
+  bool opened = true;
+  for (size_t i = 0; i < SizeOfArray(output); ++i) {
+    output[i] = open_memstream(&data[i], &size[i]);
+    opened = opened && NULL != output[i];
+  }
+
+  elliott803_t *proc = opened ? elliott803_create(job->name) : NULL;
+  if (NULL == proc) {
+    snprintf(job->detail, sizeof(job->detail), "cannot create machine");
+  } else {
+    bool ok = EXIT_SUCCESS == batch_machine(proc,
+                                            script,
+                                            output,
+                                            output[runner_screens]);
+    job->instructions = executed(proc);
+    elliott803_destroy(proc);
+
+    for (size_t i = 0; i < SizeOfArray(output); ++i) {
+      fclose(output[i]);
+      output[i] = NULL;
+    }
+    const char *messages = data[runner_screens];
+    if (NULL != strstr(messages, "event limit\n")) {
+      job->status = job_timeout;
+      snprintf(job->detail, sizeof(job->detail), "instruction limit");
+    } else if (!ok) {
+      job->status = job_failed;
+      const char *error = strstr(messages, "error");
+      snprintf(job->detail,
+               sizeof(job->detail),
+               "%.*s",
+               NULL == error ? 0 : (int)(strcspn(error, "\n")),
+               NULL == error ? "" : error);
+    } else {
+      job->status = job_passed;
+      for (int i = 0; i < runner_screens; ++i) {
+        if (!check_output(job, i, data[i], size[i])) {
+          job->status = job_failed;
+          break;
+        }
+      }
+    }
+  }
+
+  for (size_t i = 0; i < SizeOfArray(output); ++i) {
+    if (NULL != output[i]) {
+      fclose(output[i]);
+    }
+    free(data[i]);
+  }
+  fclose(script);
+  job->seconds = now() - start;
+}
+
+static void *worker_loop(void *arg) {
+
+  worker_t *w = arg;
+  runner_t *r = w->r;
+  set_affinity(w->index);
+
+  for (;;) {
+    int j = pop(&w->deque);
+    for (int k = 1; j < 0 && k < r->workers; ++k) {
+      j = steal(&r->worker[(w->index + k) % r->workers].deque);
+      w->steals += j < 0 ? 0 : 1;
+    }
+    // no jobs are added once started, so all are taken
+    if (j < 0) {
+      return NULL;
+    }
+    run_job(w, &r->job[j]);
+  }
+}
+
+// split a manifest line into a job, false if it is invalid
+static bool parse_job(job_t *job, char *line) {
+
+  memset(job, 0, sizeof(*job));
+  char *save = NULL;
+  char *name = strtok_r(line, " \t\r\n", &save);
+  char *script = strtok_r(NULL, " \t\r\n", &save);
+  if (NULL == name || NULL == script) {
+    return false;
+  }
+  job->name = strdup(name);
+  job->script = strdup(script);
+
+  for (char *w = NULL; NULL != (w = strtok_r(NULL, " \t\r\n", &save));) {
+    char *end = NULL;
+    if (0 == strncmp("limit=", w, 6)) {
+      job->limit = strtoll(&w[6], &end, 10);
+      if ('\0' != *end || job->limit < 1) {
+        return false;
+      }
+    } else if (0 == strncmp("expect", w, 6) && w[6] >= '1' &&
+               w[6] <= '0' + runner_screens && '=' == w[7]) {
+      job->expect[w[6] - '1'] = strdup(&w[8]);
+    } else if (job->tapes < runner_tapes) {
+      job->tape[job->tapes++] = strdup(w);
+    } else {
+      return false;
+    }
+  }
+  return true;
+}
+
+// a JSON string
+static void put_string(FILE *f, const char *s) {
+  fputc('"', f);
+  for (; '\0' != *s; ++s) {
+    unsigned char c = *s;
+    if ('"' == c || '\\' == c) {
+      fprintf(f, "\\%c", c);
+    } else if (c < ' ') {
+      fprintf(f, "\\u%04x", c);
+    } else {
+      fputc(c, f);
+    }
+  }
+  fputc('"', f);
+}
+
+// a count per second, 0 for a job that failed before it ran as JSON
+// has no NaN
+static double rate(double count, double seconds) {
+  return seconds > 0 ? count / seconds : 0;
+}
+
+static void write_summary(runner_t *r, double seconds, FILE *f) {
+
+  int count[SizeOfArray(status_names)] = {0};
+  int64_t instructions = 0;
+  int64_t steals = 0;
+  for (int i = 0; i < r->jobs; ++i) {
+    ++count[r->job[i].status];
+    instructions += r->job[i].instructions;
+  }
+  for (int i = 0; i < r->workers; ++i) {
+    steals += r->worker[i].steals;
+  }
+
+  fprintf(f, "{\n");
+  fprintf(f, "  \"workers\": %d,\n", r->workers);
+  fprintf(f, "  \"jobs\": %d,\n", r->jobs);
+  for (size_t i = 0; i < SizeOfArray(status_names); ++i) {
+    fprintf(f, "  \"%s\": %d,\n", status_names[i], count[i]);
+  }
+  fprintf(f, "  \"seconds\": %.6f,\n", seconds);
+  fprintf(f, "  \"jobs_per_second\": %.3f,\n", rate(r->jobs, seconds));
+  fprintf(f, "  \"instructions\": %" PRId64 ",\n", instructions);
+  fprintf(f,
+          "  \"instructions_per_second\": %.0f,\n",
+          rate(instructions, seconds));
+  fprintf(f, "  \"steals\": %" PRId64 ",\n", steals);
+  fprintf(f, "  \"results\": [");
+  for (int i = 0; i < r->jobs; ++i) {
+    const job_t *job = &r->job[i];
+    fprintf(f, "%s\n    {\"name\": ", 0 == i ? "" : ",");
+    put_string(f, job->name);
+    fprintf(f,
+            ", \"status\": \"%s\", \"worker\": %d, \"seconds\": %.6f"
+            ", \"instructions\": %" PRId64
+            ", \"instructions_per_second\": %.0f, \"detail\": ",
+            status_names[job->status],
+            job->worker,
+            job->seconds,
+            job->instructions,
+            rate(job->instructions, job->seconds));
+    put_string(f, job->detail);
+    fprintf(f, "}");
+  }
+  fprintf(f, "\n  ]\n}\n");
+  fflush(f);
+}
+
+int runner(FILE *manifest, int workers, FILE *summary) {
+
+  setlocale(LC_ALL, "");
+
+  if (workers < 1 || workers > runner_workers) {
+    fprintf(stderr, "error: workers must be 1 to %d\n", runner_workers);
+    return EXIT_FAILURE;
+  }
+
+  runner_t r = {0};
+  int capacity = 0;
+  int rc = EXIT_FAILURE;
+  char line[4096];
+  for (int n = 1; NULL != fgets(line, sizeof(line), manifest); ++n) {
+    size_t skip = strspn(line, " \t\r\n");
+    if ('\0' == line[skip] || '#' == line[skip]) {
+      continue;
+    }
+    if (r.jobs == capacity) {
+      capacity = 2 * capacity + 64;
+      job_t *p = realloc(r.job, capacity * sizeof(job_t));
+      if (NULL == p) {
+        fprintf(stderr, "error: out of memory\n");
+        goto done;
+      }
+      r.job = p;
+    }
+    if (!parse_job(&r.job[r.jobs++], line)) {
+      fprintf(stderr, "error: manifest line %d is invalid\n", n);
+      goto done;
+    }
+  }
+
+  // deal the jobs round robin, the first of each worker on top
+  r.workers = workers < r.jobs ? workers : (0 == r.jobs ? 1 : r.jobs);
+  r.worker = calloc(r.workers, sizeof(worker_t));
+  if (NULL == r.worker) {
+    fprintf(stderr, "error: out of memory\n");
+    goto done;
+  }
+  for (int i = 0; i < r.workers; ++i) {
+    worker_t *w = &r.worker[i];
+    w->r = &r;
+    w->index = i;
+    pthread_mutex_init(&w->deque.lock, NULL);
+    w->deque.jobs = malloc((r.jobs / r.workers + 1) * sizeof(int));
+    if (NULL == w->deque.jobs) {
+      fprintf(stderr, "error: out of memory\n");
+      goto done;
+    }
+    for (int j = r.jobs - 1 - (r.jobs - 1 - i) % r.workers; j >= i;
+         j -= r.workers) {
+      w->deque.jobs[w->deque.bottom++] = j;
+    }
+  }
+
+  double start = now();
+  for (int i = 0; i < r.workers; ++i) {
+    pthread_create(&r.worker[i].thread, NULL, worker_loop, &r.worker[i]);
+  }
+  for (int i = 0; i < r.workers; ++i) {
+    pthread_join(r.worker[i].thread, NULL);
+  }
+  write_summary(&r, now() - start, summary);
+
+  rc = EXIT_SUCCESS;
+  for (int i = 0; i < r.jobs; ++i) {
+    if (job_passed != r.job[i].status) {
+      rc = EXIT_FAILURE;
+    }
+  }
+
+done:
+  for (int i = 0; NULL != r.worker && i < r.workers; ++i) {
+    free(r.worker[i].deque.jobs);
+    pthread_mutex_destroy(&r.worker[i].deque.lock);
+  }
+  free(r.worker);
+  for (int i = 0; i < r.jobs; ++i) {
+    job_t *job = &r.job[i];
+    free(job->name);
+    free(job->script);
+    for (int k = 0; k < job->tapes; ++k) {
+      free(job->tape[k]);
+    }
+    for (int k = 0; k < runner_screens; ++k) {
+      free(job->expect[k]);
+    }
+  }
+  free(r.job);
+  return rc;
+}
@@ -0,0 +1,25 @@
+// runner.h
+
+#if !defined(RUNNER_H)
+#define RUNNER_H
+
+#include <stdio.h>
+
+// run the jobs of a manifest in parallel and write a JSON summary
+//
+// each line of the manifest is a job, blank lines and those starting
+// with '#' are ignored:
+//   NAME SCRIPT [TAPE...] [limit=N] [expect1=FILE] [expect2=FILE]
+//   [expect3=FILE]
+// the script runs in batch mode on a new machine with "$1".."$9"
+// replaced by the tapes; limit stops the job as timed out after N
+// instructions and each expected file must match the text of screen
+// F1..F3
+//
+// the jobs are shared among the workers, each pinned to a processor,
+// and a worker that runs out steals jobs from the others
+//
+// returns EXIT_SUCCESS if every job passed, otherwise EXIT_FAILURE
+int runner(FILE *manifest, int workers, FILE *summary);
+
+#endif
@@ -0,0 +1,23 @@
+// sha256.h
+
+#if !defined(SHA256_H)
+#define SHA256_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+enum {
+  sha256_size = 32, // bytes of digest
+};
+
+typedef struct {
+  uint32_t state[8];
+  uint64_t length; // bytes added so far
+  uint8_t block[64];
+} sha256_t;
+
+void sha256_init(sha256_t *h);
+void sha256_add(sha256_t *h, const void *data, size_t size);
+void sha256_final(sha256_t *h, uint8_t digest[sha256_size]);
+
+#endif